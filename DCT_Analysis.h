@@ -0,0 +1,156 @@
+/*
+ * DCT_ANALYSIS.h
+ *
+ * Interface of libdct, the compiled version of the DataTest analyses. Each
+ * analysis is a pass of the single-read pipeline (DCT_Pipeline.h); the
+ * pipeline, ROI finder and histogram booking are built once with CMake (see
+ * CMakeLists.txt) and used from:
+ *   - the DCT_DataTest5/7/9.c macros, which load the library and only draw
+ *   - dct-analyze, which runs any combination of them headless over one read
+ *     of the data, or one shard of it (see DCT_Shard.h), and saves the
+ *     histograms to a ROOT file
+ *   - dct-batch, which does the same for every run of a campaign (see
+ *     DCT_Batch.h)
+ *
+ * Each addDataTestNPass() books its histograms (SetDirectory(0), owned by the
+ * caller) and registers the pass; they're filled by runPipeline().
+ * runDataTestN() does both for one analysis and returns false if infile can't
+ * be opened. runDataTestNHits() does the same from the hit records of an
+ * earlier run (see DCT_Hits.h) instead of the raw data.
+ *
+ */
+
+#ifndef DCT_ANALYSIS_H
+#define DCT_ANALYSIS_H
+
+#include "TF1.h"
+#include "TH1F.h"
+
+#include "DCT_Calib.h"
+#include "DCT_Fit.h"
+#include "DCT_Hits.h"
+#include "DCT_Pipeline.h"
+
+#ifndef NUMWIRES
+#define NUMWIRES 8
+#endif
+
+/*******************************************************************************
+ * Histograms of DataTest5: max voltage per wire and per event
+*******************************************************************************/
+typedef struct DataTest5Hists {
+  TH1F* h[NUMWIRES];  // Max voltage per wire
+  TH1F* h1;           // Max voltage per event (of all wires)
+  long nEvents;       // Events read
+} DataTest5Hists;
+
+/*******************************************************************************
+ * Histograms of DataTest7: start time, drift time and dN/dt radius per wire
+*******************************************************************************/
+typedef struct DataTest7Hists {
+  TH1F* h1[NUMWIRES];  // Start times
+  TH1F* h2[NUMWIRES];  // Drift times
+  TH1F* h3[NUMWIRES];  // dN/dt radius
+  long nEvents;        // Events read
+} DataTest7Hists;
+
+/*******************************************************************************
+ * Histograms and fits of DataTest9: dN/dt and r-t relation per wire, and the
+ * same for wires 3,4,5 together
+*******************************************************************************/
+typedef struct DataTest9Hists {
+  TH1F* h1[NUMWIRES];  // dN/dt (drift times)
+  TH1F* h2[NUMWIRES];  // r-t relation
+  TH1F* h3;            // r-t relation of wires 3,4,5
+  TH1F* h4;            // dN/dt of wires 3,4,5
+  long nEvents;        // Events read
+
+  // Fits, filled by fitDataTest9(). The fits are also attached to h1/h2/h3/h4
+  TF1* gauss[NUMWIRES];   // Gaussian fit of dN/dt
+  TF1* quad[NUMWIRES];    // Quadratic fit of dN/dt
+  TF1* cheby[NUMWIRES];   // Chebyshev fit of r-t
+  TF1* gaussD[NUMWIRES];  // Derivative of gauss
+  TF1* quadD[NUMWIRES];   // Derivative of quad
+  TF1* cheb;              // Chebyshev fit of r-t, wires 3,4,5
+  TF1* gauss1;            // Gaussian fit of dN/dt, wires 3,4,5
+  TF1* iGauss;            // Integral of gauss1, the r-t it predicts
+
+  // Fit results behind the TF1s: range, chi2, status (see DCT_Fit.h)
+  FitResult gaussFit[NUMWIRES];
+  FitResult quadFit[NUMWIRES];
+  FitResult chebyFit[NUMWIRES];
+  FitResult chebFit;
+  FitResult gauss1Fit;
+} DataTest9Hists;
+
+/*******************************************************************************
+ * Histograms of the analyses asked for, as the drivers save them
+*******************************************************************************/
+typedef struct DataTestResults {
+  bool run5, run7, run9;
+  DataTest5Hists H5;
+  DataTest7Hists H7;
+  DataTest9Hists H9;
+} DataTestResults;
+
+/*******************************************************************************
+ * Sets several histogram properties
+*******************************************************************************/
+TH1F* histEditor(int hNum, const char* type, const char* label,
+                 const char* axis, int n, int nmin, int nmax);
+
+/*******************************************************************************
+ * Writes h to the current directory. Histogram names like "dN/dt 1" aren't
+ * valid keys, so '/' and ' ' become '_'.
+*******************************************************************************/
+void writeHist(TH1F* h);
+
+/*******************************************************************************
+ * Adds the histogram writeHist() saved as h to dir (a partial result, see
+ * DCT_Shard.h) to h. Returns false, with a message, if it isn't there or is
+ * binned differently.
+*******************************************************************************/
+bool addSavedHist(TDirectory* dir, TH1F* h);
+
+/*******************************************************************************
+ * Saves the histograms of R to outfile, one directory per analysis. Written
+ * to a temporary file first and renamed, so outfile is always a complete
+ * file. Returns false, with a message, if it can't be written.
+*******************************************************************************/
+bool saveResults(const DataTestResults* R, const char* outfile);
+
+/*******************************************************************************
+ * Deletes the histograms of R, and the DataTest9 fits if it was fitted. R
+ * must have been zeroed before its passes were added.
+*******************************************************************************/
+void deleteResults(DataTestResults* R);
+
+/*******************************************************************************
+ * The analyses. nThreads splits the event loop (see DCT_Parallel.h); the
+ * histograms come out the same for any number of threads.
+*******************************************************************************/
+void addDataTest5Pass(DCTPipeline* P, DataTest5Hists* H);
+void addDataTest7Pass(DCTPipeline* P, DataTest7Hists* H);
+void addDataTest9Pass(DCTPipeline* P, DataTest9Hists* H);
+
+bool runDataTest5(const char* infile, int nThreads, DataTest5Hists* H);
+bool runDataTest7(const char* infile, int nThreads, DataTest7Hists* H);
+bool runDataTest9(const char* infile, int nThreads, DataTest9Hists* H);
+
+bool runDataTest5Hits(const char* hitsfile, int nThreads, DataTest5Hists* H);
+bool runDataTest7Hits(const char* hitsfile, int nThreads, DataTest7Hists* H);
+
+/*******************************************************************************
+ * Fits the DataTest9 histograms, up to nThreads fits at a time, and prints a
+ * summary of the fits. Kept apart from the event loop so the fits can be done
+ * in a pad (macro) or in batch (dct-analyze).
+*******************************************************************************/
+void fitDataTest9(DataTest9Hists* H, int nThreads);
+
+/*******************************************************************************
+ * Saves the r-t fits of fitDataTest9() as a calibration table for
+ * driftRadius() (see DCT_Calib.h). interp is RTC_LINEAR or RTC_CUBIC.
+*******************************************************************************/
+bool exportRTCalib(const DataTest9Hists* H, const char* outfile, int interp);
+
+#endif
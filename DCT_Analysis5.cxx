@@ -0,0 +1,151 @@
+/*
+ * DCT_ANALYSIS5.cxx
+ *
+ * DataTest5 pass (see DCT_DataTest5.c). Finds mins for each event, both per
+ * wire and per event (max/min of all wires). Frequency of max voltage goes to
+ * a histogram in both cases.
+ *
+ * A wire counts if its sum crossed threshold and it didn't malfunction, the
+ * same waves the original DataTest5 ROI search kept, so the ROIs come from the
+ * shared finder in DCT_ROI.h.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#define NUMWIRES 8
+#define NUMEVENTS 10000
+
+#include "DCT_Analysis.h"
+#include "DCT_Pipeline.h"
+
+/*******************************************************************************
+ * State of the pass. Histograms of worker k start at hists[k * NHISTS5]:
+ * NUMWIRES per-wire histograms, then the per-event one.
+*******************************************************************************/
+#define NHISTS5 (NUMWIRES + 1)
+
+typedef struct DataTest5Pass {
+  DataTest5Hists* Out;
+  std::vector<TH1F*> hists;
+} DataTest5Pass;
+
+static void begin5(void* data, int nWorkers, long nEvents) {
+  DataTest5Pass* P = (DataTest5Pass*)data;
+  TH1F* hists[NHISTS5];
+
+  for (int w = 0; w < NUMWIRES; w++) hists[w] = P->Out->h[w];
+  hists[NUMWIRES] = P->Out->h1;
+  workerHists(hists, NHISTS5, nWorkers, &P->hists);
+}
+
+static void event5(void* data, int k, const EventROIs* e) {
+  DataTest5Pass* P = (DataTest5Pass*)data;
+  TH1F** h = &P->hists[k * NHISTS5];
+  int minPerEvent = 0;  // Maximum (minimum in the data set) of all wires
+  bool eventOK = false;
+
+  /* Add all minvalues to histograms if the event was good/found on wire w */
+  for (int w = 0; w < NUMWIRES; w++) {
+    if (!e->waveGood[w]) continue;
+    int minPerWire = e->sum[w].minval < 0 ? e->sum[w].minval : 0;
+    if (minPerEvent > minPerWire) minPerEvent = minPerWire;
+    h[w]->Fill(-minPerWire);
+    eventOK = true;
+  }
+  if (eventOK) h[NUMWIRES]->Fill(-minPerEvent);
+}
+
+static void end5(void* data, int nWorkers, long nEvents) {
+  DataTest5Pass* P = (DataTest5Pass*)data;
+
+  mergeWorkerHists(&P->hists, NHISTS5, nWorkers);
+  P->Out->nEvents = nEvents < NUMEVENTS ? nEvents : NUMEVENTS;
+  delete P;
+}
+
+/*******************************************************************************
+ * Partial results of a shard: the merged histograms
+*******************************************************************************/
+static bool save5(void* data, int nWorkers, long nEvents, TDirectory* dir) {
+  DataTest5Pass* P = (DataTest5Pass*)data;
+  DataTest5Hists* H = P->Out;
+  TDirectory::TContext context;  // Puts gDirectory back afterwards
+
+  mergeWorkerHists(&P->hists, NHISTS5, nWorkers);
+  delete P;
+  if (!dir) return false;
+  dir->cd();
+  for (int w = 0; w < NUMWIRES; w++) writeHist(H->h[w]);
+  writeHist(H->h1);
+  return true;
+}
+
+static bool load5(void* data, int k, TDirectory* dir) {
+  DataTest5Pass* P = (DataTest5Pass*)data;
+  TH1F** h = &P->hists[k * NHISTS5];
+
+  for (int i = 0; i < NHISTS5; i++)
+    if (!addSavedHist(dir, h[i])) return false;
+  return true;
+}
+
+/*******************************************************************************
+ * Books the histograms and registers the pass
+*******************************************************************************/
+void addDataTest5Pass(DCTPipeline* Pipe, DataTest5Hists* H) {
+  int threshval = -100;  // Minimum voltage to be considered an event
+  int nbins = 50;        // Number of bins per histogram
+  int minbin = 0;        // Minimum voltage on hist.
+  int maxbin = 600;      // Max. voltage on hist
+  char histname[10];
+  char titlename[10];
+
+  /* Create & Set basic features of histogram */
+  for (int w = 0; w < NUMWIRES; w++) {
+    snprintf(histname, sizeof histname, "histo%d", w + 1);
+    snprintf(titlename, sizeof titlename, "Wire %d", w + 1);
+    H->h[w] = new TH1F(histname, titlename, nbins, minbin, maxbin);
+    H->h[w]->SetDirectory(0);
+    H->h[w]->GetXaxis()->SetTitle("Max Voltage (V) of on wire (per event)");
+  }
+
+  H->h1 = new TH1F("EventMins", "Max voltage per event (of all wires)", nbins,
+                   minbin, maxbin + 400);  // Min per event
+  H->h1->SetDirectory(0);
+  H->h1->GetXaxis()->SetTitle("Voltage (V)");
+  H->nEvents = 0;
+
+  DataTest5Pass* P = new DataTest5Pass;
+  P->Out = H;
+
+  DCTPass pass;
+  pass.name = "DataTest5";
+  initCuts(&pass.cuts, threshval);
+  pass.maxEvents = NUMEVENTS;
+  pass.data = P;
+  pass.begin = begin5;
+  pass.event = event5;
+  pass.end = end5;
+  pass.save = save5;
+  pass.load = load5;
+  addPass(Pipe, &pass);
+}
+
+/*******************************************************************************
+ * Main
+*******************************************************************************/
+bool runDataTest5(const char* infile, int nThreads, DataTest5Hists* H) {
+  DCTPipeline P;
+  addDataTest5Pass(&P, H);
+  return runPipeline(&P, infile, nThreads) >= 0;
+}
+
+bool runDataTest5Hits(const char* hitsfile, int nThreads, DataTest5Hists* H) {
+  DCTPipeline P;
+  addDataTest5Pass(&P, H);
+  return replayHits(&P, hitsfile, nThreads, HIT_MINVAL) >= 0;
+}
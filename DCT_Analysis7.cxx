@@ -0,0 +1,281 @@
+/*
+ * DCT_ANALYSIS7.cxx
+ *
+ * DataTest7 pass (see DCT_DataTest7.c). Finds mins and maxs for each event,
+ * both per wire and per event (max/min of all wires).
+ *
+ * Fills histogram event start time per wire
+ * Fills histogram of drift time per wire
+ * Integrates dN/dt (dV/dt) to get time-distance relation
+ *
+ * Streams through the whole run, however long: each event only updates the
+ * histograms and running stats, so memory use doesn't grow with the number
+ * of events. Per-wire stats are printed at the end.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "TTree.h"
+
+#define NUMWIRES 8
+
+#include "DCT_Analysis.h"
+#include "DCT_Pipeline.h"
+#include "DCT_Stats.h"
+
+/*******************************************************************************
+ * Running stats filled by the event loop. Each worker thread gets its own set.
+*******************************************************************************/
+typedef struct wireStats {
+  RunningStats start[NUMWIRES];   // Start times of good waves
+  RunningStats drift[NUMWIRES];   // Drift times of good waves
+  RunningStats minval[NUMWIRES];  // Max voltage (wire minimum) of good waves
+  RunningStats dn_dt[NUMWIRES];   // dN/dt of good waves that ended in the ROI
+  RunningStats eventMin;          // Max voltage of all good wires per event
+} wireStats;
+
+/*******************************************************************************
+ * State of the pass. Histograms of worker k start at hists[k * NHISTS7]:
+ * start times, drift times, then radius, NUMWIRES each.
+*******************************************************************************/
+#define NHISTS7 (3 * NUMWIRES)
+
+typedef struct DataTest7Pass {
+  DataTest7Hists* Out;
+  std::vector<TH1F*> hists;
+  std::vector<wireStats> stats;  // One per worker
+} DataTest7Pass;
+
+static void begin7(void* data, int nWorkers, long nEvents) {
+  DataTest7Pass* P = (DataTest7Pass*)data;
+  TH1F* hists[NHISTS7];
+
+  for (int w = 0; w < NUMWIRES; w++) {
+    hists[w] = P->Out->h1[w];
+    hists[NUMWIRES + w] = P->Out->h2[w];
+    hists[2 * NUMWIRES + w] = P->Out->h3[w];
+  }
+  workerHists(hists, NHISTS7, nWorkers, &P->hists);
+
+  P->stats.resize(nWorkers);
+  for (int k = 0; k < nWorkers; k++) {
+    for (int w = 0; w < NUMWIRES; w++) {
+      INIT_STATS(P->stats[k].start[w]);
+      INIT_STATS(P->stats[k].drift[w]);
+      INIT_STATS(P->stats[k].minval[w]);
+      INIT_STATS(P->stats[k].dn_dt[w]);
+    }
+    INIT_STATS(P->stats[k].eventMin);
+  }
+}
+
+static void event7(void* data, int k, const EventROIs* e) {
+  DataTest7Pass* P = (DataTest7Pass*)data;
+  TH1F** h1 = &P->hists[k * NHISTS7];  // Start times
+  TH1F** h2 = h1 + NUMWIRES;           // Drift times
+  TH1F** h3 = h2 + NUMWIRES;           // dN/dt radius
+  wireStats* S = &P->stats[k];
+  const ROI* ROI_sum = e->sum;
+  int eventMin = 0;
+
+  for (int w = 0; w < NUMWIRES; w++) {
+    if (!e->waveGood[w]) continue;
+
+    /* If an event is found, add some data */
+    addStat(&S->start[w], ROI_sum[w].t_eStart);
+    addStat(&S->drift[w], ROI_sum[w].t_eEnd - ROI_sum[w].t_eStart);
+    addStat(&S->minval[w], ROI_sum[w].minval);
+    if (ROI_sum[w].spikeOver) addStat(&S->dn_dt[w], ROI_sum[w].dn_dt);
+
+    /* Determine minimum for all wires in this event */
+    if (eventMin > ROI_sum[w].minval) eventMin = ROI_sum[w].minval;
+
+    /* Add values to histograms. dn_dt stays 0 if the ROI never closed */
+    h1[w]->Fill(ROI_sum[w].t_eStart);
+    h2[w]->Fill(ROI_sum[w].t_eEnd-ROI_sum[w].t_eStart);
+    h3[w]->Fill(ROI_sum[w].dn_dt);
+  }
+  if (eventMin < 0) addStat(&S->eventMin, eventMin);
+}
+
+/*******************************************************************************
+ * Merges the workers into the histograms of Out and stats[0], in worker order
+*******************************************************************************/
+static void mergeWorkers7(DataTest7Pass* P, int nWorkers) {
+  wireStats* S = &P->stats[0];
+
+  mergeWorkerHists(&P->hists, NHISTS7, nWorkers);
+  for (int k = 1; k < nWorkers; k++) {
+    for (int w = 0; w < NUMWIRES; w++) {
+      mergeStats(&S->start[w], &P->stats[k].start[w]);
+      mergeStats(&S->drift[w], &P->stats[k].drift[w]);
+      mergeStats(&S->minval[w], &P->stats[k].minval[w]);
+      mergeStats(&S->dn_dt[w], &P->stats[k].dn_dt[w]);
+    }
+    mergeStats(&S->eventMin, &P->stats[k].eventMin);
+  }
+}
+
+static void end7(void* data, int nWorkers, long nEvents) {
+  DataTest7Pass* P = (DataTest7Pass*)data;
+  wireStats* S = &P->stats[0];
+
+  mergeWorkers7(P, nWorkers);
+
+  /*****************************************************************************
+  * Summary of the run
+  *****************************************************************************/
+  printf("%-24s %10s %10s %10s %8s %8s\n", "", "n", "mean", "rms", "min",
+         "max");
+  for (int w = 0; w < NUMWIRES; w++) {
+    char label[32];
+    sprintf(label, "Wire %d start time", w + 1);
+    printStats(label, &S->start[w]);
+    sprintf(label, "Wire %d drift time", w + 1);
+    printStats(label, &S->drift[w]);
+    sprintf(label, "Wire %d max voltage", w + 1);
+    printStats(label, &S->minval[w]);
+    sprintf(label, "Wire %d dN/dt", w + 1);
+    printStats(label, &S->dn_dt[w]);
+  }
+  printStats("Event max voltage", &S->eventMin);
+
+  P->Out->nEvents = nEvents;
+  delete P;
+}
+
+/*******************************************************************************
+ * Partial results of a shard: the merged histograms, and the running stats as
+ * a tree "stats" with one entry per RunningStats of wireStats, in order
+*******************************************************************************/
+#define NSTATS7 (int)(sizeof(wireStats) / sizeof(RunningStats))
+
+typedef struct StatsRecord {
+  Long64_t n, sum, sum2;
+  Int_t min, max;
+} StatsRecord;
+
+static void makeStatsBranches(TTree* t, StatsRecord* r) {
+  t->Branch("n", &r->n, "n/L");
+  t->Branch("sum", &r->sum, "sum/L");
+  t->Branch("sum2", &r->sum2, "sum2/L");
+  t->Branch("min", &r->min, "min/I");
+  t->Branch("max", &r->max, "max/I");
+}
+
+static bool save7(void* data, int nWorkers, long nEvents, TDirectory* dir) {
+  DataTest7Pass* P = (DataTest7Pass*)data;
+  DataTest7Hists* H = P->Out;
+  TDirectory::TContext context;  // Puts gDirectory back afterwards
+
+  mergeWorkers7(P, nWorkers);
+  wireStats S = P->stats[0];
+  delete P;
+  if (!dir) return false;
+  dir->cd();
+  for (int w = 0; w < NUMWIRES; w++) writeHist(H->h1[w]);
+  for (int w = 0; w < NUMWIRES; w++) writeHist(H->h2[w]);
+  for (int w = 0; w < NUMWIRES; w++) writeHist(H->h3[w]);
+
+  StatsRecord r;
+  TTree* t = new TTree("stats", "DataTest7 running stats");
+  makeStatsBranches(t, &r);
+  for (int i = 0; i < NSTATS7; i++) {
+    const RunningStats* s = (const RunningStats*)&S + i;
+    r.n = s->n;
+    r.sum = s->sum;
+    r.sum2 = s->sum2;
+    r.min = s->min;
+    r.max = s->max;
+    t->Fill();
+  }
+  t->Write();
+  delete t;
+  return true;
+}
+
+static bool load7(void* data, int k, TDirectory* dir) {
+  DataTest7Pass* P = (DataTest7Pass*)data;
+  TH1F** h = &P->hists[k * NHISTS7];
+
+  for (int i = 0; i < NHISTS7; i++)
+    if (!addSavedHist(dir, h[i])) return false;
+
+  StatsRecord r;
+  TTree* t = NULL;
+  dir->GetObject("stats", t);
+  if (!t || t->GetEntries() != NSTATS7) {
+    printf("No DataTest7 stats in %s\n", dir->GetPath());
+    delete t;
+    return false;
+  }
+  t->SetBranchAddress("n", &r.n);
+  t->SetBranchAddress("sum", &r.sum);
+  t->SetBranchAddress("sum2", &r.sum2);
+  t->SetBranchAddress("min", &r.min);
+  t->SetBranchAddress("max", &r.max);
+  for (int i = 0; i < NSTATS7; i++) {
+    RunningStats* s = (RunningStats*)&P->stats[k] + i;
+    t->GetEntry(i);
+    s->n = r.n;
+    s->sum = r.sum;
+    s->sum2 = r.sum2;
+    s->min = r.min;
+    s->max = r.max;
+  }
+  delete t;
+  return true;
+}
+
+/*******************************************************************************
+ * Books the histograms and registers the pass
+*******************************************************************************/
+void addDataTest7Pass(DCTPipeline* Pipe, DataTest7Hists* H) {
+  int threshval = -50;  // (PARAM) Min voltage to be considered an event
+
+  // Histogram properties. Hist number corresponds to canvas
+  for (int w = 0; w < NUMWIRES; w++) {
+    H->h1[w] = histEditor(w, "StartTimes", "Wire", "Event Start Time (t)", 50,
+                          0, 600);
+    H->h2[w] = histEditor(w, "DriftTimes", "Wire", "Drift Time (t)", 30, 0,
+                          60);
+    H->h3[w] = histEditor(w, "Radius", "Wire", "Radius ()", 50, -100, 50);
+  }
+  H->nEvents = 0;
+
+  DataTest7Pass* P = new DataTest7Pass;
+  P->Out = H;
+
+  DCTPass pass;
+  pass.name = "DataTest7";
+  initCuts(&pass.cuts, threshval);
+  pass.maxEvents = -1;  // The whole run
+  pass.data = P;
+  pass.begin = begin7;
+  pass.event = event7;
+  pass.end = end7;
+  pass.save = save7;
+  pass.load = load7;
+  addPass(Pipe, &pass);
+}
+
+/*******************************************************************************
+ * Main
+*******************************************************************************/
+bool runDataTest7(const char* infile, int nThreads, DataTest7Hists* H) {
+  DCTPipeline P;
+  addDataTest7Pass(&P, H);
+  return runPipeline(&P, infile, nThreads) >= 0;
+}
+
+bool runDataTest7Hits(const char* hitsfile, int nThreads, DataTest7Hists* H) {
+  DCTPipeline P;
+  addDataTest7Pass(&P, H);
+  return replayHits(&P, hitsfile, nThreads,
+                    HIT_START | HIT_END | HIT_MINVAL | HIT_DNDT |
+                        HIT_SPIKEOVER) >= 0;
+}
@@ -0,0 +1,485 @@
+/*
+ * DCT_ANALYSIS9.cxx
+ *
+ * DataTest9 pass and fits (see DCT_DataTest9.c). Finds mins and maxs for each
+ * event, both per wire and per event (max/min of all wires).
+ *
+ * Fills dN/dt (drift time) per wire and integrates it to get the
+ * time-distance relation
+ *
+ * Uses wires 3,4,5 (which have similar histograms) to get a new R-t relation.
+ * It depends on the order the events come in, so it is filled at the end in
+ * event order from the drift times, with the running r-t of DCT_RT.h.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "TTree.h"
+
+#define NUMWIRES 8
+#define NUMTSTEPS 1000
+#define NUMEVENTS 10000
+
+#include "DCT_Analysis.h"
+#include "DCT_Calib.h"
+#include "DCT_Fit.h"
+#include "DCT_Parallel.h"
+#include "DCT_Pipeline.h"
+#include "DCT_ROI.h"
+#include "DCT_RT.h"
+
+/*******************************************************************************
+ * State of the pass. dN/dt histograms of worker k start at
+ * hists[k * NUMWIRES]. Per-event results have one row per event, so every
+ * worker writes its own slice, rows [from[k], to[k]).
+*******************************************************************************/
+typedef struct DataTest9Pass {
+  DataTest9Hists* Out;
+  std::vector<TH1F*> hists;
+  per minPerWire[NUMWIRES];
+  per minPerEvent;
+  std::vector<long> from, to;  // -1 until the worker's first event
+} DataTest9Pass;
+
+static void begin9(void* data, int nWorkers, long nEvents) {
+  DataTest9Pass* P = (DataTest9Pass*)data;
+  long rows = nEvents >= 0 && nEvents < NUMEVENTS ? nEvents : NUMEVENTS;
+
+  workerHists(P->Out->h1, NUMWIRES, nWorkers, &P->hists);
+  for (int w = 0; w < NUMWIRES; w++) resizePer(&P->minPerWire[w], rows);
+  resizePer(&P->minPerEvent, rows);
+  P->from.assign(nWorkers, -1);
+  P->to.assign(nWorkers, -1);
+}
+
+static void event9(void* data, int k, const EventROIs* e) {
+  DataTest9Pass* P = (DataTest9Pass*)data;
+  TH1F** h1 = &P->hists[k * NUMWIRES];
+  per* minPerWire = P->minPerWire;
+  per* minPerEvent = &P->minPerEvent;
+  const ROI* ROI_sum = e->sum;
+  const bool* waveGood = e->waveGood;
+  long event = e->event;
+
+  if (P->from[k] < 0) P->from[k] = event;
+  P->to[k] = event + 1;
+
+  /* Find the time of the event + min and max vals */
+  for (int w = 0; w < NUMWIRES; w++) {
+    /* If an event is found, add some data */
+    if (ROI_sum[w].spikeOver && waveGood[w]) {
+      minPerWire[w].integral[event] = ROI_sum[w].integral;
+      minPerWire[w].dn_dt[event] = ROI_sum[w].dn_dt;
+    }
+
+    /* Determine minimum per wire & for all wires in this event */
+    if (minPerWire[w].minvals[event] > ROI_sum[w].minval && waveGood[w])
+      minPerWire[w].minvals[event] = ROI_sum[w].minval;
+    if (minPerEvent->minvals[event] > ROI_sum[w].minval && waveGood[w])
+      minPerEvent->minvals[event] = ROI_sum[w].minval;
+  }
+
+  /* Add values to histograms */
+  for (int w = 0; w < NUMWIRES; w++) {
+    if (waveGood[w]) {
+      minPerWire[w].drift[event] = ROI_sum[w].t_eEnd-ROI_sum[w].t_eStart;
+      h1[w]->Fill(minPerWire[w].drift[event]);
+    }
+  }
+}
+
+static void end9(void* data, int nWorkers, long nEvents) {
+  DataTest9Pass* P = (DataTest9Pass*)data;
+  DataTest9Hists* H = P->Out;
+  per* minPerWire = P->minPerWire;
+
+  if (nEvents > NUMEVENTS) nEvents = NUMEVENTS;
+  mergeWorkerHists(&P->hists, NUMWIRES, nWorkers);
+
+  /* Look for events that occured on the middle 3 wires. Uses dN/dt as it
+   * stood after each event, so it's rebuilt here one event at a time */
+  RTBuilder dNdt[NUMWIRES];
+  RTCurve rt3;       // r-t of wires 3,4,5
+  HistFills drift3;  // Drift times of wires 3,4,5, once per time step
+  for (int i = 2; i < 5; i++) initRT(&dNdt[i], H->h1[i]);
+  initRTCurve(&rt3, H->h3, &dNdt[2], NUMTSTEPS);
+  initFills(&drift3, H->h4);
+  for (long event = 0; event < nEvents; event++) {
+    for (int i = 2; i < 5; i++)
+      if (minPerWire[i].drift[event] >= 0)
+        addDrift(&dNdt[i], minPerWire[i].drift[event]);
+
+    if (minPerWire[2].drift[event] >= 0 && minPerWire[3].drift[event] >= 0 &&
+        minPerWire[4].drift[event] >= 0) {
+      for (int i = 2; i < 5; i++) {
+        double drift = minPerWire[i].drift[event];
+        addRT(&rt3, &dNdt[i]);
+        addFills(&drift3, H->h4->FindFixBin(drift), NUMTSTEPS, 1,
+                 NUMTSTEPS * drift, NUMTSTEPS * drift * drift);
+      }
+    }
+  }
+  writeFills(&rt3.fills, H->h3);
+  writeFills(&drift3, H->h4);
+
+  /* r-t relation per wire, from the integral of dN/dt */
+  for (int w = 0; w < NUMWIRES; w++) {
+    RTBuilder rt;
+    RTCurve curve;
+    initRT(&rt, H->h1[w]);
+    addDriftHist(&rt, H->h1[w]);
+    initRTCurve(&curve, H->h2[w], &rt, NUMTSTEPS);
+    addRT(&curve, &rt);
+    writeFills(&curve.fills, H->h2[w]);
+  }
+
+  H->nEvents = nEvents;
+  delete P;
+}
+
+/*******************************************************************************
+ * Partial results of a shard: the merged dN/dt histograms, and the rows of
+ * the shard's events as a tree "rows", one entry per event
+*******************************************************************************/
+typedef struct RowRecord {
+  Long64_t event;
+  Int_t minvals[NUMWIRES];
+  Int_t integral[NUMWIRES];
+  Int_t dn_dt[NUMWIRES];
+  Int_t drift[NUMWIRES];
+  Int_t eventMin;
+} RowRecord;
+
+static void makeRowBranches(TTree* t, RowRecord* r) {
+  char leaves[32];
+  t->Branch("event", &r->event, "event/L");
+  snprintf(leaves, sizeof leaves, "minvals[%d]/I", NUMWIRES);
+  t->Branch("minvals", r->minvals, leaves);
+  snprintf(leaves, sizeof leaves, "integral[%d]/I", NUMWIRES);
+  t->Branch("integral", r->integral, leaves);
+  snprintf(leaves, sizeof leaves, "dn_dt[%d]/I", NUMWIRES);
+  t->Branch("dn_dt", r->dn_dt, leaves);
+  snprintf(leaves, sizeof leaves, "drift[%d]/I", NUMWIRES);
+  t->Branch("drift", r->drift, leaves);
+  t->Branch("eventMin", &r->eventMin, "eventMin/I");
+}
+
+static bool save9(void* data, int nWorkers, long nEvents, TDirectory* dir) {
+  DataTest9Pass* P = (DataTest9Pass*)data;
+  TDirectory::TContext context;  // Puts gDirectory back afterwards
+  bool ok = dir != NULL;
+
+  mergeWorkerHists(&P->hists, NUMWIRES, nWorkers);
+  if (ok) {
+    dir->cd();
+    for (int w = 0; w < NUMWIRES; w++) writeHist(P->Out->h1[w]);
+
+    RowRecord r;
+    TTree* t = new TTree("rows", "DataTest9 per-event results");
+    makeRowBranches(t, &r);
+    for (int k = 0; k < nWorkers; k++) {
+      for (long event = P->from[k]; event >= 0 && event < P->to[k];
+           event++) {
+        r.event = event;
+        for (int w = 0; w < NUMWIRES; w++) {
+          r.minvals[w] = P->minPerWire[w].minvals[event];
+          r.integral[w] = P->minPerWire[w].integral[event];
+          r.dn_dt[w] = P->minPerWire[w].dn_dt[event];
+          r.drift[w] = P->minPerWire[w].drift[event];
+        }
+        r.eventMin = P->minPerEvent.minvals[event];
+        t->Fill();
+      }
+    }
+    t->Write();
+    delete t;
+  }
+  delete P;
+  return ok;
+}
+
+static bool load9(void* data, int k, TDirectory* dir) {
+  DataTest9Pass* P = (DataTest9Pass*)data;
+  TH1F** h1 = &P->hists[k * NUMWIRES];
+  long rows = P->minPerEvent.minvals.size();
+
+  for (int w = 0; w < NUMWIRES; w++)
+    if (!addSavedHist(dir, h1[w])) return false;
+
+  RowRecord r;
+  TTree* t = NULL;
+  dir->GetObject("rows", t);
+  if (!t) {
+    printf("No DataTest9 rows in %s\n", dir->GetPath());
+    return false;
+  }
+  t->SetBranchAddress("event", &r.event);
+  t->SetBranchAddress("minvals", r.minvals);
+  t->SetBranchAddress("integral", r.integral);
+  t->SetBranchAddress("dn_dt", r.dn_dt);
+  t->SetBranchAddress("drift", r.drift);
+  t->SetBranchAddress("eventMin", &r.eventMin);
+  bool ok = true;
+  for (Long64_t i = 0; ok && i < t->GetEntries(); i++) {
+    t->GetEntry(i);
+    long event = r.event;
+    if (!(ok = event >= 0 && event < rows)) {
+      printf("Event %ld of %s is past the DataTest9 rows\n", event,
+             dir->GetPath());
+      continue;
+    }
+    for (int w = 0; w < NUMWIRES; w++) {
+      P->minPerWire[w].minvals[event] = r.minvals[w];
+      P->minPerWire[w].integral[event] = r.integral[w];
+      P->minPerWire[w].dn_dt[event] = r.dn_dt[w];
+      P->minPerWire[w].drift[event] = r.drift[w];
+    }
+    P->minPerEvent.minvals[event] = r.eventMin;
+  }
+  delete t;
+  return ok;
+}
+
+/*******************************************************************************
+ * Books the histograms and registers the pass
+*******************************************************************************/
+void addDataTest9Pass(DCTPipeline* Pipe, DataTest9Hists* H) {
+  int threshval = -80;  // (PARAM) Min voltage to be considered an event
+
+  // Histogram properties. Hist number corresponds to canvas
+  for (int w = 0; w < NUMWIRES; w++) {
+    H->h1[w] = histEditor(w, "dN/dt", "Wire", "Drift time (t)", 25, 0, 50);
+    H->h2[w] = histEditor(w, "r-t Relation", "Wire", "Drift Time (t)", 30, 0,
+                          60);
+    H->h2[w]->GetYaxis()->SetTitle("R");
+  }
+  H->h3 = histEditor(5, "r-t Relation", "Wires 3-", "Drift Time (t)", 30, 0,
+                     60);
+  H->h4 = histEditor(5, "dN/dt", "Wires 3-", "Drift Time (t)", 25, 0, 50);
+  H->nEvents = 0;
+
+  DataTest9Pass* P = new DataTest9Pass;
+  P->Out = H;
+
+  DCTPass pass;
+  pass.name = "DataTest9";
+  initCuts(&pass.cuts, threshval);
+  pass.maxEvents = NUMEVENTS;
+  pass.data = P;
+  pass.begin = begin9;
+  pass.event = event9;
+  pass.end = end9;
+  pass.save = save9;
+  pass.load = load9;
+  addPass(Pipe, &pass);
+}
+
+/*******************************************************************************
+ * Main
+*******************************************************************************/
+bool runDataTest9(const char* infile, int nThreads, DataTest9Hists* H) {
+  DCTPipeline P;
+  addDataTest9Pass(&P, H);
+  return runPipeline(&P, infile, nThreads) >= 0;
+}
+
+/*******************************************************************************
+ * Fit range: the contiguous bins around the highest one with at least frac of
+ * its content
+*******************************************************************************/
+static void autoRange(const TH1F* h, double frac, double* lo, double* hi) {
+  int peak = h->GetMaximumBin();
+  double cut = frac * h->GetBinContent(peak);
+  int first = peak, last = peak;
+
+  while (first > 1 && h->GetBinContent(first - 1) >= cut) first--;
+  while (last < h->GetNbinsX() && h->GetBinContent(last + 1) >= cut) last++;
+  *lo = h->GetBinLowEdge(first);
+  *hi = h->GetBinLowEdge(last + 1);
+}
+
+/*******************************************************************************
+ * One fit of the engine in DCT_Fit.h. The points are copied out of the
+ * histogram first, so the fit itself doesn't touch ROOT.
+*******************************************************************************/
+typedef struct FitTask {
+  TH1F* h;            // Histogram fit
+  int model;          // FIT_GAUSS, FIT_POL2 or FIT_CHEB5
+  FitData data;       // Non-empty bins with center in [lo, hi]
+  FitResult* result;  // Where the result goes
+} FitTask;
+
+static void addFitTask(std::vector<FitTask>* tasks, TH1F* h, int model,
+                       double lo, double hi, FitResult* result) {
+  FitTask task;
+  task.h = h;
+  task.model = model;
+  task.result = result;
+  result->lo = lo;
+  result->hi = hi;
+  for (int b = 1; b <= h->GetNbinsX(); b++) {
+    double x = h->GetBinCenter(b);
+    double err = h->GetBinError(b);
+    if (x < lo || x > hi || h->GetBinContent(b) == 0 || !(err > 0)) continue;
+    task.data.x.push_back(x);
+    task.data.y.push_back(h->GetBinContent(b));
+    task.data.err.push_back(err);
+  }
+  tasks->push_back(task);
+}
+
+/*******************************************************************************
+ * TF1 of a fit result, also kept in h's list of functions so it shows up
+ * whenever h is drawn
+*******************************************************************************/
+static TF1* fitFunction(const char* name, const FitResult* F, TH1F* h) {
+  const char* formula[] = {"gaus", "pol2", "cheb5"};
+  TF1* f = new TF1(name, formula[F->model], F->lo, F->hi);
+
+  f->SetParameters(F->p);
+  f->SetChisquare(F->chi2);
+  f->SetNDF(F->ndf);
+  if (h) h->GetListOfFunctions()->Add(f->Clone());
+  return f;
+}
+
+/*******************************************************************************
+ * One line of the fit summary
+*******************************************************************************/
+static void printFit(const char* label, const FitResult* F) {
+  const char* model[] = {"gaus", "pol2", "cheb5"};
+  const char* status[] = {"ok", "no conv.", "too few"};
+
+  printf("%-12s %-6s %6.1f %6.1f %12.2f %4d %10.2f %4d  %s\n", label,
+         model[F->model], F->lo, F->hi, F->chi2, F->ndf,
+         F->ndf > 0 ? F->chi2 / F->ndf : 0., F->iterations, status[F->status]);
+}
+
+/*******************************************************************************
+ * Fits dN/dt and r-t per wire and for wires 3,4,5. Fit ranges come from the
+ * dN/dt histograms: the Gaussian and quadratic take the peak, the r-t
+ * Chebyshev the rise, where the drift times are. All fits run at once, up to
+ * nThreads at a time.
+*******************************************************************************/
+void fitDataTest9(DataTest9Hists* H, int nThreads) {
+  double peakFrac = 0.2;   // (PARAM) dN/dt fit down to this fraction of peak
+  double riseFrac = 0.05;  // (PARAM) r-t fit where dN/dt is above this
+  std::vector<FitTask> tasks;
+  double lo, hi;
+
+  for (int w = 0; w < NUMWIRES; w++) {
+    autoRange(H->h1[w], peakFrac, &lo, &hi);
+    addFitTask(&tasks, H->h1[w], FIT_GAUSS, lo, hi, &H->gaussFit[w]);
+    addFitTask(&tasks, H->h1[w], FIT_POL2, lo, hi, &H->quadFit[w]);
+    autoRange(H->h1[w], riseFrac, &lo, &hi);
+    addFitTask(&tasks, H->h2[w], FIT_CHEB5, lo, hi, &H->chebyFit[w]);
+  }
+  autoRange(H->h4, peakFrac, &lo, &hi);
+  addFitTask(&tasks, H->h4, FIT_GAUSS, lo, hi, &H->gauss1Fit);
+  autoRange(H->h4, riseFrac, &lo, &hi);
+  addFitTask(&tasks, H->h3, FIT_CHEB5, lo, hi, &H->chebFit);
+
+  /* Each worker takes the next fit not yet taken */
+  std::atomic<int> next(0);
+  if (nThreads < 1) nThreads = 1;
+  if (nThreads > (int)tasks.size()) nThreads = tasks.size();
+  runWorkers(nThreads, [&](int k) {
+    for (int i = next++; i < (int)tasks.size(); i = next++) {
+      FitTask* task = &tasks[i];
+      FitResult* F = task->result;
+      fitModel(&task->data, task->model, F->lo, F->hi, F);
+    }
+  });
+
+  /*****************************************************************************
+  * Fit functions, with the derivatives and integral of the fits in closed form
+  *****************************************************************************/
+  char name[20];
+  for (int w = 0; w < NUMWIRES; w++) {
+    snprintf(name, sizeof name, "Gauss%d", w + 1);
+    H->gauss[w] = fitFunction(name, &H->gaussFit[w], H->h1[w]);
+    snprintf(name, sizeof name, "Pol2%d", w + 1);
+    H->quad[w] = fitFunction(name, &H->quadFit[w], H->h1[w]);
+    snprintf(name, sizeof name, "Cheby%d", w + 1);
+    H->cheby[w] = fitFunction(name, &H->chebyFit[w], H->h2[w]);
+
+    H->gauss[w]->SetLineColor(kRed);
+    H->quad[w]->SetLineColor(kBlue);
+    H->cheby[w]->SetLineColor(kBlack);
+
+    double tMax = H->chebyFit[w].hi;
+    snprintf(name, sizeof name, "GaussDer%d", w + 1);
+    H->gaussD[w] = new TF1(
+        name, "-[0]*(x-[1])/([2]*[2])*exp(-0.5*((x-[1])/[2])^2)", 3, tMax);
+    H->gaussD[w]->SetParameters(H->gaussFit[w].p);
+    snprintf(name, sizeof name, "Pol2Der%d", w + 1);
+    H->quadD[w] = new TF1(name, "[1]+2*[2]*x", 3, tMax);
+    H->quadD[w]->SetParameters(H->quadFit[w].p);
+
+    H->gaussD[w]->SetLineColor(kRed);
+    H->quadD[w]->SetLineColor(kBlue);
+  }
+
+  /* Wires 3,4,5: R vs. t using a chebyshev & the integral from 0 of the
+   * Gaussian fit of dN/dt. Neither looks very good, unfortunately */
+  H->gauss1 = fitFunction("gaussian", &H->gauss1Fit, H->h4);
+  H->cheb = fitFunction("cheb", &H->chebFit, H->h3);
+  H->iGauss = new TF1("dgaussian",
+                      "[0]*[2]*sqrt(pi/2)*(TMath::Erf((x-[1])/(sqrt(2)*[2]))"
+                      "-TMath::Erf(-[1]/(sqrt(2)*[2])))",
+                      3, H->chebFit.hi);
+  H->iGauss->SetParameters(H->gauss1Fit.p);
+
+  /*****************************************************************************
+  * Summary of the fits
+  *****************************************************************************/
+  printf("%-12s %-6s %6s %6s %12s %4s %10s %4s  %s\n", "", "model", "lo",
+         "hi", "chi2", "ndf", "chi2/ndf", "iter", "status");
+  for (int w = 0; w < NUMWIRES; w++) {
+    char label[20];
+    snprintf(label, sizeof label, "Wire %d", w + 1);
+    printFit(label, &H->gaussFit[w]);
+    printFit(label, &H->quadFit[w]);
+    printFit(label, &H->chebyFit[w]);
+  }
+  printFit("Wires 3-5", &H->gauss1Fit);
+  printFit("Wires 3-5", &H->chebFit);
+}
+
+/*******************************************************************************
+ * Samples the per-wire Chebyshev r-t fits into a calibration table. The fits
+ * only hold over their range, so r is held at its ends outside it.
+*******************************************************************************/
+bool exportRTCalib(const DataTest9Hists* H, const char* outfile, int interp) {
+  std::unique_ptr<RTCalib> table(new RTCalib);  // 64 kB, kept off the stack
+  RTCalib& C = *table;
+  int numPoints = 601;  // (PARAM) 0.1 time steps over the r-t histograms
+
+  TAxis* axis = H->h2[0]->GetXaxis();
+  if (!initRTCalib(&C, NUMWIRES, numPoints, axis->GetXmin(), axis->GetXmax(),
+                   interp))
+    return false;
+
+  for (int w = 0; w < NUMWIRES; w++) {
+    double tLow, tHigh;
+    H->cheby[w]->GetRange(tLow, tHigh);
+    for (int i = 0; i < numPoints; i++) {
+      double t = rtcTime(&C, i);
+      if (t < tLow) t = tLow;
+      if (t > tHigh) t = tHigh;
+      C.r[w][i] = H->cheby[w]->Eval(t);
+    }
+  }
+
+  if (!writeRTCalib(&C, outfile)) {
+    printf("Can't write %s\n", outfile);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,333 @@
+/*
+ * DCT_BATCH.cxx
+ *
+ * Batch mode over many runs (see DCT_Batch.h).
+ *
+ */
+
+#include <glob.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "TFile.h"
+#include "TROOT.h"
+
+#define NUMWIRES 8
+
+#include "DCT_Batch.h"
+#include "DCT_Parallel.h"
+#include "DCT_Stream.h"
+
+/*******************************************************************************
+ * Setup
+*******************************************************************************/
+bool initBatch(DCTBatch* B, const char* tests, int nThreads) {
+  B->run5 = B->run7 = B->run9 = false;
+  for (const char* c = tests; *c; c++) {
+    if (*c == '5') B->run5 = true;
+    else if (*c == '7') B->run7 = true;
+    else if (*c == '9') B->run9 = true;
+    else if (*c != ',') return false;
+  }
+  B->tests = tests;
+  B->nThreads = nThreads < 1 ? 1 : nThreads;
+  B->chunkEvents = BATCH_CHUNKEVENTS;
+  B->channels = NULL;
+  B->readAhead = DCT_READAHEAD;
+  B->runs.clear();
+  memset(&B->campaign, 0, sizeof B->campaign);
+  return B->run5 || B->run7 || B->run9;
+}
+
+/*******************************************************************************
+ * Name of a run: its file name without directory, compression and format
+ * extension (NI_PDCT_17.txt.zst -> NI_PDCT_17)
+*******************************************************************************/
+static std::string runName(const char* path) {
+  const char* base = strrchr(path, '/');
+  std::string name = base ? base + 1 : path;
+
+  if (isCompressed(name.c_str())) name.erase(name.rfind('.'));
+  size_t dot = name.rfind('.');
+  if (dot != std::string::npos && dot > 0) name.erase(dot);
+  return name;
+}
+
+bool addBatchRuns(DCTBatch* B, const char* pattern) {
+  glob_t g;
+
+  if (glob(pattern, 0, NULL, &g) != 0) {
+    printf("No runs match %s\n", pattern);
+    return false;
+  }
+  for (size_t i = 0; i < g.gl_pathc; i++) {
+    BatchRun run;
+    run.infile = g.gl_pathv[i];
+    run.name = runName(g.gl_pathv[i]);
+    run.nEvents = -1;
+    B->runs.push_back(run);
+  }
+  globfree(&g);
+  return true;
+}
+
+bool readRunList(DCTBatch* B, const char* listfile) {
+  FILE* f = fopen(listfile, "r");
+  char line[4096];
+  bool ok = true;
+
+  if (!f) {
+    printf("Can't open %s\n", listfile);
+    return false;
+  }
+  while (ok && fgets(line, sizeof line, f)) {
+    char* hash = strchr(line, '#');
+    if (hash) *hash = '\0';
+    char pattern[4096];
+    if (sscanf(line, " %4095s", pattern) == 1)
+      ok = addBatchRuns(B, pattern);
+  }
+  fclose(f);
+  return ok;
+}
+
+/*******************************************************************************
+ * Campaign histograms: empty copies of the first run's, so they're booked
+ * exactly like the per-run ones
+*******************************************************************************/
+static TH1F* emptyCopy(TH1F* h) {
+  TH1F* c = (TH1F*)h->Clone();
+  c->SetDirectory(0);
+  c->Reset();
+  return c;
+}
+
+static void bookCampaign(CampaignHists* C, const DataTestResults* R) {
+  if (R->run5) {
+    for (int w = 0; w < NUMWIRES; w++)
+      C->maxVoltage[w] = emptyCopy(R->H5.h[w]);
+    C->eventMaxVoltage = emptyCopy(R->H5.h1);
+  }
+  if (R->run7) {
+    for (int w = 0; w < NUMWIRES; w++) {
+      C->start[w] = emptyCopy(R->H7.h1[w]);
+      C->drift[w] = emptyCopy(R->H7.h2[w]);
+    }
+  }
+}
+
+/*******************************************************************************
+ * Adds a run to the campaign. All fills are whole numbers, so the sums don't
+ * depend on the order the runs finish in.
+*******************************************************************************/
+static void addToCampaign(CampaignHists* C, const DataTestResults* R,
+                          long nEvents) {
+  if (R->run5) {
+    for (int w = 0; w < NUMWIRES; w++) C->maxVoltage[w]->Add(R->H5.h[w]);
+    C->eventMaxVoltage->Add(R->H5.h1);
+  }
+  if (R->run7) {
+    for (int w = 0; w < NUMWIRES; w++) {
+      C->start[w]->Add(R->H7.h1[w]);
+      C->drift[w]->Add(R->H7.h2[w]);
+    }
+  }
+  C->nRuns++;
+  C->nEvents += nEvents;
+}
+
+static bool saveCampaign(const DCTBatch* B, const char* outfile) {
+  const CampaignHists* C = &B->campaign;
+  char tmpfile[4096];
+  snprintf(tmpfile, sizeof tmpfile, "%s.tmp", outfile);
+
+  TFile out(tmpfile, "RECREATE");
+  if (out.IsZombie()) {
+    fprintf(stderr, "Can't write %s\n", tmpfile);
+    return false;
+  }
+  if (B->run5) {
+    out.mkdir("DataTest5")->cd();
+    for (int w = 0; w < NUMWIRES; w++) writeHist(C->maxVoltage[w]);
+    writeHist(C->eventMaxVoltage);
+  }
+  if (B->run7) {
+    out.mkdir("DataTest7")->cd();
+    for (int w = 0; w < NUMWIRES; w++) writeHist(C->start[w]);
+    for (int w = 0; w < NUMWIRES; w++) writeHist(C->drift[w]);
+  }
+  out.Close();
+
+  if (rename(tmpfile, outfile) != 0) {
+    fprintf(stderr, "Can't write %s\n", outfile);
+    return false;
+  }
+  return true;
+}
+
+/*******************************************************************************
+ * A run being analyzed: its pipeline, histograms and chunks still running
+*******************************************************************************/
+typedef struct BatchJob {
+  BatchRun* run;
+  DCTPipeline P;
+  DataTestResults R;
+  DCTRun* dctRun;
+  std::atomic<int> left;  // Chunks not done yet
+} BatchJob;
+
+/*******************************************************************************
+ * State shared by the tasks
+*******************************************************************************/
+typedef struct BatchState {
+  DCTBatch* B;
+  DCTPool pool;
+  std::mutex finishing;  // Runs are finished one at a time, so their
+                         // summaries don't mix
+  bool booked;           // Campaign histograms booked
+} BatchState;
+
+/*******************************************************************************
+ * Last step of a run, once all its chunks are done: ends its passes, fits
+ * DataTest9, saves its histograms and adds them to the campaign
+*******************************************************************************/
+static void finishRun(BatchState* S, BatchJob* J) {
+  std::lock_guard<std::mutex> l(S->finishing);
+  DCTBatch* B = S->B;
+  BatchRun* run = J->run;
+
+  long nEvents = closeRun(J->dctRun);
+  if (nEvents >= 0 && J->R.run9) fitDataTest9(&J->R.H9, 1);
+  if (nEvents >= 0 && saveResults(&J->R, run->outfile.c_str())) {
+    if (!S->booked) bookCampaign(&B->campaign, &J->R);
+    S->booked = true;
+    addToCampaign(&B->campaign, &J->R, nEvents);
+    run->nEvents = nEvents;
+  }
+  deleteResults(&J->R);
+  delete J;
+}
+
+/*******************************************************************************
+ * First step of a run: opens it and queues its chunks on this thread, where
+ * they're taken newest first while other threads steal the oldest
+*******************************************************************************/
+static void openTask(BatchState* S, BatchRun* run, int thread) {
+  DCTBatch* B = S->B;
+  BatchJob* J = new BatchJob;
+
+  J->run = run;
+  J->R = DataTestResults();
+  J->R.run5 = B->run5;
+  J->R.run7 = B->run7;
+  J->R.run9 = B->run9;
+  J->P.channels = B->channels;
+  J->P.readAhead = B->readAhead;
+  if (J->R.run5) addDataTest5Pass(&J->P, &J->R.H5);
+  if (J->R.run7) addDataTest7Pass(&J->P, &J->R.H7);
+  if (J->R.run9) addDataTest9Pass(&J->P, &J->R.H9);
+
+  J->dctRun = openRun(&J->P, run->infile.c_str(), B->nThreads);
+  if (!J->dctRun) {
+    deleteResults(&J->R);
+    delete J;
+    return;
+  }
+
+  /* About chunkEvents each, but no more than BATCH_MAXCHUNKS per thread:
+   * enough for the threads to even out, few enough that a huge run doesn't
+   * book thousands of per-chunk histograms */
+  long nEvents = runEvents(J->dctRun);
+  long nChunks = 1;
+  if (nEvents > 0 && B->nThreads > 1) {
+    nChunks = (nEvents + B->chunkEvents - 1) / B->chunkEvents;
+    if (nChunks > BATCH_MAXCHUNKS * B->nThreads)
+      nChunks = BATCH_MAXCHUNKS * B->nThreads;
+  }
+  nChunks = startRun(J->dctRun, nChunks);
+  J->left = nChunks;
+  for (int k = 0; k < nChunks; k++) {
+    poolPush(&S->pool, thread, [S, J, k](int) {
+      runChunk(J->dctRun, k);
+      if (--J->left == 0) finishRun(S, J);
+    });
+  }
+}
+
+/*******************************************************************************
+ * Main
+*******************************************************************************/
+int runBatch(DCTBatch* B, const char* outdir, const char* campaignfile) {
+  if (B->runs.empty()) {
+    printf("No runs\n");
+    return -1;
+  }
+  for (size_t i = 0; i < B->runs.size(); i++) {
+    for (size_t j = 0; j < i; j++) {
+      if (B->runs[i].name == B->runs[j].name) {
+        printf("%s and %s would both be saved as %s.root\n",
+               B->runs[j].infile.c_str(), B->runs[i].infile.c_str(),
+               B->runs[i].name.c_str());
+        return -1;
+      }
+    }
+    B->runs[i].outfile = std::string(outdir) + "/" + B->runs[i].name + ".root";
+    B->runs[i].nEvents = -1;
+  }
+
+  /*****************************************************************************
+  * Opening the runs is spread round robin, biggest files first, so the big
+  * runs get counted and split early and the small ones fill in around them
+  *****************************************************************************/
+  BatchState S;
+  S.B = B;
+  S.booked = false;
+  initPool(&S.pool, B->nThreads);
+  if (B->nThreads > 1) ROOT::EnableThreadSafety();
+
+  std::vector<std::pair<long, size_t> > bySize;
+  for (size_t i = 0; i < B->runs.size(); i++) {
+    struct stat st;
+    long size = stat(B->runs[i].infile.c_str(), &st) == 0 ? st.st_size : 0;
+    bySize.push_back(std::make_pair(-size, i));
+  }
+  std::sort(bySize.begin(), bySize.end());
+  for (size_t n = bySize.size(); n-- > 0;) {  // Biggest taken first
+    BatchRun* run = &B->runs[bySize[n].second];
+    poolPush(&S.pool, n % B->nThreads,
+             [&S, run](int k) { openTask(&S, run, k); });
+  }
+  runPool(&S.pool);
+
+  /*****************************************************************************
+  * Summary and campaign histograms
+  *****************************************************************************/
+  int failed = 0;
+  printf("\n%-32s %10s  %s\n", "Run", "events", "output");
+  for (size_t i = 0; i < B->runs.size(); i++) {
+    const BatchRun* run = &B->runs[i];
+    if (run->nEvents < 0) failed++;
+    printf("%-32s %10ld  %s\n", run->name.c_str(), run->nEvents,
+           run->nEvents < 0 ? "FAILED" : run->outfile.c_str());
+  }
+
+  CampaignHists* C = &B->campaign;
+  if (!B->run5 && !B->run7)
+    printf("No campaign histograms: they come from DataTest5 and 7\n");
+  else if (!C->nRuns)
+    printf("No run done, %s not written\n", campaignfile);
+  else if (saveCampaign(B, campaignfile))
+    printf("Campaign: %ld events of %ld runs -> %s\n", C->nEvents, C->nRuns,
+           campaignfile);
+  else
+    failed++;
+  return failed;
+}
@@ -0,0 +1,99 @@
+/*
+ * DCT_BATCH.h
+ *
+ * Batch mode: the DataTest analyses over a whole campaign of runs, given as a
+ * run list or glob patterns. Every run gets its own histograms, saved to a
+ * file of its own, and the start time, drift time and max voltage histograms
+ * of all runs are added up into a campaign file.
+ *
+ * Runs are opened, and their events split into chunks, by tasks of a
+ * work-stealing pool (see DCT_Parallel.h), so the chunks of all runs share
+ * the threads: a thread done with a small run steals chunks of a big one
+ * instead of idling, and a big run still being counted doesn't hold up the
+ * others. Each chunk is one worker of its run's passes (see startRun()), so
+ * every run's histograms are the ones dct-analyze makes of it, for any number
+ * of threads. Compressed dumps are one chunk (see DCT_Stream.h).
+ *
+ * Usage:
+ *   DCTBatch B;
+ *   initBatch(&B, "5,7", 8);
+ *   addBatchRuns(&B, "NI_PDCT_*.txt");
+ *   runBatch(&B, "out", "out/campaign.root");
+ *
+ */
+
+#ifndef DCT_BATCH_H
+#define DCT_BATCH_H
+
+#include <string>
+#include <vector>
+
+#include "DCT_Analysis.h"
+
+#define BATCH_CHUNKEVENTS 1000  // Default events per chunk
+#define BATCH_MAXCHUNKS 4       // Chunks of a run, at most, per thread
+
+/*******************************************************************************
+ * One run of the campaign
+*******************************************************************************/
+typedef struct BatchRun {
+  std::string infile;
+  std::string name;     // infile without directory and extension
+  std::string outfile;  // Its histograms, set by runBatch()
+  long nEvents;         // Events analyzed, -1 if the run failed
+} BatchRun;
+
+/*******************************************************************************
+ * Histograms of all runs added up
+*******************************************************************************/
+typedef struct CampaignHists {
+  TH1F* maxVoltage[NUMWIRES];  // DataTest5, max voltage per wire
+  TH1F* eventMaxVoltage;       // DataTest5, max voltage per event
+  TH1F* start[NUMWIRES];       // DataTest7, start times
+  TH1F* drift[NUMWIRES];       // DataTest7, drift times
+  long nRuns;                  // Runs added
+  long nEvents;                // Events of those runs
+} CampaignHists;
+
+/*******************************************************************************
+ * The batch: which analyses, how to run them, the runs
+*******************************************************************************/
+typedef struct DCTBatch {
+  bool run5, run7, run9;
+  std::string tests;                     // As given, e.g. "5,7"
+  int nThreads;
+  long chunkEvents;                      // Events per chunk, about
+  const DCTChannelMap* channels;         // NULL for the DAQ's
+  int readAhead;                         // See DCTPipeline
+  std::vector<BatchRun> runs;
+  CampaignHists campaign;                // Filled by runBatch()
+} DCTBatch;
+
+/*******************************************************************************
+ * Sets the analyses (a comma separated list of 5, 7 and 9) and threads.
+ * Returns false if tests isn't such a list.
+*******************************************************************************/
+bool initBatch(DCTBatch* B, const char* tests, int nThreads);
+
+/*******************************************************************************
+ * Adds the files matching a glob pattern (or the file itself, if it has no
+ * wildcards), in name order. Returns false, with a message, if none match.
+*******************************************************************************/
+bool addBatchRuns(DCTBatch* B, const char* pattern);
+
+/*******************************************************************************
+ * Adds the runs of a run list: one file or glob pattern per line, blank lines
+ * and everything after a '#' ignored. Returns false, with a message, if it
+ * can't be read or a pattern matches nothing.
+*******************************************************************************/
+bool readRunList(DCTBatch* B, const char* listfile);
+
+/*******************************************************************************
+ * Analyzes every run, saves its histograms to outdir/<name>.root and the
+ * campaign histograms (of the runs that didn't fail) to campaignfile, and
+ * prints a summary. Returns the number of runs that failed, -1 if nothing
+ * could be run (no runs, two runs with the same name).
+*******************************************************************************/
+int runBatch(DCTBatch* B, const char* outdir, const char* campaignfile);
+
+#endif
@@ -0,0 +1,187 @@
+/*
+ * DCT_BINARY.h
+ *
+ * Compact binary container (.dctb) for NI_PDCT runs. The text dump is
+ * converted once, after which every analysis pass maps the file and works on
+ * the samples in place.
+ *
+ * Layout:
+ *   [0, DCTB_HEADERSIZE)   DCTBHeader, zero padded
+ *   dataOffset + i*eventSize   event i, numAdcs columns of numTsteps int16
+ *                              samples each (sample = adc[iadc][t])
+ *
+ * Samples are stored with the ADC offsets already subtracted. The offsets are
+ * kept in the header for reference. Readings outside the int16 range are
+ * clamped, which still leaves them outside safeMinimum/safeMaximum.
+ *
+ */
+
+#ifndef DCT_BINARY_H
+#define DCT_BINARY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "DCT_Reader.h"
+
+#define DCTB_MAGIC "DCTB"
+#define DCTB_VERSION 1
+#define DCTB_HEADERSIZE 4096
+#define DCTB_MAXADCS 64
+
+/*******************************************************************************
+ * File header. Fixed size, written at the start of the file
+*******************************************************************************/
+typedef struct DCTBHeader {
+  char magic[4];                      // DCTB_MAGIC, no terminator
+  int32_t version;                    // DCTB_VERSION
+  int32_t numAdcs;                    // NUMADCS at conversion time
+  int32_t numTsteps;                  // NUMTSTEPS at conversion time
+  int64_t numEvents;                  // Number of complete events stored
+  int64_t dataOffset;                 // Byte offset of event 0
+  int64_t eventSize;                  // Bytes per event
+  int32_t adcOffsets[DCTB_MAXADCS];   // Offsets subtracted from the samples
+} DCTBHeader;
+
+/*******************************************************************************
+ * State of one mapped .dctb file
+*******************************************************************************/
+typedef struct DCTBReader {
+  int fd;               // File descriptor of the data file
+  size_t size;          // Size of the file in bytes
+  const char* data;     // Start of the mapping
+  DCTBHeader header;    // Copy of the file header
+} DCTBReader;
+
+/*******************************************************************************
+ * True if path names a .dctb file
+*******************************************************************************/
+inline bool isDCTB(const char* path) {
+  size_t n = strlen(path);
+  return n >= 5 && strcmp(path + n - 5, ".dctb") == 0;
+}
+
+/*******************************************************************************
+ * Converts an NI_PDCT text dump to .dctb. Returns the number of events
+ * written, or -1 on error (a write that failed, e.g. a full disk), in which
+ * case the partial outfile is removed.
+*******************************************************************************/
+inline long convertToDCTB(const char* infile, const char* outfile,
+                          const int* offsets) {
+  static int adc[NUMADCS][NUMTSTEPS];
+  static int16_t column[NUMADCS][NUMTSTEPS];
+  DCTReader reader;
+  DCTBHeader header;
+  char pad[DCTB_HEADERSIZE] = {0};
+
+  if (!openReader(&reader, infile)) return -1;
+  FILE* out = fopen(outfile, "wb");
+  if (!out) {
+    closeReader(&reader);
+    return -1;
+  }
+
+  memset(&header, 0, sizeof header);
+  memcpy(header.magic, DCTB_MAGIC, 4);
+  header.version = DCTB_VERSION;
+  header.numAdcs = NUMADCS;
+  header.numTsteps = NUMTSTEPS;
+  header.dataOffset = DCTB_HEADERSIZE;
+  header.eventSize = sizeof column;
+  for (int iadc = 0; iadc < NUMADCS && iadc < DCTB_MAXADCS; iadc++)
+    header.adcOffsets[iadc] = offsets[iadc];
+
+  /* Placeholder header, rewritten once the event count is known */
+  bool ok = fwrite(pad, 1, DCTB_HEADERSIZE, out) == DCTB_HEADERSIZE;
+
+  while (ok && readEvent(&reader, adc, offsets)) {
+    for (int iadc = 0; iadc < NUMADCS; iadc++) {
+      for (int t = 0; t < NUMTSTEPS; t++) {
+        int v = adc[iadc][t];
+        if (v < INT16_MIN) v = INT16_MIN;
+        if (v > INT16_MAX) v = INT16_MAX;
+        column[iadc][t] = (int16_t)v;
+      }
+    }
+    ok = fwrite(column, sizeof column, 1, out) == 1;
+    if (ok) header.numEvents++;
+  }
+  closeReader(&reader);
+
+  memcpy(pad, &header, sizeof header);
+  ok = ok && fseek(out, 0, SEEK_SET) == 0 &&
+       fwrite(pad, 1, DCTB_HEADERSIZE, out) == DCTB_HEADERSIZE;
+  if (fclose(out) != 0) ok = false;
+  if (!ok) {
+    remove(outfile);
+    return -1;
+  }
+
+  return header.numEvents;
+}
+
+/*******************************************************************************
+ * Maps a .dctb file and checks its header against this build's NUMADCS and
+ * NUMTSTEPS. Returns false if it can't be used.
+*******************************************************************************/
+inline bool openDCTB(DCTBReader* r, const char* path) {
+  struct stat st;
+
+  r->data = NULL;
+  r->size = 0;
+  r->fd = open(path, O_RDONLY);
+  if (r->fd < 0) return false;
+  if (fstat(r->fd, &st) < 0 || st.st_size < DCTB_HEADERSIZE) {
+    close(r->fd);
+    r->fd = -1;
+    return false;
+  }
+  r->size = st.st_size;
+
+  void* map = mmap(NULL, r->size, PROT_READ, MAP_SHARED, r->fd, 0);
+  if (map == MAP_FAILED) {
+    close(r->fd);
+    r->fd = -1;
+    return false;
+  }
+  madvise(map, r->size, MADV_SEQUENTIAL);
+  r->data = (const char*)map;
+  memcpy(&r->header, r->data, sizeof r->header);
+
+  const DCTBHeader* h = &r->header;
+  if (memcmp(h->magic, DCTB_MAGIC, 4) != 0 || h->version != DCTB_VERSION ||
+      h->numAdcs != NUMADCS || h->numTsteps != NUMTSTEPS ||
+      h->eventSize != (int64_t)(NUMADCS * NUMTSTEPS * sizeof(int16_t)) ||
+      h->dataOffset + h->numEvents * h->eventSize > (int64_t)r->size) {
+    munmap(map, r->size);
+    close(r->fd);
+    r->fd = -1;
+    r->data = NULL;
+    return false;
+  }
+  return true;
+}
+
+/*******************************************************************************
+ * Unmaps and closes a .dctb file
+*******************************************************************************/
+inline void closeDCTB(DCTBReader* r) {
+  if (r->data) munmap((void*)r->data, r->size);
+  if (r->fd >= 0) close(r->fd);
+  r->fd = -1;
+  r->data = NULL;
+  r->size = 0;
+}
+
+/*******************************************************************************
+ * Returns event i inside the mapping, or NULL past the last event.
+ * Samples of ADC iadc are at [iadc*NUMTSTEPS, (iadc+1)*NUMTSTEPS).
+*******************************************************************************/
+inline const int16_t* dctbEvent(const DCTBReader* r, long i) {
+  if (i < 0 || i >= r->header.numEvents) return NULL;
+  return (const int16_t*)(r->data + r->header.dataOffset +
+                          i * r->header.eventSize);
+}
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ * DCT_CALIB.h
+ *
+ * r-t calibration table (.rtc). The r-t fits of DataTest9 (see
+ * exportRTCalib() in DCT_Analysis.h) are sampled once on a uniform drift time
+ * grid per wire, and hits are converted with driftRadius(), which only
+ * interpolates between table points: no ROOT, no allocation, no integration.
+ *
+ * The file is the RTCalib struct as is, so reading it is one fread() into a
+ * caller-owned table. Radii are in the units of the r-t histograms.
+ *
+ * Usage:
+ *   static RTCalib C;
+ *   if (!readRTCalib(&C, "NI_PDCT_17.rtc")) ...
+ *   float r = driftRadius(&C, wire, t);
+ *
+ */
+
+#ifndef DCT_CALIB_H
+#define DCT_CALIB_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define RTC_MAGIC "DCTR"
+#define RTC_VERSION 1
+#define RTC_MAXWIRES 16
+#define RTC_MAXPOINTS 1024
+
+#define RTC_LINEAR 0  // Interpolation between table points
+#define RTC_CUBIC 1
+
+/*******************************************************************************
+ * The table. Point i of a wire is r at t = tMin + i * tStep; outside the
+ * grid r is held at the first/last point.
+*******************************************************************************/
+typedef struct RTCalib {
+  char magic[4];      // RTC_MAGIC, no terminator
+  int32_t version;    // RTC_VERSION
+  int32_t numWires;   // Wires in the table
+  int32_t numPoints;  // Points per wire, at least 2
+  int32_t interp;     // RTC_LINEAR or RTC_CUBIC
+  float tMin;         // Drift time of point 0
+  float tStep;        // Drift time between points
+  float invStep;      // 1 / tStep
+  float r[RTC_MAXWIRES][RTC_MAXPOINTS];  // Radius per wire and point
+} RTCalib;
+
+/*******************************************************************************
+ * Sets up an empty table of numPoints points per wire over [tMin, tMax].
+ * Returns false if it doesn't fit in RTCalib.
+*******************************************************************************/
+inline bool initRTCalib(RTCalib* C, int numWires, int numPoints, float tMin,
+                        float tMax, int interp) {
+  if (numWires < 1 || numWires > RTC_MAXWIRES || numPoints < 2 ||
+      numPoints > RTC_MAXPOINTS || !(tMax > tMin))
+    return false;
+
+  memset(C, 0, sizeof *C);
+  memcpy(C->magic, RTC_MAGIC, 4);
+  C->version = RTC_VERSION;
+  C->numWires = numWires;
+  C->numPoints = numPoints;
+  C->interp = interp;
+  C->tMin = tMin;
+  C->tStep = (tMax - tMin) / (numPoints - 1);
+  C->invStep = 1 / C->tStep;
+  return true;
+}
+
+/*******************************************************************************
+ * Drift time of point i
+*******************************************************************************/
+inline float rtcTime(const RTCalib* C, int i) { return C->tMin + i * C->tStep; }
+
+/*******************************************************************************
+ * Writes/reads a table. Return false on error, or if the file isn't a table
+ * of this version.
+*******************************************************************************/
+inline bool writeRTCalib(const RTCalib* C, const char* path) {
+  FILE* out = fopen(path, "wb");
+  if (!out) return false;
+  bool ok = fwrite(C, sizeof *C, 1, out) == 1;
+  return fclose(out) == 0 && ok;
+}
+
+inline bool readRTCalib(RTCalib* C, const char* path) {
+  FILE* in = fopen(path, "rb");
+  if (!in) return false;
+  bool ok = fread(C, sizeof *C, 1, in) == 1;
+  fclose(in);
+
+  return ok && memcmp(C->magic, RTC_MAGIC, 4) == 0 &&
+         C->version == RTC_VERSION && C->numWires >= 1 &&
+         C->numWires <= RTC_MAXWIRES && C->numPoints >= 2 &&
+         C->numPoints <= RTC_MAXPOINTS && C->tStep > 0;
+}
+
+/*******************************************************************************
+ * Radius of a hit with drift time t on wire (0 .. numWires-1). Cubic is a
+ * Catmull-Rom spline through the points, so it goes through every point and
+ * needs no coefficients besides the table.
+*******************************************************************************/
+inline float driftRadius(const RTCalib* C, int wire, float t) {
+  const float* r = C->r[wire];
+  int last = C->numPoints - 1;
+  float x = (t - C->tMin) * C->invStep;
+
+  if (!(x > 0)) return r[0];  // Also NaN
+  if (x >= last) return r[last];
+
+  int i = (int)x;
+  float f = x - i;
+  if (C->interp == RTC_LINEAR) return r[i] + f * (r[i + 1] - r[i]);
+
+  float p0 = r[i > 0 ? i - 1 : 0];
+  float p1 = r[i];
+  float p2 = r[i + 1];
+  float p3 = r[i + 2 <= last ? i + 2 : last];
+  return p1 + 0.5f * f * (p2 - p0 + f * (2 * p0 - 5 * p1 + 4 * p2 - p3 +
+                                         f * (3 * (p1 - p2) + p3 - p0)));
+}
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * DCT_CHANNELS.h
+ *
+ * Channel map of the text dumps: which of the NUMADCS columns of a line feed
+ * the left and right ADC of each wire. Only those 2 * NUMWIRES columns are
+ * decoded; the others are stepped over to the next delimiter without being
+ * converted, and once the last used column is read the rest of the line is
+ * skipped with memchr(). Events are decoded into packed rows of NUMCHANNELS
+ * samples, channel 2w the left and 2w + 1 the right ADC of wire w, half the
+ * memory of a full tm[t][iadc] row.
+ *
+ * The default map is the one the DAQ writes: wire w on columns 2w and 2w + 1,
+ * columns 16-31 not connected. A map file changes it, one line per wire:
+ *
+ *   # wire left right   (wires 1-8, columns 0-31)
+ *   1 0 1
+ *   2 3 2
+ *
+ * Wires not in the file keep their default columns.
+ *
+ * Usage:
+ *   DCTChannelMap map;
+ *   if (!readChannelMap(&map, "channels.txt")) ...
+ *   while (readEventChannels(&reader, tm, &map, adc_offsets)) { ... }
+ *
+ */
+
+#ifndef DCT_CHANNELS_H
+#define DCT_CHANNELS_H
+
+#include <stdio.h>
+#include <string.h>
+
+#include "DCT_Reader.h"
+#include "DCT_ROI.h"
+
+/*******************************************************************************
+ * Where the samples of every channel come from. column[] is the map itself,
+ * channel[] and lastColumn are worked out from it by setChannelMap().
+*******************************************************************************/
+typedef struct DCTChannelMap {
+  int column[NUMCHANNELS];  // Column of channel c (2w left, 2w + 1 right)
+  int channel[NUMADCS];     // Channel fed by each column, -1 if not used
+  int lastColumn;           // Last used column, the rest of a line is skipped
+} DCTChannelMap;
+
+/*******************************************************************************
+ * Works out channel[] and lastColumn from column[]. Returns false if a column
+ * is out of range or feeds two channels.
+*******************************************************************************/
+inline bool setChannelMap(DCTChannelMap* map) {
+  for (int iadc = 0; iadc < NUMADCS; iadc++) map->channel[iadc] = -1;
+  map->lastColumn = -1;
+
+  for (int c = 0; c < NUMCHANNELS; c++) {
+    int iadc = map->column[c];
+    if (iadc < 0 || iadc >= NUMADCS || map->channel[iadc] >= 0) return false;
+    map->channel[iadc] = c;
+    if (iadc > map->lastColumn) map->lastColumn = iadc;
+  }
+  return true;
+}
+
+/*******************************************************************************
+ * The DAQ's map: wire w on columns 2w and 2w + 1
+*******************************************************************************/
+inline void initChannelMap(DCTChannelMap* map) {
+  for (int c = 0; c < NUMCHANNELS; c++) map->column[c] = c;
+  setChannelMap(map);
+}
+
+/*******************************************************************************
+ * Reads a map file (see above). Returns false, with a message, if it can't be
+ * read or isn't a valid map.
+*******************************************************************************/
+inline bool readChannelMap(DCTChannelMap* map, const char* path) {
+  FILE* f = fopen(path, "r");
+  char line[256];
+  int nLine = 0;
+
+  initChannelMap(map);
+  if (!f) {
+    printf("Can't open %s\n", path);
+    return false;
+  }
+  while (fgets(line, sizeof line, f)) {
+    int wire, left, right;
+    char extra;
+    nLine++;
+    char* hash = strchr(line, '#');
+    if (hash) *hash = '\0';
+    int n = sscanf(line, "%d %d %d %c", &wire, &left, &right, &extra);
+    if (n <= 0) continue;  // Blank or comment
+    if (n != 3 || wire < 1 || wire > NUMWIRES) {
+      printf("%s:%d: expected 'wire left right', wire 1-%d\n", path, nLine,
+             NUMWIRES);
+      fclose(f);
+      return false;
+    }
+    map->column[2 * (wire - 1)] = left;
+    map->column[2 * (wire - 1) + 1] = right;
+  }
+  fclose(f);
+
+  if (!setChannelMap(map)) {
+    printf("%s: columns must be 0-%d, each feeding one channel\n", path,
+           NUMADCS - 1);
+    return false;
+  }
+  return true;
+}
+
+/*******************************************************************************
+ * Steps over one field without converting it. Returns the position just past
+ * its delimiter, as scanInt() does.
+*******************************************************************************/
+inline const char* skipField(const char* p, const char* end) {
+  while (p < end && *p != ',' && *p != '\n') p++;
+  return p < end ? p + 1 : end;
+}
+
+/*******************************************************************************
+ * Fills tm[t][c] with the next event, channel c read from column
+ * map->column[c] minus that column's offset voltage. Returns false (leaving tm
+ * partially filled) if the file ends mid-event, as readEvent() does.
+*******************************************************************************/
+inline bool readEventChannels(DCTReader* r, int tm[NUMTSTEPS][NUMCHANNELS],
+                              const DCTChannelMap* map, const int* offsets) {
+  const char* p = r->cur;
+  const char* end = r->end;
+  const int last = map->lastColumn;
+
+  for (int t = 0; t < NUMTSTEPS; t++) {
+    if (p >= end || (t == NUMTSTEPS - 1 && !lineComplete(p, end)))
+      return false;
+    for (int iadc = 0; iadc <= last; iadc++) {
+      int c = map->channel[iadc];
+      if (c < 0) {
+        p = skipField(p, end);
+        continue;
+      }
+      p = scanInt(p, end, &tm[t][c]);
+      tm[t][c] -= offsets[iadc];
+    }
+
+    /* Rest of the line, unless the last used column ended it */
+    if (last < NUMADCS - 1 && p < end && p[-1] != '\n') {
+      p = (const char*)memchr(p, '\n', end - p);
+      p = p ? p + 1 : end;
+    }
+  }
+  r->cur = p;
+  return true;
+}
+
+#endif
@@ -0,0 +1,45 @@
+/*
+ * DCT_CONVERT.c
+ *
+ * Converts an NI_PDCT text dump into the binary .dctb format (see
+ * DCT_Binary.h). Only needs to be run once per data file, afterwards the
+ * DataTest macros can be pointed at the .dctb file instead.
+ *
+ * root 'DCT_Convert.c("NI_PDCT_17.txt", "NI_PDCT_17.dctb")'
+ *
+ * An output file ending in .dctz gets the zero-suppressed format instead (see
+ * DCT_ZS.h), with the ROI windows of the DataTest5/7/9 cuts, for archiving:
+ *
+ * root 'DCT_Convert.c("NI_PDCT_17.txt", "NI_PDCT_17.dctz")'
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUMADCS 32
+
+#include "DCT_Binary.h"
+#include "DCT_Cuts.h"
+#include "DCT_ZS.h"
+
+/*******************************************************************************
+ * Main
+*******************************************************************************/
+void DCT_Convert(const char* infile = "NI_PDCT_17.txt",
+                 const char* outfile = "NI_PDCT_17.dctb") {
+  int threshvals[3] = {-100, -50, -80};  // DataTest5, 7 and 9
+  ROIParams cuts[3];
+  long n;
+
+  if (isDCTZ(outfile)) {
+    for (int s = 0; s < 3; s++) initCuts(&cuts[s], threshvals[s]);
+    n = convertToDCTZ(infile, outfile, adc_offsets, cuts, 3);
+  } else {
+    n = convertToDCTB(infile, outfile, adc_offsets);
+  }
+  if (n < 0)
+    std::cout << "Conversion of " << infile << " failed" << std::endl;
+  else
+    std::cout << "Wrote " << n << " events to " << outfile << std::endl;
+}
@@ -0,0 +1,42 @@
+/*
+ * DCT_CUTS.h
+ *
+ * Constants of the NI_PDCT data set: the ADC offset voltages and per-wire
+ * threshold offsets that came with it, and the cuts the DataTest analyses
+ * build from them. Shared by the pipeline and the waveform generator, which
+ * writes its samples with the same offsets.
+ *
+ */
+
+#ifndef DCT_CUTS_H
+#define DCT_CUTS_H
+
+#include "DCT_ROI.h"
+
+#ifndef NUMADCS
+#define NUMADCS 32
+#endif
+
+/*******************************************************************************
+ * Pre-defines based on data stucture and PDCT people
+*******************************************************************************/
+static const int adc_offsets[NUMADCS] = {
+    -1, 1, -6, -7, 3,  4,  -2, -1,
+    0,  1, -3, -2, -1, -1, -1, -1};  // Offset voltages, came with data set
+static const int threshOffset[NUMWIRES] = {
+    0, -7, 2, 0, 3, 2, -1, -7};  // Threshold offsets, came with data set
+
+/*******************************************************************************
+ * Cuts of the NI_PDCT data set (threshold offsets, safe min/max, ROI start
+ * and end) with a threshold of threshval on every wire
+*******************************************************************************/
+inline void initCuts(ROIParams* cuts, int threshval) {
+  for (int i = 0; i < NUMWIRES; i++)
+    cuts->thresh[i] = threshval + threshOffset[i];
+  cuts->safeMinimum = -2000;  // Anything outside the safe min/max gets thrown
+  cuts->safeMaximum = 25;     // out
+  cuts->min_eStart = 2;       // # ROI start time = minloc - min_eStart
+  cuts->threshFrac = 8;  // Inverse % of threshold for event to be over
+}
+
+#endif
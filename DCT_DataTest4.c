@@ -11,6 +11,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "DCT_Index.h"
+#include "DCT_Reader.h"
 
 #define INIT_ROI(X) X = {.minval = 10000, .minloc = -1, .maxval = 10000, .maxloc = -1, .t_eStart = -1, .t_eEnd=0, .spikeOver=0}
 #define NUMWIRES 8
@@ -22,8 +24,11 @@
 {
 	/* Open the data file */
 	char		infile[560] = "NI_PDCT_17.txt";
-	ifstream	in;
-	in.open(infile);
+	DCTReader	reader;
+	if (!openReader(&reader, infile)) {
+		std::cout << "Can't open " << infile << std::endl;
+		return;
+	}
 	
 	/* Pre-Defines based on data structure */
 	int		adc_offsets[NUMADCS] = { -1, 1, -6, -7, 3, 4, -2, -1, 0, 1, 
@@ -49,7 +54,6 @@
 	} ROI;
 
 	Int_t		adc[NUMADCS][NUMTSTEPS];	// Stores adc readings. Last 16 of each row aren't used. 
-	char		cNum[10];					// Used to store file read
 	ROI 		ROI_adc[2 * NUMWIRES];		// Stores relevant data of each ADC
 	ROI			ROI_sum[NUMWIRES];			// Stores relevant data of each wire, or sum of ADCS
 	bool 		waveGood[NUMWIRES];			// Keeps track of events above threshold, but aren't flukes
@@ -57,24 +61,20 @@
 	/* Offset ADC thresholds */
 	for (int i=0; i<NUMWIRES; i++) thresh[i] += threshval + threshOffset[i];
 	
-	/* Temporary: Skip n events. NI_PDCT_17's first registered event is no good */
+	/* Event to show. NI_PDCT_17's first registered event is no good */
 	int n = 1;
-	for (int i = 0 ; i < n*NUMTSTEPS; i++){
-		in.ignore(256, '\n');
-	}
+	
+	/* Jump straight to event n using the offset index (built on first use) */
+	DCTIndex	index;
+	openIndex(&index, &reader, infile);
 	
 	/* Get data from one event */
-	for (int t = 0; t < NUMTSTEPS; t++)
-	{
-		for (int iadc = 0; iadc < NUMADCS - 1; iadc++)
-		{
-			in.getline(cNum, 10, ',');
-			adc[iadc][t] = atoi(cNum);
-			adc[iadc][t] -= adc_offsets[iadc];
-		}
-		in.getline(cNum, 10);
-		adc[31][t] = atoi(cNum);
+	if (!seekEvent(&reader, &index, n) || !readEvent(&reader, adc, adc_offsets)) {
+		std::cout << infile << " has fewer than " << n+1 << " events" << std::endl;
+		closeReader(&reader);
+		return;
 	}
+	closeReader(&reader);
 
 	/* Find the time of the event + min and max vals */
 	for (int w=0; w<NUMWIRES; w++) {
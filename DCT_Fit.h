@@ -0,0 +1,267 @@
+/*
+ * DCT_FIT.h
+ *
+ * Chi-square fits of the drift spectra, without ROOT, so every wire and model
+ * can be fit on its own thread. The models are those of DataTest9 with the
+ * same parameters as ROOT's formulas:
+ *   FIT_GAUSS  "gaus"   p0 * exp(-0.5 * ((x - p1) / p2)^2)
+ *   FIT_POL2   "pol2"   p0 + p1 x + p2 x^2
+ *   FIT_CHEB5  "cheb5"  sum of pk Tk(x), k = 0..5
+ *
+ * Models are evaluated with their analytic gradient in the parameters. The
+ * polynomials are linear in their parameters and are solved in one step; the
+ * Gaussian is fit with Levenberg-Marquardt. Both solve the weighted least
+ * squares problem by QR, which stays accurate for cheb5 at drift times of
+ * tens of ticks where the normal equations don't.
+ *
+ */
+
+#ifndef DCT_FIT_H
+#define DCT_FIT_H
+
+#include <math.h>
+
+#include <vector>
+
+#define FIT_GAUSS 0
+#define FIT_POL2 1
+#define FIT_CHEB5 2
+#define FIT_MAXPAR 6
+
+#define FIT_OK 0           // Converged
+#define FIT_NOCONVERGE 1   // Gaussian didn't converge, last parameters kept
+#define FIT_TOOFEW 2       // Fewer points than parameters, nothing fit
+
+/*******************************************************************************
+ * Points to fit: bin centers, contents and errors of the non-empty bins in
+ * the fit range (as ROOT's default chi-square)
+*******************************************************************************/
+typedef struct FitData {
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> err;
+} FitData;
+
+/*******************************************************************************
+ * Result of one fit
+*******************************************************************************/
+typedef struct FitResult {
+  int model;               // FIT_GAUSS, FIT_POL2 or FIT_CHEB5
+  int status;              // FIT_OK, FIT_NOCONVERGE or FIT_TOOFEW
+  int npar;                // Parameters of the model
+  double p[FIT_MAXPAR];    // Fitted parameters
+  double chi2;             // Chi-square at p
+  int ndf;                 // Points - parameters
+  double lo, hi;           // Fit range
+  int iterations;          // Gaussian steps taken (1 for the polynomials)
+} FitResult;
+
+inline int fitNPar(int model) {
+  return model == FIT_GAUSS ? 3 : model == FIT_POL2 ? 3 : 6;
+}
+
+/*******************************************************************************
+ * Model value at x, and its gradient in the parameters if grad isn't NULL
+*******************************************************************************/
+inline double fitEval(int model, const double* p, double x, double* grad) {
+  if (model == FIT_GAUSS) {
+    double u = (x - p[1]) / p[2];
+    double e = exp(-0.5 * u * u);
+    if (grad) {
+      grad[0] = e;
+      grad[1] = p[0] * e * u / p[2];
+      grad[2] = p[0] * e * u * u / p[2];
+    }
+    return p[0] * e;
+  }
+
+  // Polynomials: the value is the basis dotted with p, the basis is the
+  // gradient. Chebyshev basis by the recurrence T(k+1) = 2x T(k) - T(k-1)
+  double basis[FIT_MAXPAR];
+  int npar = fitNPar(model);
+  basis[0] = 1;
+  basis[1] = x;
+  for (int k = 2; k < npar; k++)
+    basis[k] = model == FIT_POL2 ? basis[k - 1] * x
+                                 : 2 * x * basis[k - 1] - basis[k - 2];
+
+  double f = 0;
+  for (int k = 0; k < npar; k++) {
+    f += p[k] * basis[k];
+    if (grad) grad[k] = basis[k];
+  }
+  return f;
+}
+
+/*******************************************************************************
+ * Chi-square of p over the points
+*******************************************************************************/
+inline double fitChi2(int model, const double* p, const FitData* D) {
+  double chi2 = 0;
+  for (size_t i = 0; i < D->x.size(); i++) {
+    double r = (D->y[i] - fitEval(model, p, D->x[i], NULL)) / D->err[i];
+    chi2 += r * r;
+  }
+  return chi2;
+}
+
+/*******************************************************************************
+ * Least squares solution of A s = b, A being rows x cols stored row by row
+ * (rows >= cols). Columns are scaled to unit length and orthogonalized by
+ * modified Gram-Schmidt. Returns false if A is singular. A and b are used as
+ * scratch.
+*******************************************************************************/
+inline bool solveLeastSquares(double* A, double* b, int rows, int cols,
+                              double* s) {
+  double scale[FIT_MAXPAR];
+  double R[FIT_MAXPAR][FIT_MAXPAR];
+  double qb[FIT_MAXPAR];
+
+  for (int j = 0; j < cols; j++) {
+    double norm = 0;
+    for (int i = 0; i < rows; i++) norm += A[i * cols + j] * A[i * cols + j];
+    if (!(norm > 0)) return false;
+    scale[j] = 1 / sqrt(norm);
+    for (int i = 0; i < rows; i++) A[i * cols + j] *= scale[j];
+  }
+
+  for (int j = 0; j < cols; j++) {
+    double norm = 0;
+    for (int i = 0; i < rows; i++) norm += A[i * cols + j] * A[i * cols + j];
+    norm = sqrt(norm);
+    if (!(norm > 1e-12)) return false;
+    R[j][j] = norm;
+    for (int i = 0; i < rows; i++) A[i * cols + j] /= norm;
+
+    for (int l = j + 1; l < cols; l++) {
+      double dot = 0;
+      for (int i = 0; i < rows; i++) dot += A[i * cols + j] * A[i * cols + l];
+      R[j][l] = dot;
+      for (int i = 0; i < rows; i++) A[i * cols + l] -= dot * A[i * cols + j];
+    }
+    double dot = 0;
+    for (int i = 0; i < rows; i++) dot += A[i * cols + j] * b[i];
+    qb[j] = dot;
+    for (int i = 0; i < rows; i++) b[i] -= dot * A[i * cols + j];
+  }
+
+  for (int j = cols - 1; j >= 0; j--) {
+    double v = qb[j];
+    for (int l = j + 1; l < cols; l++) v -= R[j][l] * s[l];
+    s[j] = v / R[j][j];
+  }
+  for (int j = 0; j < cols; j++) s[j] *= scale[j];
+  return true;
+}
+
+/*******************************************************************************
+ * Gaussian starting values: height, mean and rms of the points
+*******************************************************************************/
+inline void gaussStart(const FitData* D, double* p) {
+  double sum = 0, sumx = 0, sumx2 = 0, ymax = 0;
+  for (size_t i = 0; i < D->x.size(); i++) {
+    double y = D->y[i] > 0 ? D->y[i] : 0;
+    sum += y;
+    sumx += y * D->x[i];
+    sumx2 += y * D->x[i] * D->x[i];
+    if (D->y[i] > ymax) ymax = D->y[i];
+  }
+  double mean = sum > 0 ? sumx / sum : 0.5 * (D->x.front() + D->x.back());
+  double var = sum > 0 ? sumx2 / sum - mean * mean : 0;
+  double width = D->x.size() > 1 ? (D->x.back() - D->x.front()) /
+                                       (D->x.size() - 1)
+                                 : 1;
+  p[0] = ymax;
+  p[1] = mean;
+  p[2] = var > 0.25 * width * width ? sqrt(var) : 0.5 * width;
+}
+
+/*******************************************************************************
+ * Fits model to the points in [lo, hi]
+*******************************************************************************/
+inline void fitModel(const FitData* D, int model, double lo, double hi,
+                     FitResult* F) {
+  int n = D->x.size();
+  int npar = fitNPar(model);
+  double grad[FIT_MAXPAR];
+
+  F->model = model;
+  F->npar = npar;
+  F->lo = lo;
+  F->hi = hi;
+  F->ndf = n - npar;
+  F->iterations = 0;
+  F->chi2 = 0;
+  for (int k = 0; k < FIT_MAXPAR; k++) F->p[k] = 0;
+  if (n < npar) {
+    F->status = FIT_TOOFEW;
+    return;
+  }
+
+  /* Polynomials: one linear least squares step */
+  std::vector<double> A((n + npar) * npar), b(n + npar);
+  if (model != FIT_GAUSS) {
+    for (int i = 0; i < n; i++) {
+      fitEval(model, F->p, D->x[i], grad);
+      for (int k = 0; k < npar; k++) A[i * npar + k] = grad[k] / D->err[i];
+      b[i] = D->y[i] / D->err[i];
+    }
+    F->status =
+        solveLeastSquares(&A[0], &b[0], n, npar, F->p) ? FIT_OK : FIT_TOOFEW;
+    F->chi2 = fitChi2(model, F->p, D);
+    F->iterations = 1;
+    return;
+  }
+
+  /* Gaussian: Levenberg-Marquardt. Each step solves the damped problem
+   * [J; sqrt(lambda) D] s = [r; 0], D the column norms of J */
+  double lambda = 1e-3;
+  gaussStart(D, F->p);
+  F->chi2 = fitChi2(model, F->p, D);
+  F->status = FIT_NOCONVERGE;
+
+  for (int iter = 0; iter < 200; iter++) {
+    double norm2[FIT_MAXPAR] = {0};
+    for (int i = 0; i < n; i++) {
+      double f = fitEval(model, F->p, D->x[i], grad);
+      for (int k = 0; k < npar; k++) {
+        A[i * npar + k] = grad[k] / D->err[i];
+        norm2[k] += A[i * npar + k] * A[i * npar + k];
+      }
+      b[i] = (D->y[i] - f) / D->err[i];
+    }
+    for (int k = 0; k < npar; k++) {
+      for (int l = 0; l < npar; l++)
+        A[(n + k) * npar + l] = k == l ? sqrt(lambda * norm2[k]) : 0;
+      b[n + k] = 0;
+    }
+    F->iterations = iter + 1;
+
+    double step[FIT_MAXPAR];
+    if (!solveLeastSquares(&A[0], &b[0], n + npar, npar, step)) break;
+
+    double trial[FIT_MAXPAR];
+    for (int k = 0; k < npar; k++) trial[k] = F->p[k] + step[k];
+    double chi2 = fitChi2(model, trial, D);
+
+    if (chi2 <= F->chi2) {
+      bool done = F->chi2 - chi2 <= 1e-10 * (F->chi2 + 1e-30);
+      for (int k = 0; k < npar; k++) F->p[k] = trial[k];
+      F->chi2 = chi2;
+      lambda *= 0.1;
+      if (done) {
+        F->status = FIT_OK;
+        break;
+      }
+    } else {
+      lambda *= 10;
+      if (lambda > 1e10) {  // No step lowers chi2: at the minimum
+        F->status = FIT_OK;
+        break;
+      }
+    }
+  }
+  if (F->p[2] < 0) F->p[2] = -F->p[2];  // Same curve, as ROOT reports it
+}
+
+#endif
@@ -0,0 +1,326 @@
+/*
+ * DCT_GENERATOR.h
+ *
+ * Synthetic NI_PDCT events with known answers. Each event is a block of
+ * NUMTSTEPS lines of NUMADCS comma separated readings, as the DAQ writes
+ * them, with the ADC offsets of the data set (DCT_Cuts.h) and Gaussian noise
+ * on every channel. Wires 1-8 (ADCs 0-15) get pulses:
+ *   - start time uniform in [startMin, startMax]
+ *   - length (the drift time the DataTest analyses measure) drawn from a
+ *     known distribution
+ *   - box, triangle or exponential shape, with the height uniform in
+ *     [ampMin, ampMax] and split at random between the left and right ADC
+ * Wires are hit independently, or together as a track crossing trackWires
+ * neighbouring wires. Some pulses saturate the ADCs (clipped at
+ * 'saturation', below safeMinimum) and some wires get a glitch sample above
+ * safeMaximum; the ROI finder should throw both away.
+ *
+ * Every event only depends on the seed and its event number, so any range of
+ * events can be made on its own (and in parallel) and always comes out the
+ * same. GenTruth holds what went into each event.
+ *
+ * Usage:
+ *   GenParams G;
+ *   GenNoise N;
+ *   initGenParams(&G);  // then change what's needed
+ *   initGenNoise(&N, G.noise);
+ *   generateEvent(&G, &N, event, &truth, tm);
+ *
+ */
+
+#ifndef DCT_GENERATOR_H
+#define DCT_GENERATOR_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "DCT_Cuts.h"
+
+#ifndef NUMTSTEPS
+#define NUMTSTEPS 1000
+#endif
+
+#define GEN_BOX 0       // Flat for the whole length
+#define GEN_TRIANGLE 1  // Linear rise over riseTime, linear fall to the end
+#define GEN_EXP 2       // Linear rise over riseTime, exponential tail down to
+                        // 5% at the end
+
+#define GEN_UNIFORM 0   // Length uniform in [driftA, driftB]
+#define GEN_GAUSS 1     // Length Gaussian, mean driftA, sigma driftB
+
+#define GEN_SATURATED 1  // Flags of GenHit
+#define GEN_GLITCH 2
+
+/*******************************************************************************
+ * What to generate
+*******************************************************************************/
+typedef struct GenParams {
+  uint64_t seed;      // Same seed, same events
+  int shape;          // GEN_BOX, GEN_TRIANGLE or GEN_EXP
+  int riseTime;       // Time steps to the peak (triangle, exp)
+  int ampMin;         // Range of pulse heights of the wire sum, in ADC
+  int ampMax;         // counts (pulses go negative)
+  double lrMin;       // Range of the fraction of the pulse on the left ADC
+  double lrMax;
+  double noise;       // Noise rms per sample
+  int driftDist;      // GEN_UNIFORM or GEN_GAUSS
+  double driftA;      // Drift time distribution parameters (see above)
+  double driftB;
+  int startMin;       // Range of pulse start times
+  int startMax;
+  double pHit;        // Chance of a hit, per wire (events without a track)
+  double pTrack;      // Chance of an event being a track
+  int trackWires;     // Neighbouring wires a track hits
+  int trackJitter;    // Start times of a track differ by up to this much
+  double pSaturate;   // Chance of a hit saturating
+  int saturation;     // Lowest reading an ADC gives
+  double pGlitch;     // Chance of a glitch sample, per wire
+  int glitchValue;    // Reading of a glitch sample
+} GenParams;
+
+inline void initGenParams(GenParams* G) {
+  G->seed = 1;
+  G->shape = GEN_BOX;
+  G->riseTime = 3;
+  G->ampMin = 100;
+  G->ampMax = 700;
+  G->lrMin = 0.3;
+  G->lrMax = 0.7;
+  G->noise = 2;
+  G->driftDist = GEN_UNIFORM;
+  G->driftA = 5;
+  G->driftB = 45;
+  G->startMin = 100;
+  G->startMax = 500;
+  G->pHit = 0.5;
+  G->pTrack = 0.3;
+  G->trackWires = 3;
+  G->trackJitter = 2;
+  G->pSaturate = 0.01;
+  G->saturation = -2048;
+  G->pGlitch = 0.01;
+  G->glitchValue = 100;
+}
+
+/*******************************************************************************
+ * What went into one event
+*******************************************************************************/
+typedef struct GenHit {
+  int start;  // First time step of the pulse, -1 for no hit
+  int drift;  // Length of the pulse in time steps
+  int amp;    // Height of the pulse (wire sum, before saturation)
+  int flags;  // GEN_SATURATED, GEN_GLITCH
+} GenHit;
+
+typedef struct GenTruth {
+  long event;
+  bool track;              // Hits come from a track
+  GenHit hit[NUMWIRES];
+} GenTruth;
+
+/*******************************************************************************
+ * Random numbers: splitmix64 seeded from (seed, event), so events don't
+ * depend on each other
+*******************************************************************************/
+typedef struct GenRandom {
+  uint64_t state;
+  double spare;     // Second Gaussian of the last Box-Muller pair
+  bool haveSpare;
+} GenRandom;
+
+inline uint64_t genNext(GenRandom* r) {
+  uint64_t z = (r->state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+inline void genSeed(GenRandom* r, uint64_t seed, long event) {
+  r->state = seed * 0xD1B54A32D192ED03ULL + (uint64_t)event;
+  r->spare = 0;
+  r->haveSpare = false;
+  genNext(r);
+}
+
+inline double genUniform(GenRandom* r) {  // [0, 1)
+  return (genNext(r) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+inline int genInt(GenRandom* r, int a, int b) {  // [a, b]
+  return a + (int)(genUniform(r) * (b - a + 1));
+}
+
+inline double genGauss(GenRandom* r) {
+  if (r->haveSpare) {
+    r->haveSpare = false;
+    return r->spare;
+  }
+  double u = 1 - genUniform(r);  // (0, 1], log() stays finite
+  double v = genUniform(r);
+  double m = sqrt(-2 * log(u));
+  r->spare = m * sin(2 * M_PI * v);
+  r->haveSpare = true;
+  return m * cos(2 * M_PI * v);
+}
+
+/*******************************************************************************
+ * Noise samples. The readings are whole numbers, so the noise is a Gaussian
+ * of the given rms rounded to the nearest integer; it's drawn from a table of
+ * its quantiles, four samples per random number. The table resolves
+ * probabilities down to 2^-16, so the tails are cut a bit beyond 4 sigma.
+*******************************************************************************/
+#define GEN_NOISEBITS 16
+
+typedef struct GenNoise {
+  int16_t value[1 << GEN_NOISEBITS];  // Noise at quantile (i + 0.5) / 2^16
+} GenNoise;
+
+inline void initGenNoise(GenNoise* N, double rms) {
+  int k = rms > 0 ? -(int)ceil(10 * rms) - 1 : 0;
+  for (int i = 0; i < (1 << GEN_NOISEBITS); i++) {
+    double u = (i + 0.5) / (1 << GEN_NOISEBITS);
+    while (rms > 0 && 0.5 * erfc(-(k + 0.5) / (rms * M_SQRT2)) < u) k++;
+    N->value[i] = k;
+  }
+}
+
+/*******************************************************************************
+ * Pulse height at u time steps into a pulse of length drift, as a fraction
+ * of its peak
+*******************************************************************************/
+inline double genShape(const GenParams* G, int u, int drift) {
+  int rise = G->riseTime < drift ? G->riseTime : drift;
+  if (G->shape == GEN_BOX) return 1;
+  if (u < rise) return (u + 1.0) / rise;
+  if (G->shape == GEN_TRIANGLE) return (double)(drift - u) / (drift - rise + 1);
+  return exp(-3.0 * (u - rise) / (drift - rise + 1));
+}
+
+/*******************************************************************************
+ * Draws one hit
+*******************************************************************************/
+inline void genHit(const GenParams* G, GenRandom* r, int start, GenHit* h) {
+  double d = G->driftDist == GEN_GAUSS
+                 ? G->driftA + G->driftB * genGauss(r)
+                 : G->driftA + (G->driftB - G->driftA) * genUniform(r);
+  h->start = start;
+  h->drift = d < 1 ? 1 : (int)lround(d);
+  h->amp = genInt(r, G->ampMin, G->ampMax);
+  if (genUniform(r) < G->pSaturate) {
+    h->amp = -4 * G->saturation;  // Way past what both ADCs can give
+    h->flags |= GEN_SATURATED;
+  }
+}
+
+/*******************************************************************************
+ * Makes event 'event': its truth and its readings tm[t][iadc], as written to
+ * the file (offsets included)
+*******************************************************************************/
+inline void generateEvent(const GenParams* G, const GenNoise* N, long event,
+                          GenTruth* T, int tm[NUMTSTEPS][NUMADCS]) {
+  GenRandom r;
+  genSeed(&r, G->seed, event);
+
+  /* Which wires are hit, when and how */
+  T->event = event;
+  T->track = genUniform(&r) < G->pTrack;
+  for (int w = 0; w < NUMWIRES; w++) {
+    T->hit[w].start = -1;
+    T->hit[w].drift = T->hit[w].amp = T->hit[w].flags = 0;
+  }
+  if (T->track) {
+    int n = G->trackWires < NUMWIRES ? G->trackWires : NUMWIRES;
+    int first = genInt(&r, 0, NUMWIRES - n);
+    int start = genInt(&r, G->startMin, G->startMax);
+    for (int w = first; w < first + n; w++) {
+      int s = start + genInt(&r, -G->trackJitter, G->trackJitter);
+      genHit(G, &r, s < 0 ? 0 : s, &T->hit[w]);
+    }
+  } else {
+    for (int w = 0; w < NUMWIRES; w++)
+      if (genUniform(&r) < G->pHit)
+        genHit(G, &r, genInt(&r, G->startMin, G->startMax), &T->hit[w]);
+  }
+
+  /* Offsets and noise everywhere */
+  int* sample = &tm[0][0];
+  for (int i = 0; i < NUMTSTEPS * NUMADCS; i += 4) {
+    uint64_t bits = genNext(&r);
+    for (int j = 0; j < 4; j++, bits >>= GEN_NOISEBITS)
+      sample[i + j] = adc_offsets[(i + j) % NUMADCS] +
+                      N->value[bits & ((1 << GEN_NOISEBITS) - 1)];
+  }
+
+  /* Pulses, split between the left and right ADC */
+  for (int w = 0; w < NUMWIRES; w++) {
+    const GenHit* h = &T->hit[w];
+    if (h->start < 0) continue;
+    double lr = G->lrMin + (G->lrMax - G->lrMin) * genUniform(&r);
+    for (int u = 0; u < h->drift && h->start + u < NUMTSTEPS; u++) {
+      int v = (int)lround(h->amp * genShape(G, u, h->drift));
+      int left = (int)lround(v * lr);
+      tm[h->start + u][2 * w] -= left;
+      tm[h->start + u][2 * w + 1] -= v - left;
+    }
+  }
+
+  /* ADCs can't go lower than saturation */
+  for (int t = 0; t < NUMTSTEPS; t++)
+    for (int iadc = 0; iadc < 2 * NUMWIRES; iadc++)
+      if (tm[t][iadc] < G->saturation) tm[t][iadc] = G->saturation;
+
+  /* Glitches: one sample of one ADC of the wire */
+  for (int w = 0; w < NUMWIRES; w++) {
+    if (genUniform(&r) >= G->pGlitch) continue;
+    tm[genInt(&r, 0, NUMTSTEPS - 1)][2 * w + genInt(&r, 0, 1)] =
+        G->glitchValue;
+    T->hit[w].flags |= GEN_GLITCH;
+  }
+}
+
+/*******************************************************************************
+ * Writes the event as text to out, which needs GEN_EVENTSIZE bytes. Returns
+ * the end of what was written.
+*******************************************************************************/
+#define GEN_EVENTSIZE (NUMTSTEPS * NUMADCS * 12)
+
+inline char* formatEvent(int tm[NUMTSTEPS][NUMADCS], char* out) {
+  for (int t = 0; t < NUMTSTEPS; t++) {
+    for (int iadc = 0; iadc < NUMADCS; iadc++) {
+      int v = tm[t][iadc];
+      char digits[12];
+      int n = 0;
+      unsigned u = v < 0 ? -(unsigned)v : v;
+      do {
+        digits[n++] = '0' + u % 10;
+        u /= 10;
+      } while (u);
+      if (v < 0) *out++ = '-';
+      while (n) *out++ = digits[--n];
+      *out++ = iadc == NUMADCS - 1 ? '\n' : ',';
+    }
+  }
+  return out;
+}
+
+/*******************************************************************************
+ * Ground truth: one line per wire that got a hit or a glitch,
+ *   event,wire,start,end,amp,flags
+ * with wires counted from 1 and end = start + drift (one past the pulse).
+ * Returns the end of what was written; out needs GEN_TRUTHSIZE bytes.
+*******************************************************************************/
+#define GEN_TRUTHSIZE (NUMWIRES * 80)
+#define GEN_TRUTHHEADER "# event,wire,start,end,amp,flags\n"
+
+inline char* formatTruth(const GenTruth* T, char* out) {
+  for (int w = 0; w < NUMWIRES; w++) {
+    const GenHit* h = &T->hit[w];
+    if (h->start < 0 && !h->flags) continue;
+    out += sprintf(out, "%ld,%d,%d,%d,%d,%d\n", T->event, w + 1, h->start,
+                   h->start < 0 ? -1 : h->start + h->drift, h->amp, h->flags);
+  }
+  return out;
+}
+
+#endif
@@ -0,0 +1,139 @@
+/*
+ * DCT_HIST.cxx
+ *
+ * Histogram booking and saving shared by the libdct analyses and drivers.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "TDirectory.h"
+#include "TFile.h"
+
+#include "DCT_Analysis.h"
+
+/*******************************************************************************
+ * Sets several histogram properties
+*******************************************************************************/
+TH1F* histEditor(int hNum, const char* type, const char* label,
+                 const char* axis, int n, int nmin, int nmax) {
+  TH1F* h;
+  // Naming schemes
+  char histname[100];
+  char titlename[100];
+  snprintf(histname, sizeof histname, "%s %d", type, hNum + 1);
+  snprintf(titlename, sizeof titlename, "%s %d", label, hNum + 1);
+  // Hist creation + ownership
+  h = new TH1F(histname, titlename, n, nmin, nmax);
+  h->SetDirectory(0);
+  h->GetXaxis()->SetTitle(axis);
+
+  return h;
+}
+
+/*******************************************************************************
+ * Saving
+*******************************************************************************/
+static void histKey(const TH1F* h, char* key, size_t size) {
+  snprintf(key, size, "%s", h->GetName());
+  for (char* c = key; *c; c++)
+    if (*c == '/' || *c == ' ') *c = '_';
+}
+
+void writeHist(TH1F* h) {
+  char key[100];
+  histKey(h, key, sizeof key);
+  h->Write(key);
+}
+
+bool addSavedHist(TDirectory* dir, TH1F* h) {
+  char key[100];
+  TH1F* saved = NULL;
+
+  histKey(h, key, sizeof key);
+  if (dir) dir->GetObject(key, saved);
+  if (!saved) {
+    printf("No %s in %s\n", key, dir ? dir->GetPath() : "partial result");
+    return false;
+  }
+  bool same = saved->GetNbinsX() == h->GetNbinsX() &&
+              saved->GetXaxis()->GetXmin() == h->GetXaxis()->GetXmin() &&
+              saved->GetXaxis()->GetXmax() == h->GetXaxis()->GetXmax();
+  if (same) h->Add(saved);
+  else printf("%s in %s is binned differently\n", key, dir->GetPath());
+  delete saved;
+  return same;
+}
+
+bool saveResults(const DataTestResults* R, const char* outfile) {
+  char tmpfile[4096];
+  snprintf(tmpfile, sizeof tmpfile, "%s.tmp", outfile);
+
+  TFile out(tmpfile, "RECREATE");
+  if (out.IsZombie()) {
+    fprintf(stderr, "Can't write %s\n", tmpfile);
+    return false;
+  }
+
+  if (R->run5) {
+    out.mkdir("DataTest5")->cd();
+    for (int w = 0; w < NUMWIRES; w++) writeHist(R->H5.h[w]);
+    writeHist(R->H5.h1);
+  }
+  if (R->run7) {
+    out.mkdir("DataTest7")->cd();
+    for (int w = 0; w < NUMWIRES; w++) writeHist(R->H7.h1[w]);
+    for (int w = 0; w < NUMWIRES; w++) writeHist(R->H7.h2[w]);
+    for (int w = 0; w < NUMWIRES; w++) writeHist(R->H7.h3[w]);
+  }
+  if (R->run9) {
+    out.mkdir("DataTest9")->cd();
+    for (int w = 0; w < NUMWIRES; w++) writeHist(R->H9.h1[w]);
+    for (int w = 0; w < NUMWIRES; w++) writeHist(R->H9.h2[w]);
+    writeHist(R->H9.h3);
+    writeHist(R->H9.h4);
+  }
+  out.Close();
+
+  if (rename(tmpfile, outfile) != 0) {
+    fprintf(stderr, "Can't write %s\n", outfile);
+    return false;
+  }
+  return true;
+}
+
+/*******************************************************************************
+ * Cleanup
+*******************************************************************************/
+void deleteResults(DataTestResults* R) {
+  if (R->run5) {
+    for (int w = 0; w < NUMWIRES; w++) delete R->H5.h[w];
+    delete R->H5.h1;
+  }
+  if (R->run7) {
+    for (int w = 0; w < NUMWIRES; w++) {
+      delete R->H7.h1[w];
+      delete R->H7.h2[w];
+      delete R->H7.h3[w];
+    }
+  }
+  if (R->run9) {
+    DataTest9Hists* H = &R->H9;
+    for (int w = 0; w < NUMWIRES; w++) {
+      delete H->h1[w];
+      delete H->h2[w];
+      delete H->gauss[w];
+      delete H->quad[w];
+      delete H->cheby[w];
+      delete H->gaussD[w];
+      delete H->quadD[w];
+    }
+    delete H->h3;
+    delete H->h4;
+    delete H->cheb;
+    delete H->gauss1;
+    delete H->iGauss;
+  }
+  memset(R, 0, sizeof *R);
+}
@@ -0,0 +1,380 @@
+/*
+ * DCT_HITS.cxx
+ *
+ * Hit records on disk (see DCT_Hits.h).
+ *
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "TDirectory.h"
+#include "TFile.h"
+#include "TList.h"
+#include "TParameter.h"
+#include "TROOT.h"
+#include "TTree.h"
+
+#define NUMWIRES 8
+
+#include "DCT_Hits.h"
+#include "DCT_Parallel.h"
+
+/*******************************************************************************
+ * One entry of the tree
+*******************************************************************************/
+typedef struct HitRecord {
+  Long64_t event;
+  Int_t t_eStart[NUMWIRES];
+  Int_t t_eEnd[NUMWIRES];
+  Int_t minval[NUMWIRES];
+  Int_t minloc[NUMWIRES];
+  Int_t integral[NUMWIRES];
+  Int_t dn_dt[NUMWIRES];
+  Bool_t spikeOver[NUMWIRES];
+  Bool_t waveGood[NUMWIRES];
+} HitRecord;
+
+/*******************************************************************************
+ * Branches of the per-wire arrays, and the HIT_* flag that reads them
+*******************************************************************************/
+typedef struct HitBranch {
+  const char* name;
+  int column;    // HIT_*, 0 for always read
+  char type;     // Leaf type, 'I' or 'O'
+  size_t offset;  // Of the array in HitRecord
+} HitBranch;
+
+static const HitBranch hitBranches[] = {
+    {"t_eStart", HIT_START, 'I', offsetof(HitRecord, t_eStart)},
+    {"t_eEnd", HIT_END, 'I', offsetof(HitRecord, t_eEnd)},
+    {"minval", HIT_MINVAL, 'I', offsetof(HitRecord, minval)},
+    {"minloc", HIT_MINLOC, 'I', offsetof(HitRecord, minloc)},
+    {"integral", HIT_INTEGRAL, 'I', offsetof(HitRecord, integral)},
+    {"dn_dt", HIT_DNDT, 'I', offsetof(HitRecord, dn_dt)},
+    {"spikeOver", HIT_SPIKEOVER, 'O', offsetof(HitRecord, spikeOver)},
+    {"waveGood", 0, 'O', offsetof(HitRecord, waveGood)}};
+
+#define NHITBRANCHES (int)(sizeof hitBranches / sizeof hitBranches[0])
+
+/*******************************************************************************
+ * Creates the branches of the tree, reading from / writing to r
+*******************************************************************************/
+static void makeHitBranches(TTree* t, HitRecord* r) {
+  t->Branch("event", &r->event, "event/L");
+  for (int i = 0; i < NHITBRANCHES; i++) {
+    char leaves[64];
+    snprintf(leaves, sizeof leaves, "%s[%d]/%c", hitBranches[i].name, NUMWIRES,
+             hitBranches[i].type);
+    t->Branch(hitBranches[i].name, (char*)r + hitBranches[i].offset, leaves);
+  }
+}
+
+/*******************************************************************************
+ * Cuts of the records, as TParameters in the tree's user info
+*******************************************************************************/
+static void writeCutsInfo(TTree* t, const ROIParams* p) {
+  TList* info = t->GetUserInfo();
+  char name[32];
+  for (int w = 0; w < NUMWIRES; w++) {
+    snprintf(name, sizeof name, "thresh%d", w + 1);
+    info->Add(new TParameter<Int_t>(name, p->thresh[w]));
+  }
+  info->Add(new TParameter<Int_t>("safeMinimum", p->safeMinimum));
+  info->Add(new TParameter<Int_t>("safeMaximum", p->safeMaximum));
+  info->Add(new TParameter<Int_t>("min_eStart", p->min_eStart));
+  info->Add(new TParameter<Int_t>("threshFrac", p->threshFrac));
+}
+
+static bool readCutsInfo(TTree* t, ROIParams* p) {
+  TList* info = t->GetUserInfo();
+  int* fields[NUMWIRES + 4];
+  const char* names[NUMWIRES + 4];
+  char thresh[NUMWIRES][32];
+
+  memset(p, 0, sizeof *p);  // Padding too, cuts are compared with memcmp
+  for (int w = 0; w < NUMWIRES; w++) {
+    snprintf(thresh[w], sizeof thresh[w], "thresh%d", w + 1);
+    names[w] = thresh[w];
+    fields[w] = &p->thresh[w];
+  }
+  names[NUMWIRES] = "safeMinimum";
+  fields[NUMWIRES] = &p->safeMinimum;
+  names[NUMWIRES + 1] = "safeMaximum";
+  fields[NUMWIRES + 1] = &p->safeMaximum;
+  names[NUMWIRES + 2] = "min_eStart";
+  fields[NUMWIRES + 2] = &p->min_eStart;
+  names[NUMWIRES + 3] = "threshFrac";
+  fields[NUMWIRES + 3] = &p->threshFrac;
+
+  for (int i = 0; i < NUMWIRES + 4; i++) {
+    TParameter<Int_t>* par = (TParameter<Int_t>*)info->FindObject(names[i]);
+    if (!par) return false;
+    *fields[i] = par->GetVal();
+  }
+  return true;
+}
+
+/*******************************************************************************
+ * State of the hits pass: one file, tree and record per worker
+*******************************************************************************/
+typedef struct HitsPass {
+  std::string outfile;
+  ROIParams cuts;
+  std::vector<TFile*> files;
+  std::vector<TTree*> trees;
+  std::vector<HitRecord> records;
+} HitsPass;
+
+static std::string partName(const HitsPass* H, int k) {
+  return H->outfile + ".part" + std::to_string(k);
+}
+
+static TFile* createHitsFile(const char* name) {
+  TFile* f = new TFile(name, "RECREATE", "DCT hit records", HITS_COMPRESSION);
+  if (f->IsZombie()) {
+    printf("Can't write %s\n", name);
+    delete f;
+    return NULL;
+  }
+  return f;
+}
+
+static void beginHits(void* data, int nWorkers, long) {
+  HitsPass* H = (HitsPass*)data;
+  TDirectory::TContext context;  // Puts gDirectory back afterwards
+
+  H->files.assign(nWorkers, NULL);
+  H->trees.assign(nWorkers, NULL);
+  H->records.resize(nWorkers);
+  for (int k = 0; k < nWorkers; k++) {
+    std::string name = nWorkers == 1 ? H->outfile : partName(H, k);
+    if (!(H->files[k] = createHitsFile(name.c_str()))) continue;
+    H->trees[k] = new TTree("hits", "DCT hit records per event and wire");
+    H->trees[k]->SetDirectory(H->files[k]);
+    makeHitBranches(H->trees[k], &H->records[k]);
+  }
+}
+
+static void eventHits(void* data, int k, const EventROIs* e) {
+  HitsPass* H = (HitsPass*)data;
+  HitRecord* r = &H->records[k];
+  if (!H->trees[k]) return;
+
+  r->event = e->event;
+  for (int w = 0; w < NUMWIRES; w++) {
+    const ROI* sum = &e->sum[w];
+    r->t_eStart[w] = sum->t_eStart;
+    r->t_eEnd[w] = sum->t_eEnd;
+    r->minval[w] = sum->minval;
+    r->minloc[w] = sum->minloc;
+    r->integral[w] = sum->integral;
+    r->dn_dt[w] = sum->dn_dt;
+    r->spikeOver[w] = sum->spikeOver;
+    r->waveGood[w] = e->waveGood[w];
+  }
+  H->trees[k]->Fill();
+}
+
+static void endHits(void* data, int nWorkers, long) {
+  HitsPass* H = (HitsPass*)data;
+  TDirectory::TContext context;
+  bool ok = true;
+
+  /* One worker: its file is the output */
+  if (nWorkers == 1) {
+    if (H->files[0]) {
+      H->files[0]->cd();
+      writeCutsInfo(H->trees[0], &H->cuts);
+      H->trees[0]->Write();
+      H->files[0]->Close();
+      delete H->files[0];
+      printf("Hit records written to %s\n", H->outfile.c_str());
+    }
+    delete H;
+    return;
+  }
+
+  /* Several: close the parts, then copy their baskets into the output in
+   * worker order (no decompressing), so the events stay in order */
+  for (int k = 0; k < nWorkers; k++) {
+    if (!H->files[k]) {
+      ok = false;
+      continue;
+    }
+    H->files[k]->cd();
+    H->trees[k]->Write();
+    H->files[k]->Close();
+    delete H->files[k];
+  }
+
+  TFile* out = ok ? createHitsFile(H->outfile.c_str()) : NULL;
+  if (out) {
+    HitRecord r;
+    TTree* hits = new TTree("hits", "DCT hit records per event and wire");
+    hits->SetDirectory(out);
+    makeHitBranches(hits, &r);
+    for (int k = 0; k < nWorkers && ok; k++) {
+      TFile* part = TFile::Open(partName(H, k).c_str());
+      TTree* t = NULL;
+      if (part) part->GetObject("hits", t);
+      if (!t || hits->CopyEntries(t, -1, "fast") < 0) ok = false;
+      delete part;
+    }
+    out->cd();
+    writeCutsInfo(hits, &H->cuts);
+    hits->Write();
+    out->Close();
+    delete out;
+  }
+  for (int k = 0; k < nWorkers; k++) remove(partName(H, k).c_str());
+
+  if (ok)
+    printf("Hit records written to %s\n", H->outfile.c_str());
+  else
+    printf("Couldn't write the hit records to %s\n", H->outfile.c_str());
+  delete H;
+}
+
+/*******************************************************************************
+ * Registers the hits pass
+*******************************************************************************/
+void addHitsPass(DCTPipeline* P, const char* outfile, const ROIParams* cuts) {
+  HitsPass* H = new HitsPass;
+  H->outfile = outfile;
+  H->cuts = *cuts;
+
+  DCTPass pass;
+  pass.name = "Hits";
+  pass.cuts = *cuts;
+  pass.maxEvents = -1;  // The whole run
+  pass.data = H;
+  pass.begin = beginHits;
+  pass.event = eventHits;
+  pass.end = endHits;
+  pass.save = NULL;  // The records are already per event
+  pass.load = NULL;
+  addPass(P, &pass);
+}
+
+/*******************************************************************************
+ * Opens hitsfile and points the branches in 'columns' (and event, waveGood)
+ * at r. Returns the tree, NULL if there's none; *f has to be deleted after.
+*******************************************************************************/
+static TTree* openHits(const char* hitsfile, int columns, HitRecord* r,
+                       TFile** f) {
+  TTree* t = NULL;
+  *f = TFile::Open(hitsfile);
+  if (*f && !(*f)->IsZombie()) (*f)->GetObject("hits", t);
+  if (!t) return NULL;
+
+  t->SetBranchStatus("*", false);
+  t->SetBranchStatus("event", true);
+  t->SetBranchAddress("event", &r->event);
+  for (int i = 0; i < NHITBRANCHES; i++) {
+    const HitBranch* b = &hitBranches[i];
+    if (b->column && !(columns & b->column)) continue;
+    t->SetBranchStatus(b->name, true);
+    if (b->type == 'I')
+      t->SetBranchAddress(b->name, (Int_t*)((char*)r + b->offset));
+    else
+      t->SetBranchAddress(b->name, (Bool_t*)((char*)r + b->offset));
+  }
+  return t;
+}
+
+/*******************************************************************************
+ * Main of the replay
+*******************************************************************************/
+long replayHits(DCTPipeline* P, const char* hitsfile, int nThreads,
+                int columns) {
+  /*****************************************************************************
+  * Checks the records were made with the cuts of every pass
+  *****************************************************************************/
+  HitRecord record;
+  TFile* f;
+  TTree* t = openHits(hitsfile, columns, &record, &f);
+  ROIParams cuts;
+  if (!t || !readCutsInfo(t, &cuts)) {
+    printf("Can't read hit records from %s\n", hitsfile);
+    delete f;
+    return -1;
+  }
+  long nEvents = t->GetEntries();
+  delete f;
+
+  for (size_t i = 0; i < P->passes.size(); i++) {
+    if (memcmp(&P->passes[i].cuts, &cuts, sizeof cuts)) {
+      printf("%s was made with other cuts than %s uses\n", hitsfile,
+             P->passes[i].name);
+      return -1;
+    }
+  }
+
+  /*****************************************************************************
+  * Reads the records, each worker its own range of entries from its own
+  * handle of the file
+  *****************************************************************************/
+  long last = 0;
+  for (size_t i = 0; i < P->passes.size(); i++) {
+    if (P->passes[i].maxEvents < 0) {
+      last = nEvents;
+      break;
+    }
+    if (P->passes[i].maxEvents > last) last = P->passes[i].maxEvents;
+  }
+  if (last < nEvents) nEvents = last;
+
+  if (nThreads < 1) nThreads = 1;
+  if (nThreads > 1) ROOT::EnableThreadSafety();
+  for (size_t i = 0; i < P->passes.size(); i++)
+    P->passes[i].begin(P->passes[i].data, nThreads, nEvents);
+
+  std::vector<long> nRead(nThreads, 0);
+  runWorkers(nThreads, [&](int k) {
+    HitRecord r;
+    TFile* file;
+    TTree* tree = openHits(hitsfile, columns, &r, &file);
+    Extrema adc[2 * NUMWIRES];  // Not in the records
+    ROI sum[NUMWIRES];
+    bool waveGood[NUMWIRES];
+    long first, end;
+
+    chunkRange(nEvents, nThreads, k, &first, &end);
+    for (int i = 0; i < 2 * NUMWIRES; i++) INIT_EXTREMA(adc[i]);
+    for (long entry = first; tree && entry < end; entry++) {
+      if (tree->GetEntry(entry) <= 0) break;
+      for (int w = 0; w < NUMWIRES; w++) {
+        INIT_ROI(sum[w]);
+        if (columns & HIT_START) sum[w].t_eStart = r.t_eStart[w];
+        if (columns & HIT_END) sum[w].t_eEnd = r.t_eEnd[w];
+        if (columns & HIT_MINVAL) sum[w].minval = r.minval[w];
+        if (columns & HIT_MINLOC) sum[w].minloc = r.minloc[w];
+        if (columns & HIT_INTEGRAL) sum[w].integral = r.integral[w];
+        if (columns & HIT_DNDT) sum[w].dn_dt = r.dn_dt[w];
+        if (columns & HIT_SPIKEOVER) sum[w].spikeOver = r.spikeOver[w];
+        waveGood[w] = r.waveGood[w];
+      }
+
+      EventROIs e = {(long)r.event, adc, sum, waveGood};
+      for (size_t i = 0; i < P->passes.size(); i++) {
+        DCTPass* pass = &P->passes[i];
+        if (pass->maxEvents >= 0 && e.event >= pass->maxEvents) continue;
+        pass->event(pass->data, k, &e);
+      }
+      nRead[k]++;
+    }
+    delete file;
+  });
+
+  long total = 0;
+  for (int k = 0; k < nThreads; k++) total += nRead[k];
+  printf("Replayed %ld events from %s\n", total, hitsfile);
+  for (size_t i = 0; i < P->passes.size(); i++)
+    P->passes[i].end(P->passes[i].data, nThreads, total);
+  return total;
+}
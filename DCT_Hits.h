@@ -0,0 +1,72 @@
+/*
+ * DCT_HITS.h
+ *
+ * Hit records on disk. The hits pass writes the ROI results of every event
+ * and wire, found with one set of cuts, to the TTree "hits" of a ROOT file:
+ *   event                 event number in the data file
+ *   t_eStart[NUMWIRES]    ROI start
+ *   t_eEnd[NUMWIRES]      ROI end
+ *   minval[NUMWIRES]      wire minimum (the max voltage)
+ *   minloc[NUMWIRES]      bin of the minimum
+ *   integral[NUMWIRES]    integral over the ROI
+ *   dn_dt[NUMWIRES]       dN/dt over the ROI
+ *   spikeOver[NUMWIRES]   the ROI closed
+ *   waveGood[NUMWIRES]    crossed threshold and didn't malfunction
+ * Every branch is stored on its own and compressed, so reading a few of them
+ * back from a long run takes seconds. The cuts are kept in the tree's user
+ * info.
+ *
+ * replayHits() feeds the records back to the passes of a pipeline as if the
+ * raw data had been read again, reading only the branches asked for, so
+ * changing a plot doesn't mean reprocessing the run. The passes must use the
+ * same cuts the records were made with.
+ *
+ * Usage:
+ *   addDataTest7Pass(&P, &H);
+ *   addHitsPass(&P, "hits17.root", &P.passes.back().cuts);  // Shares ROIs
+ *   runPipeline(&P, "NI_PDCT_17.txt", nThreads);
+ * later:
+ *   runDataTest7Hits("hits17.root", nThreads, &H);
+ * or in a ROOT session:
+ *   hits->Draw("t_eEnd[2]-t_eStart[2]", "waveGood[2]")
+ *
+ */
+
+#ifndef DCT_HITS_H
+#define DCT_HITS_H
+
+#include "DCT_Pipeline.h"
+
+#define HITS_COMPRESSION 404  // LZ4 level 4 (ROOT's setting for analysis
+                              // data): fast to read back
+
+/*******************************************************************************
+ * Branches replayHits() reads besides event and waveGood. Fields of the ROI
+ * that aren't read are left as INIT_ROI sets them.
+*******************************************************************************/
+#define HIT_START (1 << 0)      // t_eStart
+#define HIT_END (1 << 1)        // t_eEnd
+#define HIT_MINVAL (1 << 2)     // minval
+#define HIT_MINLOC (1 << 3)     // minloc
+#define HIT_INTEGRAL (1 << 4)   // integral
+#define HIT_DNDT (1 << 5)       // dn_dt
+#define HIT_SPIKEOVER (1 << 6)  // spikeOver
+#define HIT_ALL 0x7f
+
+/*******************************************************************************
+ * Registers a pass that writes the hit records found with 'cuts' to outfile.
+ * With several workers each writes its own part (outfile.part<k>) and the
+ * parts are copied into outfile in order at the end.
+*******************************************************************************/
+void addHitsPass(DCTPipeline* P, const char* outfile, const ROIParams* cuts);
+
+/*******************************************************************************
+ * Runs the passes of P over the hit records of hitsfile instead of raw data,
+ * reading the branches in 'columns' (HIT_*). Returns the number of events,
+ * -1 if hitsfile can't be read or a pass has other cuts than the records.
+ * P->instrument isn't used.
+*******************************************************************************/
+long replayHits(DCTPipeline* P, const char* hitsfile, int nThreads,
+                int columns);
+
+#endif
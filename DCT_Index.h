@@ -0,0 +1,164 @@
+/*
+ * DCT_INDEX.h
+ *
+ * Event offset index for the NI_PDCT text dumps. Text events have variable
+ * byte length, so the index records where every event starts. It is built
+ * once per data file and saved next to it as <datafile>.idx, after which any
+ * event can be loaded without scanning the lines in front of it.
+ *
+ * Index file layout: DCTIHeader followed by numEvents int64 byte offsets.
+ *
+ */
+
+#ifndef DCT_INDEX_H
+#define DCT_INDEX_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "DCT_Reader.h"
+
+#define DCTI_MAGIC "DCTI"
+#define DCTI_VERSION 2  // 2: an unterminated last line isn't counted
+
+/*******************************************************************************
+ * Index file header. Size, mtime and checksum identify the data file.
+*******************************************************************************/
+typedef struct DCTIHeader {
+  char magic[4];       // DCTI_MAGIC, no terminator
+  int32_t version;     // DCTI_VERSION
+  int32_t numTsteps;   // Lines per event the offsets were built with
+  int32_t reserved;
+  int64_t numEvents;   // Number of complete events in the data file
+  int64_t fileSize;    // Size of the data file in bytes
+  int64_t fileMtime;   // Modification time of the data file
+  uint64_t checksum;   // checksumBytes() of the whole data file
+} DCTIHeader;
+
+/*******************************************************************************
+ * In-memory index. offsets[i] is the byte offset of event i.
+*******************************************************************************/
+typedef struct DCTIndex {
+  DCTIHeader header;
+  std::vector<int64_t> offsets;
+} DCTIndex;
+
+/*******************************************************************************
+ * 64 bit checksum of a block of bytes (FNV-1a over 8 byte words)
+*******************************************************************************/
+inline uint64_t checksumBytes(const char* p, size_t n) {
+  uint64_t h = 14695981039346656037ULL;
+  size_t i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    uint64_t word;
+    memcpy(&word, p + i, 8);
+    h = (h ^ word) * 1099511628211ULL;
+  }
+  for (; i < n; i++) h = (h ^ (unsigned char)p[i]) * 1099511628211ULL;
+  return h;
+}
+
+/*******************************************************************************
+ * Modification time of the reader's file, 0 if unknown
+*******************************************************************************/
+inline int64_t readerMtime(const DCTReader* r) {
+  struct stat st;
+  return fstat(r->fd, &st) == 0 ? (int64_t)st.st_mtime : 0;
+}
+
+/*******************************************************************************
+ * Builds the index of a mapped data file by finding every NUMTSTEPS-th line
+ * break. Only complete events are indexed: an unterminated last line doesn't
+ * count, as in countEvents() and readEvent().
+*******************************************************************************/
+inline void buildIndex(const DCTReader* r, DCTIndex* idx) {
+  const char* p = r->data;
+  long line = 0;
+
+  idx->offsets.clear();
+  while (p && p < r->end) {
+    const char* nl = (const char*)memchr(p, '\n', r->end - p);
+    if (!nl) break;
+    if (line % NUMTSTEPS == 0) idx->offsets.push_back(p - r->data);
+    line++;
+    p = nl + 1;
+  }
+  if (line % NUMTSTEPS) idx->offsets.pop_back();  // Drop a partial last event
+
+  memset(&idx->header, 0, sizeof idx->header);
+  memcpy(idx->header.magic, DCTI_MAGIC, 4);
+  idx->header.version = DCTI_VERSION;
+  idx->header.numTsteps = NUMTSTEPS;
+  idx->header.numEvents = idx->offsets.size();
+  idx->header.fileSize = r->size;
+  idx->header.fileMtime = readerMtime(r);
+  idx->header.checksum = checksumBytes(r->data, r->size);
+}
+
+/*******************************************************************************
+ * Saves the index. Returns false if the file can't be written.
+*******************************************************************************/
+inline bool writeIndex(const DCTIndex* idx, const char* path) {
+  FILE* out = fopen(path, "wb");
+  if (!out) return false;
+
+  bool ok = fwrite(&idx->header, sizeof idx->header, 1, out) == 1;
+  if (ok && !idx->offsets.empty())
+    ok = fwrite(&idx->offsets[0], sizeof(int64_t), idx->offsets.size(), out) ==
+         idx->offsets.size();
+  return fclose(out) == 0 && ok;
+}
+
+/*******************************************************************************
+ * Loads a saved index and checks it belongs to the reader's file. A changed
+ * size means a different file; a changed mtime alone (e.g. after a copy) is
+ * settled by recomputing the checksum.
+*******************************************************************************/
+inline bool loadIndex(DCTIndex* idx, const char* path, const DCTReader* r) {
+  FILE* in = fopen(path, "rb");
+  if (!in) return false;
+
+  DCTIHeader* h = &idx->header;
+  bool ok = fread(h, sizeof *h, 1, in) == 1 &&
+            memcmp(h->magic, DCTI_MAGIC, 4) == 0 &&
+            h->version == DCTI_VERSION && h->numTsteps == NUMTSTEPS &&
+            h->fileSize == (int64_t)r->size && h->numEvents >= 0;
+  if (ok && h->fileMtime != readerMtime(r))
+    ok = h->checksum == checksumBytes(r->data, r->size);
+  if (ok) {
+    idx->offsets.resize(h->numEvents);
+    if (h->numEvents > 0)
+      ok = fread(&idx->offsets[0], sizeof(int64_t), h->numEvents, in) ==
+           (size_t)h->numEvents;
+  }
+  fclose(in);
+  return ok;
+}
+
+/*******************************************************************************
+ * Loads <datafile>.idx, or builds it and tries to save it for next time
+*******************************************************************************/
+inline void openIndex(DCTIndex* idx, const DCTReader* r, const char* datafile) {
+  std::string path = std::string(datafile) + ".idx";
+
+  if (loadIndex(idx, path.c_str(), r)) return;
+  buildIndex(r, idx);
+  writeIndex(idx, path.c_str());  // Read-only directories just rebuild it
+}
+
+/*******************************************************************************
+ * Moves the reader to the start of event i. Returns false if there's no such
+ * event.
+*******************************************************************************/
+inline bool seekEvent(DCTReader* r, const DCTIndex* idx, long i) {
+  if (i < 0 || i >= idx->header.numEvents) return false;
+  r->cur = r->data + idx->offsets[i];
+  return true;
+}
+
+#endif
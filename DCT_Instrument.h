@@ -0,0 +1,298 @@
+/*
+ * DCT_INSTRUMENT.h
+ *
+ * Counters and timers of a pipeline run (see runPipeline()/followPipeline()):
+ *   - events analyzed and bytes of input read
+ *   - time spent reading/decoding, finding ROIs, in each pass's event()
+ *     and end()
+ *   - for every set of cuts and wire, how many waves were good and why the
+ *     others were thrown out
+ * They are dumped as JSON at the end of the run and, if asked for, every
+ * 'interval' seconds while it goes on, so a slow run or one with few hits can
+ * be looked into without running it again under a profiler.
+ *
+ * Every worker thread adds to its own counters only. They are relaxed
+ * atomics, so adding costs the same as a plain add and a snapshot can be
+ * taken from another thread at any time.
+ *
+ * Usage:
+ *   DCTInstrument I;
+ *   initInstrument(&I, "run.json", 10);  // Snapshot every 10 s, 0 for none
+ *   P.instrument = &I;
+ *   runPipeline(&P, "NI_PDCT_17.txt", nThreads);
+ *
+ */
+
+#ifndef DCT_INSTRUMENT_H
+#define DCT_INSTRUMENT_H
+
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "DCT_ROI.h"
+
+/*******************************************************************************
+ * What happened to a wave. Only WIRE_GOOD and WIRE_OPEN have waveGood set;
+ * WIRE_OPEN waves have no integral or dN/dt (the ROI never closed).
+*******************************************************************************/
+#define WIRE_GOOD 0       // Crossed threshold and got back above
+                          // thresh/threshFrac (spikeOver)
+#define WIRE_OPEN 1       // Crossed threshold, spikeOver never set
+#define WIRE_BELOWSAFE 2  // Malfunction: a sample below safeMinimum
+#define WIRE_ABOVESAFE 3  // Malfunction: a sample above safeMaximum
+#define WIRE_NOCROSS 4    // Never crossed threshold
+#define NWIREREASONS 5
+
+static const char* const wireReasonNames[NWIREREASONS] = {
+    "good", "no_spike_over", "below_safe_min", "above_safe_max",
+    "no_crossing"};
+
+/*******************************************************************************
+ * Timed stages besides the passes
+*******************************************************************************/
+#define INST_READ 0   // Reading and decoding events
+#define INST_ROI 1    // Finding the ROIs, all sets of cuts
+#define NINSTSTAGES 2
+
+static const char* const instStageNames[NINSTSTAGES] = {"read", "roi"};
+
+/*******************************************************************************
+ * Counters of one worker, nCounters in a row, in whole cache lines:
+ *   bytes, read ns                  (the read-ahead thread's line)
+ *   events, ROI ns, pass event() ns [nPasses],
+ *   wire reasons [nCutSets][NUMWIRES][NWIREREASONS]
+ * Every row, and the worker's part of it, starts a cache line, so a worker,
+ * its read-ahead thread (see DCT_Ring.h) and the other workers never write
+ * to the same line.
+*******************************************************************************/
+typedef std::atomic<long long> Counter;
+
+#define INST_LINE (int)(64 / sizeof(Counter))  // Counters per cache line
+
+typedef struct alignas(64) CounterLine {
+  Counter c[INST_LINE];
+} CounterLine;
+
+#define INST_BYTES 0
+#define INST_READNS 1              // Time of stage INST_READ
+#define INST_EVENTS INST_LINE
+#define INST_ROINS (INST_LINE + 1)  // Time of stage INST_ROI
+
+typedef struct DCTInstrument {
+  const char* path;   // JSON written here at the end, NULL for none
+  double interval;    // Seconds between snapshots to 'path' during the run,
+                      // 0 for none
+
+  // Set up by the pipeline when the run starts
+  const char* infile;
+  int nWorkers;
+  int nCounters;                        // Counters per worker
+  std::vector<ROIParams> cutSets;
+  std::vector<const char*> passNames;
+  std::vector<int> passSet;             // Set of cuts of each pass
+  std::unique_ptr<CounterLine[]> lines;  // Storage of 'counters'
+  Counter* counters;                     // nWorkers * nCounters
+  std::vector<double> endSeconds;       // Time in each pass's end()
+  std::chrono::steady_clock::time_point start;
+  double seconds;                       // Length of the run, once over
+  bool done;
+} DCTInstrument;
+
+inline void initInstrument(DCTInstrument* I, const char* path,
+                           double interval) {
+  I->path = path;
+  I->interval = interval;
+  I->infile = NULL;
+  I->nWorkers = 0;
+  I->nCounters = 0;
+  I->counters = NULL;
+  I->seconds = 0;
+  I->done = false;
+}
+
+/*******************************************************************************
+ * Where the counters are in a worker's row
+*******************************************************************************/
+inline int instStage(int stage) {
+  return stage == INST_READ ? INST_READNS : INST_ROINS;
+}
+
+inline int instPass(const DCTInstrument*, int pass) {
+  return INST_ROINS + 1 + pass;
+}
+
+inline int instWire(const DCTInstrument* I, int cutSet, int w, int reason) {
+  return INST_ROINS + 1 + (int)I->passNames.size() +
+         (cutSet * NUMWIRES + w) * NWIREREASONS + reason;
+}
+
+inline Counter* workerCounters(DCTInstrument* I, int k) {
+  return &I->counters[(size_t)k * I->nCounters];
+}
+
+/*******************************************************************************
+ * Adds n to a counter of the calling worker. No read-modify-write: the
+ * worker is the only one writing it.
+*******************************************************************************/
+inline void countAdd(Counter* c, long long n) {
+  c->store(c->load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+/*******************************************************************************
+ * Sum of one counter over the workers
+*******************************************************************************/
+inline long long instTotal(const DCTInstrument* I, int i) {
+  long long sum = 0;
+  for (int k = 0; k < I->nWorkers; k++)
+    sum += I->counters[(size_t)k * I->nCounters + i].load(
+        std::memory_order_relaxed);
+  return sum;
+}
+
+/*******************************************************************************
+ * Sets up the counters for a run. Called by the pipeline.
+*******************************************************************************/
+inline void startInstrument(DCTInstrument* I, const char* infile,
+                            int nWorkers,
+                            const std::vector<ROIParams>& cutSets,
+                            const std::vector<const char*>& passNames,
+                            const std::vector<int>& passSet) {
+  I->infile = infile;
+  I->nWorkers = nWorkers;
+  I->cutSets = cutSets;
+  I->passNames = passNames;
+  I->passSet = passSet;
+  int nLines = (instWire(I, cutSets.size(), 0, 0) + INST_LINE - 1) / INST_LINE;
+  I->nCounters = nLines * INST_LINE;
+  I->lines.reset(new CounterLine[(size_t)nWorkers * nLines]);
+  I->counters = I->lines[0].c;
+  for (size_t i = 0; i < (size_t)nWorkers * I->nCounters; i++)
+    I->counters[i].store(0, std::memory_order_relaxed);
+  I->endSeconds.assign(passNames.size(), 0);
+  I->start = std::chrono::steady_clock::now();
+  I->seconds = 0;
+  I->done = false;
+}
+
+/*******************************************************************************
+ * What happened to wave w, given its ROI. Lbad/Rbad are its left and right
+ * samples at sum->badloc (unused if the wave didn't malfunction).
+*******************************************************************************/
+inline int wireReason(const ROI* sum, bool waveGood, int Lbad, int Rbad,
+                      const ROIParams* p) {
+  if (sum->badloc >= 0)
+    return Lbad < p->safeMinimum || Rbad < p->safeMinimum ? WIRE_BELOWSAFE
+                                                          : WIRE_ABOVESAFE;
+  if (!waveGood) return WIRE_NOCROSS;
+  return sum->spikeOver ? WIRE_GOOD : WIRE_OPEN;
+}
+
+/*******************************************************************************
+ * Seconds since the run started, or its length once it's over
+*******************************************************************************/
+inline double instSeconds(const DCTInstrument* I) {
+  if (I->done) return I->seconds;
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       I->start)
+      .count();
+}
+
+/*******************************************************************************
+ * Writes s as a JSON string, quotes included: '"', '\\' and control
+ * characters are escaped
+*******************************************************************************/
+inline void writeJSONString(FILE* f, const char* s) {
+  fputc('"', f);
+  for (const unsigned char* c = (const unsigned char*)s; *c; c++) {
+    if (*c == '"' || *c == '\\')
+      fprintf(f, "\\%c", *c);
+    else if (*c < 0x20)
+      fprintf(f, "\\u%04x", *c);
+    else
+      fputc(*c, f);
+  }
+  fputc('"', f);
+}
+
+/*******************************************************************************
+ * Writes the counters as JSON to path (through a temporary file, so path is
+ * always complete). Stage times are added up over the workers, so with more
+ * than one worker they are CPU seconds and can exceed the run's length.
+*******************************************************************************/
+inline bool writeInstrument(const DCTInstrument* I, const char* path) {
+  char tmpfile[4096];
+  snprintf(tmpfile, sizeof tmpfile, "%s.tmp", path);
+  FILE* f = fopen(tmpfile, "w");
+  if (!f) {
+    fprintf(stderr, "Can't write %s\n", tmpfile);
+    return false;
+  }
+
+  double seconds = instSeconds(I);
+  long long events = instTotal(I, INST_EVENTS);
+  long long bytes = instTotal(I, INST_BYTES);
+  fprintf(f, "{\n");
+  fprintf(f, "  \"file\": ");
+  writeJSONString(f, I->infile ? I->infile : "");
+  fprintf(f, ",\n");
+  fprintf(f, "  \"done\": %s,\n", I->done ? "true" : "false");
+  fprintf(f, "  \"workers\": %d,\n", I->nWorkers);
+  fprintf(f, "  \"seconds\": %.3f,\n", seconds);
+  fprintf(f, "  \"events\": %lld,\n", events);
+  fprintf(f, "  \"bytes_read\": %lld,\n", bytes);
+  if (seconds <= 0) seconds = 1e-9;
+  fprintf(f, "  \"events_per_s\": %.1f,\n", events / seconds);
+  fprintf(f, "  \"mb_per_s\": %.2f,\n", bytes / seconds / 1e6);
+
+  fprintf(f, "  \"stage_seconds\": {");
+  for (int i = 0; i < NINSTSTAGES; i++)
+    fprintf(f, "%s\"%s\": %.6f", i ? ", " : "", instStageNames[i],
+            instTotal(I, instStage(i)) / 1e9);
+  fprintf(f, "},\n");
+
+  fprintf(f, "  \"passes\": [\n");
+  for (size_t i = 0; i < I->passNames.size(); i++) {
+    fprintf(f, "    {\"name\": ");
+    writeJSONString(f, I->passNames[i]);
+    fprintf(f,
+            ", \"cut_set\": %d, \"event_seconds\": %.6f, "
+            "\"end_seconds\": %.6f}%s\n",
+            I->passSet[i], instTotal(I, instPass(I, i)) / 1e9,
+            I->endSeconds[i], i + 1 < I->passNames.size() ? "," : "");
+  }
+  fprintf(f, "  ],\n");
+
+  fprintf(f, "  \"cut_sets\": [\n");
+  for (size_t s = 0; s < I->cutSets.size(); s++) {
+    const ROIParams* p = &I->cutSets[s];
+    fprintf(f, "    {\"thresh\": [");
+    for (int w = 0; w < NUMWIRES; w++)
+      fprintf(f, "%s%d", w ? ", " : "", p->thresh[w]);
+    fprintf(f,
+            "], \"safe_min\": %d, \"safe_max\": %d, \"min_eStart\": %d, "
+            "\"threshFrac\": %d,\n     \"wires\": [\n",
+            p->safeMinimum, p->safeMaximum, p->min_eStart, p->threshFrac);
+    for (int w = 0; w < NUMWIRES; w++) {
+      fprintf(f, "       {\"wire\": %d", w + 1);
+      for (int r = 0; r < NWIREREASONS; r++)
+        fprintf(f, ", \"%s\": %lld", wireReasonNames[r],
+                instTotal(I, instWire(I, s, w, r)));
+      fprintf(f, "}%s\n", w + 1 < NUMWIRES ? "," : "");
+    }
+    fprintf(f, "     ]}%s\n", s + 1 < I->cutSets.size() ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+
+  bool ok = fclose(f) == 0;
+  if (!ok || rename(tmpfile, path) != 0) {
+    fprintf(stderr, "Can't write %s\n", path);
+    return false;
+  }
+  return true;
+}
+
+#endif
@@ -0,0 +1,85 @@
+/*
+ * DCT_MONITOR7.c
+ *
+ * Online monitoring during a run. Follows the NI_PDCT text dump while the DAQ
+ * is writing it and fills the DataTest7 histograms (see DCT_DataTest7.c) with
+ * every complete event as soon as it's in. The start time and drift time
+ * canvases are redrawn every 'refresh' seconds.
+ *
+ * root 'DCT_Monitor7.c("NI_PDCT_18.txt")'             runs until interrupted
+ * root -b -q 'DCT_Monitor7.c("NI_PDCT_18.txt", 2, 30)'  headless, stops after
+ *                                                      30 s without new data
+ *
+ * In batch mode the canvases are saved to DCT_Monitor7_start.png and
+ * DCT_Monitor7_drift.png at every refresh instead of being shown.
+ *
+ */
+
+#include "DCT_Analysis.h"
+
+R__LOAD_LIBRARY(libdct)
+
+/*******************************************************************************
+ * Canvases to refresh
+*******************************************************************************/
+typedef struct Monitor7 {
+  TCanvas* c1;  // Start times
+  TCanvas* c2;  // Drift times
+} Monitor7;
+
+static void refreshCanvas(TCanvas* c) {
+  for (int w = 0; w < NUMWIRES; w++) c->cd(w + 1)->Modified();
+  c->Update();
+}
+
+static void refresh7(void* data, long nEvents) {
+  Monitor7* M = (Monitor7*)data;
+
+  refreshCanvas(M->c1);
+  refreshCanvas(M->c2);
+  if (gROOT->IsBatch()) {
+    M->c1->SaveAs("DCT_Monitor7_start.png");
+    M->c2->SaveAs("DCT_Monitor7_drift.png");
+  }
+  printf("%ld events\n", nEvents);
+  gSystem->ProcessEvents();  // Keeps the windows responsive
+}
+
+/*******************************************************************************
+ * Main
+*******************************************************************************/
+void DCT_Monitor7(const char* infile = "NI_PDCT_17.txt", double refresh = 2,
+                  double idleTimeout = -1){
+  DCTPipeline P;
+  DataTest7Hists H;
+  addDataTest7Pass(&P, &H);
+
+  /*****************************************************************************
+  * Sets up canvases
+  *****************************************************************************/
+  Monitor7 M;
+  M.c1 = new TCanvas("c1", "t_d Start Time Per Wire", 20, 20, 800, 800);
+  M.c2 = new TCanvas("c2", "Drift Time Per Wire", 20, 20, 800, 800);
+  M.c1->Divide(2, 4, .01, 0.01);
+  M.c2->Divide(2, 4, .01, 0.01);
+  gStyle->SetOptStat(0);
+
+  for (int w = 0; w < NUMWIRES; w++) {
+    M.c1->cd(w + 1);
+    H.h1[w]->Draw();
+    M.c2->cd(w + 1);
+    H.h2[w]->Draw();
+  }
+
+  /*****************************************************************************
+  * Follows the file
+  *****************************************************************************/
+  DCTFollow F;
+  F.refresh = refresh;
+  F.poll = 0.05;
+  F.idleTimeout = idleTimeout;
+  F.stop = NULL;
+  F.data = &M;
+  F.update = refresh7;
+  followPipeline(&P, infile, &F);
+}
@@ -0,0 +1,152 @@
+/*
+ * DCT_PARALLEL.h
+ *
+ * Helpers for splitting the event loop across worker threads. Each worker
+ * gets one contiguous range of events, so per-event arrays are written in
+ * disjoint slices and per-worker results can be merged in worker order.
+ * Work of uneven size (several runs, see DCT_Batch.h) goes to a
+ * work-stealing pool instead.
+ *
+ */
+
+#ifndef DCT_PARALLEL_H
+#define DCT_PARALLEL_H
+
+#include <unistd.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "DCT_Index.h"
+#include "DCT_Reader.h"
+
+/*******************************************************************************
+ * Range [first, last) of worker k when nEvents are split nWorkers ways
+*******************************************************************************/
+inline void chunkRange(long nEvents, int nWorkers, int k, long* first,
+                       long* last) {
+  *first = nEvents * k / nWorkers;
+  *last = nEvents * (k + 1) / nWorkers;
+}
+
+/*******************************************************************************
+ * Gives every worker a reader positioned at the start of its chunk of the
+ * nEvents events from event 'from' on; r is at the start of the file. The
+ * readers share r's mapping, so only r itself gets closed. With an index the
+ * workers seek straight to their chunk, otherwise the lines are counted.
+*******************************************************************************/
+inline void chunkReaders(const DCTReader* r, const DCTIndex* idx, long from,
+                         long nEvents, int nWorkers, DCTReader* views) {
+  long prev = 0;
+  DCTReader cur = *r;
+
+  for (int k = 0; k < nWorkers; k++) {
+    long first, last;
+    chunkRange(nEvents, nWorkers, k, &first, &last);
+    first += from;
+    if (!idx || !seekEvent(&cur, idx, first)) skipEvents(&cur, first - prev);
+    views[k] = cur;
+    prev = first;
+  }
+}
+
+/*******************************************************************************
+ * Runs work(k) for k = 0..nWorkers-1. Worker 0 runs on the calling thread,
+ * so nWorkers = 1 is exactly the serial loop.
+*******************************************************************************/
+inline void runWorkers(int nWorkers, std::function<void(int)> work) {
+  std::vector<std::thread> threads;
+
+  for (int k = 1; k < nWorkers; k++) threads.emplace_back(work, k);
+  work(0);
+  for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+}
+
+/*******************************************************************************
+ * Work-stealing pool. Every thread has a queue of its own: it takes its
+ * newest task first (the chunks a task just queued, while their run is
+ * fresh) and, once its queue is empty, steals the oldest task of another
+ * thread. No thread idles while any queue has work, whatever the mix of big
+ * and small tasks. A task gets the number of the thread running it and may
+ * queue more tasks there.
+*******************************************************************************/
+typedef std::function<void(int)> DCTTask;
+
+typedef struct DCTTaskQueue {
+  std::mutex lock;
+  std::deque<DCTTask> tasks;
+} DCTTaskQueue;
+
+typedef struct DCTPool {
+  std::vector<DCTTaskQueue> queues;  // One per thread
+  std::atomic<long> pending;         // Tasks queued or running
+} DCTPool;
+
+inline void initPool(DCTPool* pool, int nThreads) {
+  pool->queues = std::vector<DCTTaskQueue>(nThreads < 1 ? 1 : nThreads);
+  pool->pending = 0;
+}
+
+/*******************************************************************************
+ * Queues a task for thread k
+*******************************************************************************/
+inline void poolPush(DCTPool* pool, int k, DCTTask task) {
+  DCTTaskQueue* Q = &pool->queues[k];
+  pool->pending++;
+  std::lock_guard<std::mutex> l(Q->lock);
+  Q->tasks.push_back(std::move(task));
+}
+
+/*******************************************************************************
+ * Thread k's next task: the newest of its own, else the oldest of the next
+ * thread that has one. Returns false if every queue is empty.
+*******************************************************************************/
+inline bool poolTake(DCTPool* pool, int k, DCTTask* task) {
+  int n = pool->queues.size();
+
+  for (int i = 0; i < n; i++) {
+    DCTTaskQueue* Q = &pool->queues[(k + i) % n];
+    std::lock_guard<std::mutex> l(Q->lock);
+    if (Q->tasks.empty()) continue;
+    if (i == 0) {
+      *task = std::move(Q->tasks.back());
+      Q->tasks.pop_back();
+    } else {
+      *task = std::move(Q->tasks.front());
+      Q->tasks.pop_front();
+    }
+    return true;
+  }
+  return false;
+}
+
+/*******************************************************************************
+ * Runs the queued tasks, and the tasks they queue, until there are none left.
+ * Thread 0 is the calling thread. A thread that finds nothing to do waits
+ * for running tasks to queue more or to finish.
+*******************************************************************************/
+inline void runPool(DCTPool* pool) {
+  runWorkers(pool->queues.size(), [pool](int k) {
+    DCTTask task;
+    int idle = 0;
+    while (pool->pending > 0) {
+      if (!poolTake(pool, k, &task)) {
+        if (++idle < 64)
+          std::this_thread::yield();
+        else
+          usleep(100);
+        continue;
+      }
+      idle = 0;
+      task(k);
+      task = nullptr;
+      pool->pending--;
+    }
+  });
+}
+
+#endif
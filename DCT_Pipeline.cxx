@@ -0,0 +1,758 @@
+/*
+ * DCT_PIPELINE.cxx
+ *
+ * Single-read analysis pipeline (see DCT_Pipeline.h).
+ *
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TROOT.h"
+
+#define NUMWIRES 8
+#define NUMTSTEPS 1000
+#define NUMADCS 32
+#define ROISIZE 25
+
+#include "DCT_Binary.h"
+#include "DCT_Channels.h"
+#include "DCT_Cuts.h"
+#include "DCT_Instrument.h"
+#include "DCT_Parallel.h"
+#include "DCT_Pipeline.h"
+#include "DCT_Reader.h"
+#include "DCT_Ring.h"
+#include "DCT_ROI.h"
+#include "DCT_SIMD.h"
+#include "DCT_Shard.h"
+#include "DCT_Stream.h"
+#include "DCT_Tail.h"
+#include "DCT_ZS.h"
+
+/*******************************************************************************
+ * Seconds since t0
+*******************************************************************************/
+static double secondsSince(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0)
+      .count();
+}
+
+/*******************************************************************************
+ * Adds the nanoseconds since *t0 to counter C[i] and restarts *t0
+*******************************************************************************/
+static void countStage(Counter* C, int i,
+                       std::chrono::steady_clock::time_point* t0) {
+  std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+  countAdd(&C[i],
+           std::chrono::duration_cast<std::chrono::nanoseconds>(t - *t0)
+               .count());
+  *t0 = t;
+}
+
+/*******************************************************************************
+ * Per-worker copies of histograms
+*******************************************************************************/
+void workerHists(TH1F* const* hists, int n, int nWorkers,
+                 std::vector<TH1F*>* H) {
+  H->resize(nWorkers * n);
+  for (int k = 0; k < nWorkers; k++) {
+    for (int i = 0; i < n; i++) {
+      (*H)[k * n + i] = k ? (TH1F*)hists[i]->Clone() : hists[i];
+      (*H)[k * n + i]->SetDirectory(0);
+    }
+  }
+}
+
+void mergeWorkerHists(std::vector<TH1F*>* H, int n, int nWorkers) {
+  for (int k = 1; k < nWorkers; k++) {
+    for (int i = 0; i < n; i++) {
+      (*H)[i]->Add((*H)[k * n + i]);
+      delete (*H)[k * n + i];
+    }
+  }
+  H->resize(n);
+}
+
+/*******************************************************************************
+ * ROI results of one event for one set of cuts
+*******************************************************************************/
+typedef struct CutSetROIs {
+  Extrema adc[2 * NUMWIRES];  // Stores relevant data of each ADC
+  ROI sum[NUMWIRES];          // Stores relevant data of each wire
+  bool waveGood[NUMWIRES];    // Keeps track of events above threshold, but
+                              // aren't flukes
+} CutSetROIs;
+
+/*******************************************************************************
+ * Finds the ROIs of a decoded text event once per set of cuts
+*******************************************************************************/
+static void textEventROIs(EventKernel kernel,
+                          const Int_t (*tm)[NUMCHANNELS],
+                          const std::vector<ROIParams>& cutSets,
+                          EventStats* stats, std::vector<CutSetROIs>* rois) {
+  for (size_t s = 0; s < cutSets.size(); s++) {
+    CutSetROIs* R = &(*rois)[s];
+    findEventROIs(kernel, tm, &cutSets[s], stats, R->adc, R->sum, R->waveGood);
+  }
+}
+
+/*******************************************************************************
+ * Counts what happened to every wave of one event, for every set of cuts.
+ * Sample t of channel c is samples[column[c] * adcStride + t * tStride], or
+ * samples[c * adcStride + t * tStride] if column is NULL.
+*******************************************************************************/
+template <typename T>
+static void countWires(const DCTInstrument* I, Counter* C, const T* samples,
+                       const int* column, int adcStride, int tStride,
+                       const std::vector<ROIParams>& cutSets,
+                       const std::vector<CutSetROIs>& rois) {
+  for (size_t s = 0; s < cutSets.size(); s++) {
+    for (int w = 0; w < NUMWIRES; w++) {
+      const ROI* sum = &rois[s].sum[w];
+      int Ladc = column ? column[2 * w] : 2 * w;
+      int Radc = column ? column[2 * w + 1] : 2 * w + 1;
+      int Lbad = 0, Rbad = 0;
+      if (sum->badloc >= 0) {
+        Lbad = samples[Ladc * adcStride + sum->badloc * tStride];
+        Rbad = samples[Radc * adcStride + sum->badloc * tStride];
+      }
+      int reason =
+          wireReason(sum, rois[s].waveGood[w], Lbad, Rbad, &cutSets[s]);
+      countAdd(&C[instWire(I, s, w, reason)], 1);
+    }
+  }
+}
+
+/*******************************************************************************
+ * Same for an event of a .dctz file, from its per-wire summary
+*******************************************************************************/
+static void countSuppressedWires(const DCTInstrument* I, Counter* C,
+                                 const DCTZWire* z,
+                                 const std::vector<ROIParams>& cutSets,
+                                 const std::vector<CutSetROIs>& rois) {
+  for (size_t s = 0; s < cutSets.size(); s++) {
+    for (int w = 0; w < NUMWIRES; w++) {
+      int reason;
+      if (z[w].flags & ZW_BELOWSAFE)
+        reason = WIRE_BELOWSAFE;
+      else if (z[w].flags & ZW_ABOVESAFE)
+        reason = WIRE_ABOVESAFE;
+      else
+        reason = wireReason(&rois[s].sum[w], rois[s].waveGood[w], 0, 0,
+                            &cutSets[s]);
+      countAdd(&C[instWire(I, s, w, reason)], 1);
+    }
+  }
+}
+
+/*******************************************************************************
+ * Hands the ROIs of one event to every pass that still wants events. With
+ * counters C, the time of each pass is added to them.
+*******************************************************************************/
+static void passEvent(DCTPipeline* P, int k, long event,
+                      const std::vector<int>& passSet,
+                      const std::vector<CutSetROIs>& rois, Counter* C) {
+  std::chrono::steady_clock::time_point t0;
+  if (C) t0 = std::chrono::steady_clock::now();
+
+  for (size_t i = 0; i < P->passes.size(); i++) {
+    DCTPass* pass = &P->passes[i];
+    if (pass->maxEvents >= 0 && event >= pass->maxEvents) continue;
+    const CutSetROIs* R = &rois[passSet[i]];
+    EventROIs e = {event, R->adc, R->sum, R->waveGood};
+    pass->event(pass->data, k, &e);
+    if (C) countStage(C, instPass(P->instrument, i), &t0);
+  }
+}
+
+/*******************************************************************************
+ * Groups the passes by cuts (passes with the same cuts share their ROIs) and
+ * returns the last event any pass wants, -1 for all
+*******************************************************************************/
+static long setupPasses(DCTPipeline* P, std::vector<ROIParams>* cutSets,
+                        std::vector<int>* passSet) {
+  passSet->resize(P->passes.size());
+  for (size_t i = 0; i < P->passes.size(); i++) {
+    size_t s = 0;
+    while (s < cutSets->size() &&
+           memcmp(&(*cutSets)[s], &P->passes[i].cuts, sizeof(ROIParams)))
+      s++;
+    if (s == cutSets->size()) cutSets->push_back(P->passes[i].cuts);
+    (*passSet)[i] = s;
+  }
+
+  long maxEvents = P->passes.empty() ? 0 : -1;  // -1: until EOF
+  for (size_t i = 0; i < P->passes.size(); i++) {
+    if (P->passes[i].maxEvents < 0) return -1;
+    if (P->passes[i].maxEvents > maxEvents)
+      maxEvents = P->passes[i].maxEvents;
+  }
+  return maxEvents;
+}
+
+/*******************************************************************************
+ * Sets up the pipeline's counters, if it has any, and starts the thread that
+ * writes them out every instrument->interval seconds if asked to
+*******************************************************************************/
+typedef struct Reporter {
+  std::thread thread;
+  std::atomic<bool> stop;
+} Reporter;
+
+static void startReporter(DCTPipeline* P, Reporter* R, const char* infile,
+                          int nWorkers, const std::vector<ROIParams>& cutSets,
+                          const std::vector<int>& passSet) {
+  DCTInstrument* I = P->instrument;
+  R->stop = false;
+  if (!I) return;
+
+  std::vector<const char*> names;
+  for (size_t i = 0; i < P->passes.size(); i++)
+    names.push_back(P->passes[i].name);
+  startInstrument(I, infile, nWorkers, cutSets, names, passSet);
+
+  if (!I->path || I->interval <= 0) return;
+  R->thread = std::thread([I, R]() {
+    std::chrono::steady_clock::time_point last =
+        std::chrono::steady_clock::now();
+    while (!R->stop) {
+      usleep(50000);
+      if (secondsSince(last) < I->interval) continue;
+      writeInstrument(I, I->path);
+      last = std::chrono::steady_clock::now();
+    }
+  });
+}
+
+/*******************************************************************************
+ * Stops the reporter thread, ends the passes (timing them) and writes the
+ * final counters. A shard saves the passes to P->partial instead; returns
+ * false if that failed.
+*******************************************************************************/
+static bool endPasses(DCTPipeline* P, Reporter* R, int nWorkers,
+                      long nEvents) {
+  DCTInstrument* I = P->instrument;
+  bool ok = true;
+
+  R->stop = true;
+  if (R->thread.joinable()) R->thread.join();
+
+  for (size_t i = 0; i < P->passes.size(); i++) {
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    DCTPass* pass = &P->passes[i];
+    if (P->partial)
+      ok = pass->save(pass->data, nWorkers, nEvents,
+                      P->partial->mkdir(pass->name)) && ok;
+    else
+      pass->end(pass->data, nWorkers, nEvents);
+    if (I) I->endSeconds[i] = secondsSince(t0);
+  }
+
+  if (!I) return ok;
+  I->seconds = instSeconds(I);
+  I->done = true;
+  if (I->path) writeInstrument(I, I->path);
+  return ok;
+}
+
+/*******************************************************************************
+ * The input of a run: a text dump, a .dctb or a .dctz file, or a compressed
+ * text dump. Only the reader of 'format' is open. The channel map applies to
+ * text and .dctb input; a .dctz file was suppressed with the DAQ's.
+*******************************************************************************/
+#define INPUT_TEXT 0
+#define INPUT_DCTB 1
+#define INPUT_DCTZ 2
+#define INPUT_STREAM 3  // .gz/.zst, decompressed on the fly
+
+typedef struct DCTInput {
+  int format;
+  const DCTChannelMap* channels;  // Columns of the wires' ADCs
+  DCTReader reader;
+  DCTBReader bReader;
+  DCTZReader zReader;
+  DCTStream* stream;
+  DCTIndex index;  // Text input split into chunks: where the events start
+} DCTInput;
+
+/*******************************************************************************
+ * Decodes the next text event into tm, from 'reader' or from the stream of a
+ * compressed dump, and sets *bytes to the text it took. Returns false at the
+ * end of the input.
+*******************************************************************************/
+static bool readTextEvent(const DCTInput* in, DCTReader* reader,
+                          Int_t (*tm)[NUMCHANNELS], long* bytes) {
+  DCTReader view;
+  if (in->format == INPUT_STREAM) {
+    if (!nextStreamEvent(in->stream, &view)) return false;
+    reader = &view;
+  }
+  const char* from = reader->cur;
+  if (!readEventChannels(reader, tm, in->channels, adc_offsets)) return false;
+  *bytes = reader->cur - from;
+  return true;
+}
+
+/*******************************************************************************
+ * Reader thread of a worker: decodes up to nEvents text events (see
+ * readTextEvent()) into the ring, then closes it. Adds the decoding time and
+ * bytes read to the worker's counters C (the worker itself doesn't touch
+ * those two), and hands the mapped pages decoded back to the kernel now and
+ * then.
+*******************************************************************************/
+static void readAhead(DCTRing* Q, const DCTInput* in, DCTReader reader,
+                      long nEvents, Counter* C) {
+  const char* done = reader.cur;  // Start of the input not handed back yet
+  std::chrono::steady_clock::time_point t0;
+  long bytes;
+
+  for (long i = 0; i < nEvents; i++) {
+    Int_t(*tm)[NUMCHANNELS] = (Int_t(*)[NUMCHANNELS])ringReserve(Q);
+    if (C) t0 = std::chrono::steady_clock::now();
+    if (!readTextEvent(in, &reader, tm, &bytes)) break;
+    if (C) {
+      countStage(C, instStage(INST_READ), &t0);
+      countAdd(&C[INST_BYTES], bytes);
+    }
+    ringPush(Q, bytes);
+    if (in->format == INPUT_TEXT && i % 256 == 255) {
+      releaseRange(done, reader.cur);
+      done = reader.cur;
+    }
+  }
+  ringClose(Q);
+}
+
+/*******************************************************************************
+ * Analyzes events from 'first' until 'last' or the end of the input, whichever
+ * comes first, for worker k. Text events come from 'reader', which must
+ * already sit at event 'first', decoded by a reader thread if
+ * P->readAhead > 0. Returns the number of events read.
+*******************************************************************************/
+static long analyzeChunk(DCTPipeline* P, int k, DCTReader reader,
+                         const DCTInput* in, long first, long last,
+                         const std::vector<ROIParams>& cutSets,
+                         const std::vector<int>& passSet) {
+  Int_t tmBuf[NUMTSTEPS][NUMCHANNELS];  // Stores the wires' adc readings
+                                        // time-major, as in the file
+  const Int_t(*tm)[NUMCHANNELS] = tmBuf;  // Or a slot of the read-ahead ring
+  EventStats stats;                       // Scratch space of the event kernel
+  EventKernel kernel = selectEventKernel();  // AVX-512, AVX2 or scalar
+  std::vector<CutSetROIs> rois(cutSets.size());
+  const DCTBReader* bReader = &in->bReader;
+  const DCTZReader* zReader = &in->zReader;
+  const DCTChannelMap* map = in->channels;
+  bool binary = in->format == INPUT_DCTB;
+  bool suppressed = in->format == INPUT_DCTZ;
+  bool streamed = in->format == INPUT_STREAM;
+  bool ahead = !binary && !suppressed && P->readAhead > 0;
+  // Start of the input not handed back to the kernel yet
+  const char* done = binary       ? (const char*)dctbEvent(bReader, first)
+                     : suppressed ? (const char*)dctzEvent(zReader, first)
+                                  : reader.cur;
+  DCTInstrument* I = P->instrument;
+  Counter* C = I ? workerCounters(I, k) : NULL;
+  std::chrono::steady_clock::time_point t0;
+  long event;
+
+  DCTRing ring;
+  std::thread reading;
+  if (ahead) {
+    initRing(&ring, P->readAhead, NUMTSTEPS * NUMCHANNELS);
+    reading = std::thread(readAhead, &ring, in, reader, last - first, C);
+  }
+
+  for (event = first; event < last; event++) {
+    /* Get one event. Binary and zero-suppressed events are used straight
+     * from the mapping, text events go through the channel-parallel kernel
+     * all wires at once */
+    const int16_t* bEvent = NULL;
+    const DCTZWire* zEvent = NULL;
+    long bytes = 0;
+    if (C) t0 = std::chrono::steady_clock::now();
+    if (binary) {
+      if (!(bEvent = dctbEvent(bReader, event))) break;
+    } else if (suppressed) {
+      if (!(zEvent = dctzEvent(zReader, event))) break;
+    } else if (ahead) {
+      if (!(tm = (const Int_t(*)[NUMCHANNELS])ringFront(&ring, NULL))) break;
+    } else if (!readTextEvent(in, &reader, tmBuf, &bytes)) {
+      break;
+    }
+    if (C && ahead) {
+      t0 = std::chrono::steady_clock::now();  // The reader thread counts it
+    } else if (C) {
+      countStage(C, instStage(INST_READ), &t0);
+      countAdd(&C[INST_BYTES], binary       ? bReader->header.eventSize
+                               : suppressed ? dctzEventSize(zReader, event)
+                                            : bytes);
+    }
+
+    /* Find the ROIs once per set of cuts. The ADC extrema aren't in a .dctz
+     * file and are left INIT_EXTREMA'd */
+    if (!binary && !suppressed)
+      textEventROIs(kernel, tm, cutSets, &stats, &rois);
+    for (size_t s = 0; suppressed && s < cutSets.size(); s++) {
+      CutSetROIs* R = &rois[s];
+      for (int i = 0; i < 2 * NUMWIRES; i++) INIT_EXTREMA(R->adc[i]);
+      dctzEventROIs(zReader, event, &cutSets[s], ROISIZE, R->sum,
+                    R->waveGood);
+    }
+    for (size_t s = 0; binary && s < cutSets.size(); s++) {
+      CutSetROIs* R = &rois[s];
+      for (int w = 0; w < NUMWIRES; w++) {
+        int Ladc = 2 * w;      // Left adc reading
+        int Radc = 2 * w + 1;  // Right adc reading
+        INIT_EXTREMA(R->adc[Ladc]);  // Inits. values for algorithm
+        INIT_EXTREMA(R->adc[Radc]);  // + re-usability
+        INIT_ROI(R->sum[w]);
+        R->waveGood[w] = findWireROI(bEvent + map->column[Ladc] * NUMTSTEPS,
+                                     bEvent + map->column[Radc] * NUMTSTEPS, w,
+                                     &cutSets[s], &R->adc[Ladc],
+                                     &R->adc[Radc], &R->sum[w]);
+      }
+    }
+
+    if (C) {
+      countStage(C, instStage(INST_ROI), &t0);
+      if (binary)
+        countWires(I, C, bEvent, map->column, NUMTSTEPS, 1, cutSets, rois);
+      else if (suppressed)
+        countSuppressedWires(I, C, zEvent, cutSets, rois);
+      else
+        countWires(I, C, &tm[0][0], NULL, 1, NUMCHANNELS, cutSets, rois);
+      countAdd(&C[INST_EVENTS], 1);
+    }
+
+    /* Hand them to the passes */
+    passEvent(P, k, event, passSet, rois, C);
+    if (ahead) ringPop(&ring);
+
+    /* Hand the pages already analyzed back to the kernel now and then */
+    if (!ahead && !streamed && (event - first) % 256 == 255) {
+      const char* cur =
+          binary       ? (const char*)bEvent + bReader->header.eventSize
+          : suppressed ? (const char*)zEvent + dctzEventSize(zReader, event)
+                       : reader.cur;
+      releaseRange(done, cur);
+      done = cur;
+    }
+  }
+  if (reading.joinable()) reading.join();
+  return event - first;
+}
+
+/*******************************************************************************
+ * A run being analyzed in chunks (see openRun())
+*******************************************************************************/
+struct DCTRun {
+  DCTPipeline* P;
+  std::string infile;
+  DCTInput in;
+  DCTStream stream;               // The input, if it's compressed
+  DCTChannelMap channels;         // The DAQ's map, unless P has one
+  std::vector<ROIParams> cutSets;
+  std::vector<int> passSet;
+  long counted;                   // Events of the run, -1 until EOF
+  long first;                     // First event read (a shard's)
+  long nEvents;                   // Events to read, -1 until EOF
+  int nChunks;
+  std::vector<DCTReader> views;   // Text input: reader at each chunk's start
+  std::vector<long> nRead;        // Events read by each chunk
+  Reporter reporter;
+};
+
+/*******************************************************************************
+ * Closes the input of a run
+*******************************************************************************/
+static void closeInput(DCTRun* R) {
+  if (R->in.format == INPUT_DCTB)
+    closeDCTB(&R->in.bReader);
+  else if (R->in.format == INPUT_DCTZ)
+    closeDCTZ(&R->in.zReader);
+  else if (R->in.format == INPUT_STREAM)
+    closeStream(&R->stream);
+  else
+    closeReader(&R->in.reader);
+}
+
+/*******************************************************************************
+ * Opens a run
+*******************************************************************************/
+DCTRun* openRun(DCTPipeline* P, const char* infile, int nThreads) {
+  /*****************************************************************************
+  * Opens data file
+  *****************************************************************************/
+  DCTRun* R = new DCTRun;
+  DCTInput& in = R->in;
+  bool opened;
+  if (nThreads < 1) nThreads = 1;
+  R->P = P;
+  R->infile = infile;
+  in = DCTInput();
+  in.format = isDCTB(infile)         ? INPUT_DCTB
+              : isDCTZ(infile)       ? INPUT_DCTZ
+              : isCompressed(infile) ? INPUT_STREAM
+                                     : INPUT_TEXT;
+  in.stream = &R->stream;
+  if (in.format == INPUT_DCTB)
+    opened = openDCTB(&in.bReader, infile);
+  else if (in.format == INPUT_DCTZ)
+    opened = openDCTZ(&in.zReader, infile);
+  else if (in.format == INPUT_STREAM)
+    opened = openStream(&R->stream, infile, nThreads);
+  else
+    opened = openReader(&in.reader, infile);
+  if (!opened) {
+    if (in.format == INPUT_STREAM) closeStream(&R->stream);
+    printf("Can't open %s\n", infile);
+    delete R;
+    return NULL;
+  }
+  initChannelMap(&R->channels);
+  in.channels = P->channels ? P->channels : &R->channels;
+
+  /*****************************************************************************
+  * Reads until the end of the input, or until the last event any pass wants.
+  * With more than one thread, or in a shard, text events are looked up in
+  * the file's offset index (see DCT_Index.h; built and saved the first time),
+  * so the workers can seek straight to their chunks. A compressed dump
+  * can't be split before it is decompressed: its threads decompress it, and
+  * one worker analyzes it.
+  *****************************************************************************/
+  long maxEvents = setupPasses(P, &R->cutSets, &R->passSet);
+  bool sharded = P->nShards > 1 || P->partial != NULL;
+  bool refused = false;
+
+  /* A shard needs to know where its events are */
+  if (sharded && in.format == INPUT_STREAM) {
+    printf("%s can't be sharded, decompress it first\n", infile);
+    refused = true;
+  }
+  for (size_t i = 0; P->partial && i < P->passes.size(); i++) {
+    if (!P->passes[i].save) {
+      printf("%s can't be sharded\n", P->passes[i].name);
+      refused = true;
+    }
+  }
+
+  /* A .dctz file only has the ROIs of the cuts it was made with */
+  for (size_t i = 0; !refused && in.format == INPUT_DCTZ &&
+                     i < P->passes.size(); i++) {
+    if (dctzCutSet(&in.zReader, &P->passes[i].cuts) < 0) {
+      printf("%s was zero-suppressed with other cuts than %s uses\n", infile,
+             P->passes[i].name);
+      refused = true;
+      break;
+    }
+  }
+  if (!refused && in.format == INPUT_DCTZ &&
+      memcmp(in.channels->column, R->channels.column,
+             sizeof R->channels.column)) {
+    printf("%s was zero-suppressed with the DAQ's channel map\n", infile);
+    refused = true;
+  }
+  if (refused) {
+    closeInput(R);
+    delete R;
+    return NULL;
+  }
+
+  R->nEvents = -1;  // Until EOF
+  if (in.format == INPUT_DCTB)
+    R->nEvents = in.bReader.header.numEvents;
+  else if (in.format == INPUT_DCTZ)
+    R->nEvents = in.zReader.header.numEvents;
+  else if (in.format == INPUT_TEXT && (nThreads > 1 || sharded)) {
+    openIndex(&in.index, &in.reader, infile);
+    R->nEvents = in.index.header.numEvents;
+  }
+  if (maxEvents >= 0 && (R->nEvents < 0 || R->nEvents > maxEvents))
+    R->nEvents = maxEvents;
+  R->counted = R->nEvents;
+  R->first = 0;
+  if (sharded) {
+    long last;
+    chunkRange(R->nEvents, P->nShards, P->shard, &R->first, &last);
+    R->nEvents = last - R->first;
+  }
+  R->nChunks = 0;
+  return R;
+}
+
+long runEvents(const DCTRun* R) { return R->nEvents; }
+
+/*******************************************************************************
+ * Splits the run into chunks and begins the passes, one worker per chunk
+*******************************************************************************/
+int startRun(DCTRun* R, int nChunks) {
+  DCTPipeline* P = R->P;
+  if (nChunks < 1 || R->nEvents < 0) nChunks = 1;
+  R->nChunks = nChunks;
+  if (nChunks > 1) ROOT::EnableThreadSafety();
+
+  long end = R->nEvents < 0 ? -1 : R->first + R->nEvents;
+  for (size_t i = 0; i < P->passes.size(); i++)
+    P->passes[i].begin(P->passes[i].data, nChunks, end);
+  startReporter(P, &R->reporter, R->infile.c_str(), nChunks, R->cutSets,
+                R->passSet);
+
+  /* Text: a reader at the start of every chunk, after the events of the
+   * shards in front */
+  R->views.assign(nChunks, R->in.reader);
+  if (R->in.format == INPUT_TEXT && (nChunks > 1 || R->first > 0)) {
+    const DCTIndex* idx = R->in.index.offsets.empty() ? NULL : &R->in.index;
+    chunkReaders(&R->in.reader, idx, R->first, R->nEvents, nChunks,
+                 &R->views[0]);
+  }
+  R->nRead.assign(nChunks, 0);
+  return nChunks;
+}
+
+/*******************************************************************************
+ * Analyzes chunk k
+*******************************************************************************/
+long runChunk(DCTRun* R, int k) {
+  long first = 0, last = LONG_MAX;
+  if (R->nEvents >= 0) {
+    chunkRange(R->nEvents, R->nChunks, k, &first, &last);
+    first += R->first;
+    last += R->first;
+  }
+  R->nRead[k] = analyzeChunk(R->P, k, R->views[k], &R->in, first, last,
+                             R->cutSets, R->passSet);
+  return R->nRead[k];
+}
+
+/*******************************************************************************
+ * Ends the passes and closes the run
+*******************************************************************************/
+long closeRun(DCTRun* R) {
+  const char* infile = R->infile.c_str();
+  long total = 0;
+  for (int k = 0; k < R->nChunks; k++) total += R->nRead[k];
+  bool corrupt = R->in.format == INPUT_STREAM && streamError(&R->stream);
+  if (corrupt)
+    printf("%s is corrupt or cut short after %ld events\n", infile, total);
+  printf("Processed %ld events from %s\n", total, infile);
+  DCTPipeline* P = R->P;
+  if (P->partial)
+    writeShardInfo(P->partial, P->shard, P->nShards, R->counted, R->first,
+                   total);
+  bool saved = endPasses(P, &R->reporter, R->nChunks, total);
+
+  closeInput(R);
+  delete R;
+  return corrupt || !saved ? -1 : total;
+}
+
+/*******************************************************************************
+ * Main: one chunk per thread
+*******************************************************************************/
+long runPipeline(DCTPipeline* P, const char* infile, int nThreads) {
+  if (nThreads < 1) nThreads = 1;
+  DCTRun* R = openRun(P, infile, nThreads);
+  if (!R) return -1;
+
+  int nWorkers = startRun(R, R->in.format == INPUT_STREAM ? 1 : nThreads);
+  runWorkers(nWorkers, [R](int k) { runChunk(R, k); });
+  return closeRun(R);
+}
+
+/*******************************************************************************
+ * Main of the online mode
+*******************************************************************************/
+long followPipeline(DCTPipeline* P, const char* infile, const DCTFollow* F) {
+  DCTTail tail;
+  if (!openTail(&tail, infile)) {
+    printf("Can't open %s\n", infile);
+    return -1;
+  }
+
+  std::vector<ROIParams> cutSets;
+  std::vector<int> passSet;
+  long maxEvents = setupPasses(P, &cutSets, &passSet);
+  for (size_t i = 0; i < P->passes.size(); i++)
+    P->passes[i].begin(P->passes[i].data, 1, -1);
+  Reporter R;
+  startReporter(P, &R, infile, 1, cutSets, passSet);
+  DCTInstrument* I = P->instrument;
+  Counter* C = I ? workerCounters(I, 0) : NULL;
+  std::chrono::steady_clock::time_point t0;
+
+  /*****************************************************************************
+  * Reads what the DAQ appended, a pollTail() budget at a time, and analyzes
+  * the complete events; once nothing is new, waits F->poll seconds for more.
+  * The display is refreshed every F->refresh seconds, also while working
+  * through a backlog (checked every 64 events).
+  *****************************************************************************/
+  std::vector<Int_t> tmBuf(NUMTSTEPS * NUMCHANNELS);  // Wires' adc readings
+  Int_t(*tm)[NUMCHANNELS] = (Int_t(*)[NUMCHANNELS]) & tmBuf[0];
+  DCTChannelMap channels;
+  if (!P->channels) initChannelMap(&channels);
+  const DCTChannelMap* map = P->channels ? P->channels : &channels;
+  EventStats stats;
+  EventKernel kernel = selectEventKernel();
+  std::vector<CutSetROIs> rois(cutSets.size());
+  std::chrono::steady_clock::time_point lastUpdate, lastData;
+  lastUpdate = lastData = std::chrono::steady_clock::now();
+  long event = 0;
+
+  for (;;) {
+    long got = pollTail(&tail);
+    if (got < 0) {
+      printf("%s got shorter, stopping\n", infile);
+      break;
+    }
+    if (got > 0) lastData = std::chrono::steady_clock::now();
+
+    DCTReader view;
+    while ((maxEvents < 0 || event < maxEvents) &&
+           nextTailEvent(&tail, &view)) {
+      if (C) t0 = std::chrono::steady_clock::now();
+      readEventChannels(&view, tm, map, adc_offsets);
+      if (C) {
+        countStage(C, instStage(INST_READ), &t0);
+        countAdd(&C[INST_BYTES], view.size);
+      }
+      textEventROIs(kernel, tm, cutSets, &stats, &rois);
+      if (C) {
+        countStage(C, instStage(INST_ROI), &t0);
+        countWires(I, C, &tm[0][0], NULL, 1, NUMCHANNELS, cutSets, rois);
+        countAdd(&C[INST_EVENTS], 1);
+      }
+      passEvent(P, 0, event, passSet, rois, C);
+      event++;
+      if (event % 64 == 0 && F->update &&
+          secondsSince(lastUpdate) >= F->refresh) {
+        F->update(F->data, event);
+        lastUpdate = std::chrono::steady_clock::now();
+      }
+    }
+
+    if (maxEvents >= 0 && event >= maxEvents) break;
+    if (F->stop && *F->stop) break;
+    if (F->update && secondsSince(lastUpdate) >= F->refresh) {
+      F->update(F->data, event);
+      lastUpdate = std::chrono::steady_clock::now();
+    }
+    if (F->idleTimeout >= 0 && secondsSince(lastData) >= F->idleTimeout) break;
+    if (!got) usleep((useconds_t)(F->poll * 1e6));
+  }
+
+  printf("Processed %ld events from %s\n", event, infile);
+  endPasses(P, &R, 1, event);
+  if (F->update) F->update(F->data, event);
+
+  closeTail(&tail);
+  return event;
+}
@@ -0,0 +1,182 @@
+/*
+ * DCT_PIPELINE.h
+ *
+ * Single-read analysis pipeline of libdct. The data file is read and decoded
+ * once; for every event the per-wire ROI results are computed once per set of
+ * cuts and handed to every registered pass that asked for those cuts. Any
+ * combination of analyses (DataTest5/7/9, see DCT_Analysis.h) then costs one
+ * pass over the data.
+ *
+ * Usage:
+ *   DCTPipeline P;
+ *   addDataTest5Pass(&P, &H5);
+ *   addDataTest7Pass(&P, &H7);
+ *   runPipeline(&P, "NI_PDCT_17.txt", nThreads);
+ *
+ */
+
+#ifndef DCT_PIPELINE_H
+#define DCT_PIPELINE_H
+
+#include <vector>
+
+#include "TDirectory.h"
+#include "TH1F.h"
+
+#include "DCT_Channels.h"
+#include "DCT_Cuts.h"
+#include "DCT_Instrument.h"
+#include "DCT_ROI.h"
+
+#ifndef NUMADCS
+#define NUMADCS 32
+#endif
+
+/*******************************************************************************
+ * What a pass gets for each event. All arrays are indexed by ADC or wire and
+ * only valid during the call.
+*******************************************************************************/
+typedef struct EventROIs {
+  long event;             // Event number in the file
+  const Extrema* adc;     // Min + max of each ADC (2 * NUMWIRES)
+  const ROI* sum;         // Hit record of each wire (NUMWIRES)
+  const bool* waveGood;   // Wire crossed threshold and didn't malfunction
+} EventROIs;
+
+/*******************************************************************************
+ * One analysis pass. The event loop is split across nWorkers threads in
+ * contiguous chunks (see DCT_Parallel.h); 'event' is called from worker
+ * 'worker' in event order within its chunk, so a pass keeps one set of
+ * results per worker and merges them in worker order in 'end'.
+ *
+ * A pass that can be sharded (see DCT_Shard.h) also has 'save', called
+ * instead of 'end' in a shard: it merges the workers and writes what 'end'
+ * would finish from to dir, and frees the state. 'load' adds such a partial
+ * result, after 'begin', as the results of worker 'worker'; 'end' then
+ * finishes the shards like the chunks of one run.
+*******************************************************************************/
+typedef struct DCTPass {
+  const char* name;  // For messages, and the directory of partial results
+  ROIParams cuts;    // Cuts the ROIs given to 'event' are found with
+  long maxEvents;    // Only events [0, maxEvents) are given, -1 for all
+  void* data;        // The pass's own state, freed by 'end'
+
+  // Events [0, nEvents) at most are read (a shard reads the last part of
+  // them), -1 if that isn't known before reading (single thread text input,
+  // read until EOF)
+  void (*begin)(void* data, int nWorkers, long nEvents);
+  void (*event)(void* data, int worker, const EventROIs* e);
+  // nEvents is the number of events actually read
+  void (*end)(void* data, int nWorkers, long nEvents);
+
+  // Partial results, NULL if the pass can't be sharded. Return false, with a
+  // message, if dir can't be written or doesn't have them.
+  bool (*save)(void* data, int nWorkers, long nEvents, TDirectory* dir);
+  bool (*load)(void* data, int worker, TDirectory* dir);
+} DCTPass;
+
+/*******************************************************************************
+ * The registered passes, where to count what the run did (see
+ * DCT_Instrument.h), which ADC columns feed each wire (see DCT_Channels.h),
+ * how far ahead text events are decoded and, in a shard, which events to
+ * read and where to save the partial results (see DCT_Shard.h).
+ *
+ * With readAhead > 0 every worker of runPipeline() gets a reader thread that
+ * decodes its text events into a ring of readAhead event buffers (see
+ * DCT_Ring.h) while the worker finds the ROIs and runs the passes, so a run
+ * takes about as long as the slower of the two instead of their sum.
+*******************************************************************************/
+#define DCT_READAHEAD 16  // Default readAhead, 64 KB per event buffer
+
+typedef struct DCTPipeline {
+  std::vector<DCTPass> passes;
+  DCTInstrument* instrument = NULL;      // Counters and timers, NULL for none
+  const DCTChannelMap* channels = NULL;  // Channel map, NULL for the DAQ's
+  int readAhead = DCT_READAHEAD;         // Text events decoded ahead of each
+                                         // worker, 0 to decode in the worker
+  int shard = 0;                         // Only events of shard 'shard' of
+  int nShards = 1;                       // nShards (chunkRange()) are read
+  TDirectory* partial = NULL;            // Shard: 'save' the passes here
+                                         // instead of ending them
+} DCTPipeline;
+
+/*******************************************************************************
+ * Registers a pass. Passes run in the order they were added. A pipeline is
+ * run once.
+*******************************************************************************/
+inline void addPass(DCTPipeline* P, const DCTPass* pass) {
+  P->passes.push_back(*pass);
+}
+
+/*******************************************************************************
+ * Histograms of every worker: worker k's copy of hists[i] is (*H)[k * n + i],
+ * worker 0 fills the originals. mergeWorkerHists() adds the copies to the
+ * originals in worker order and deletes them. All fills are whole numbers, so
+ * the sums are exact and match the single thread run bin for bin.
+*******************************************************************************/
+void workerHists(TH1F* const* hists, int n, int nWorkers,
+                 std::vector<TH1F*>* H);
+void mergeWorkerHists(std::vector<TH1F*>* H, int n, int nWorkers);
+
+/*******************************************************************************
+ * Reads infile (text, .dctb, .dctz, or text compressed as .gz/.zst, see
+ * DCT_Stream.h) once and feeds every event to all passes. Stops at the end of
+ * the file or once no pass wants more events. Returns the number of events
+ * read, -1 if infile can't be opened or a compressed one is corrupt.
+ * With P->nShards > 1 only the events of shard P->shard are read; the events
+ * are counted first, and compressed dumps can't be sharded.
+*******************************************************************************/
+long runPipeline(DCTPipeline* P, const char* infile, int nThreads);
+
+/*******************************************************************************
+ * runPipeline() in steps, for callers that schedule the chunks of several
+ * runs themselves (see DCT_Batch.h):
+ *   openRun()   opens infile and counts its events, for text if
+ *               nThreads > 1 or in a shard (NULL, with a message, if it
+ *               can't be opened)
+ *   runEvents() events that will be read, -1 if only known at the end (text
+ *               read by one thread, compressed dumps); in a shard only its
+ *               own
+ *   startRun()  splits them into nChunks contiguous chunks and begins the
+ *               passes with one worker per chunk; returns the number of
+ *               chunks, 1 if the number of events isn't known
+ *   runChunk()  analyzes chunk k, from any thread, each chunk once
+ *   closeRun()  once every chunk is done, ends the passes and frees the run;
+ *               returns runPipeline()'s result
+ * The passes merge the chunks in chunk order, so the histograms are the same
+ * for any number of chunks.
+*******************************************************************************/
+typedef struct DCTRun DCTRun;
+
+DCTRun* openRun(DCTPipeline* P, const char* infile, int nThreads);
+long runEvents(const DCTRun* R);
+int startRun(DCTRun* R, int nChunks);
+long runChunk(DCTRun* R, int k);
+long closeRun(DCTRun* R);
+
+/*******************************************************************************
+ * Online mode: follows a text dump the DAQ is still writing (see DCT_Tail.h)
+ * and feeds every complete event to all passes as soon as it's in. The
+ * passes run with one worker, so their histograms are the ones being filled
+ * and can be drawn while the run goes on.
+*******************************************************************************/
+typedef struct DCTFollow {
+  double refresh;       // Seconds between calls to 'update'
+  double poll;          // Seconds to wait when the file hasn't grown
+  double idleTimeout;   // Stop after this many seconds without new data, -1
+                        // to keep going until *stop
+  volatile bool* stop;  // Set to stop (e.g. from a signal handler), or NULL
+  void* data;           // Passed to 'update'
+  // Called every 'refresh' seconds, and once more after the passes ended.
+  // nEvents is the number of events analyzed so far. NULL for none.
+  void (*update)(void* data, long nEvents);
+} DCTFollow;
+
+/*******************************************************************************
+ * Follows infile until the idle timeout, *stop, the file getting shorter or
+ * no pass wanting more events. Returns the number of events analyzed, -1 if
+ * infile can't be opened.
+*******************************************************************************/
+long followPipeline(DCTPipeline* P, const char* infile, const DCTFollow* F);
+
+#endif
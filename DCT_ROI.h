@@ -0,0 +1,186 @@
+/*
+ * DCT_ROI.h
+ *
+ * Region of interest (ROI) finder shared by the DataTest macros. Works on a
+ * pair of left/right ADC waveforms given as plain pointers, so the samples can
+ * come from the text reader's adc[][] block or straight from a mapped binary
+ * (.dctb) file.
+ *
+ */
+
+#ifndef DCT_ROI_H
+#define DCT_ROI_H
+
+#include <vector>
+
+#ifndef NUMWIRES
+#define NUMWIRES 8
+#endif
+#ifndef NUMTSTEPS
+#define NUMTSTEPS 1000
+#endif
+#define NUMCHANNELS (2 * NUMWIRES)  // ADCs read per event: left, right of
+                                    // each wire
+#ifndef ROISIZE
+#define ROISIZE 25
+#endif
+
+#define INIT_EXTREMA(X) \
+  X = {.minval = 10000, .minloc = -1, .maxval = 10000, .maxloc = -1}
+
+#define INIT_ROI(X)        \
+  X = {.minval = 10000,    \
+       .minloc = -1,       \
+       .t_eStart = -1,     \
+       .t_eEnd = 0,        \
+       .integral = 0,      \
+       .dn_dt = 0,         \
+       .spikeOver = false, \
+       .badloc = -1}
+
+/*******************************************************************************
+ * Min + max of one ADC in one event
+*******************************************************************************/
+typedef struct Extrema {
+  int minval;  // ADC minimum
+  int minloc;  // ADC minimum bin number
+  int maxval;  // ADC maximum
+  int maxloc;  // ADC maximum bin number
+} Extrema;
+
+/*******************************************************************************
+ * Hit record of one wire (sum of its two ADCs) in one event. ROI = region of
+ * interest, has a max bin size (above)
+ * Note: 'minval' is just the maximum voltage (is packaged negatively).
+*******************************************************************************/
+typedef struct ROI {
+  int minval;      // Wire minimum
+  int minloc;      // Wire minimum bin number
+  int t_eStart;    // Event start time
+  int t_eEnd;      // Event end time
+  int integral;    // Sum of the wire sum over the ROI (if spikeOver)
+  int dn_dt;       // Sum of the wire sum time derivative (if spikeOver)
+  bool spikeOver;  // If event ends before ROISIZE, set this to true
+  int badloc;      // First malfunctioning bin (outside the safe min/max), -1
+                   // if none
+} ROI;
+
+/*******************************************************************************
+ * Per-event results of one wire (or of all wires), one column per quantity
+ * and one row per event. Sized to the run with resizePer().
+*******************************************************************************/
+typedef struct per {
+  std::vector<int> minvals;   // Event minimum
+  std::vector<int> integral;  // Integral of event voltage
+  std::vector<int> dn_dt;     // Integral of event voltage time derivative
+  std::vector<int> drift;     // Drift time, -1 if the wave was bad
+} per;
+
+inline void resizePer(per* p, long nEvents) {
+  p->minvals.resize(nEvents, 0);
+  p->integral.resize(nEvents, 0);
+  p->dn_dt.resize(nEvents, 0);
+  p->drift.resize(nEvents, -1);
+}
+
+/*******************************************************************************
+ * Cuts used by the ROI finder. thresh[] already includes threshOffset.
+*******************************************************************************/
+typedef struct ROIParams {
+  int thresh[NUMWIRES];  // Min voltage to be considered an event, per wire
+  int safeMinimum;       // Anything outside the safe min/max gets thrown out
+  int safeMaximum;
+  int min_eStart;        // # ROI start time = minloc - min_eStart
+  int threshFrac;        // Inverse % of threshold for event to be over
+} ROIParams;
+
+/*******************************************************************************
+ * Finds the min + max voltage of both ADCs of wire w and the region of
+ * interest of their sum, in one pass over the samples. L/R must be
+ * INIT_EXTREMA'd and sum INIT_ROI'd by the caller.
+ *
+ * The ROI starts min_eStart bins before the first threshold crossing (the
+ * crossing always comes before the minimum, so no second pass is needed to
+ * know minloc). It ends at the first bin back above thresh/threshFrac, where
+ * the integral and dN/dt of the ROI are known and the ROI bookkeeping stops;
+ * the rest of the wave only goes through the min/max and malfunction checks.
+ * dN/dt telescopes to wireSum[t_eStart] - wireSum[t_eEnd]. The wire sum is
+ * never stored, the few bins before the crossing are re-added from L and R.
+ *
+ * Returns false if the wire malfunctioned (as soon as the bad sample is seen)
+ * or never crossed threshold.
+*******************************************************************************/
+template <typename T>
+bool findWireROI(const T* Lwave, const T* Rwave, int w, const ROIParams* p,
+                 Extrema* L, Extrema* R, ROI* sum) {
+  enum { SEARCH, INPULSE, DONE } state = SEARCH;
+  const int thresh = p->thresh[w];
+  const int overThresh = thresh / p->threshFrac;
+  int integral = 0;  // Running ROI integral, kept once the pulse is over
+
+  for (int t = 0; t < NUMTSTEPS; t++) {
+    int Lval = Lwave[t];
+    int Rval = Rwave[t];
+    int val = Lval + Rval;
+
+    /* Check for malfunction */
+    if (Lval < p->safeMinimum || Rval < p->safeMinimum ||
+        Lval > p->safeMaximum || Rval > p->safeMaximum) {
+      sum->badloc = t;
+      return false;
+    }
+
+    /* Left ADC */
+    if (Lval < L->minval) {
+      L->minval = Lval;
+      L->minloc = t;
+    }
+    if (Lval > L->maxval) {
+      L->maxval = Lval;
+      L->maxloc = t;
+    }
+    /* Right ADC */
+    if (Rval < R->minval) {
+      R->minval = Rval;
+      R->minloc = t;
+    }
+    if (Rval > R->maxval) {
+      R->maxval = Rval;
+      R->maxloc = t;
+    }
+    /* Together now */
+    if (val < sum->minval) {
+      sum->minval = val;
+      sum->minloc = t;
+    }
+
+    if (state == DONE) continue;
+
+    /* First threshold crossing opens the ROI. Pulses that start within
+     * min_eStart bins of the trigger are never closed, as before */
+    if (state == SEARCH) {
+      if (val < thresh) {
+        sum->t_eStart = t < p->min_eStart ? 0 : t - p->min_eStart;
+        sum->t_eEnd = sum->t_eStart + ROISIZE;
+        for (int i = sum->t_eStart; i <= t; i++)
+          integral += Lwave[i] + Rwave[i];
+        state = sum->t_eStart > 0 ? INPULSE : DONE;
+      }
+    }
+    /* Find the bin where the event is pretty much over */
+    else if (val > overThresh) {
+      sum->spikeOver = true;
+      sum->t_eEnd = t;
+      sum->integral = integral;
+      sum->dn_dt = Lwave[sum->t_eStart] + Rwave[sum->t_eStart] - val;
+      state = DONE;
+    } else {
+      integral += val;
+    }
+  }
+
+  /* If no event is found, mark the wave bad */
+  return sum->t_eStart >= 0;
+}
+
+#endif
@@ -0,0 +1,179 @@
+/*
+ * DCT_RT.h
+ *
+ * Incremental r-t relation. The r-t relation is the cumulative drift time
+ * distribution, r(t) = dNdt->Integral(0, t). RTBuilder keeps that prefix sum
+ * up to date as drift times come in, so r(t) is a lookup instead of an
+ * Integral() over the histogram.
+ *
+ * RTCurve adds up r-t curves into a histogram the way
+ *   for (t = 0; t < nSteps; t++) rt->Fill(t, dNdt->Integral(0, t));
+ * does, in O(bins) per curve: the time steps that land in the same bin of rt
+ * and read the same bin of dN/dt are added together. writeFills() puts the
+ * result in rt with the contents, errors, entries and stats of those Fill()s,
+ * equal up to float rounding of very large bins (see writeFills()).
+ *
+ */
+
+#ifndef DCT_RT_H
+#define DCT_RT_H
+
+#include <math.h>
+
+#include <vector>
+
+#include "TH1.h"
+
+/*******************************************************************************
+ * Fills of a histogram, added up before they go in. Only the bins and stats
+ * are kept, so a whole group of fills costs O(1).
+*******************************************************************************/
+typedef struct HistFills {
+  int nbins;                  // Bins of the histogram, without under/overflow
+  std::vector<double> w;      // Sum of weights per bin
+  std::vector<double> w2;     // Sum of squared weights per bin
+  double entries;             // Number of fills
+  double stats[4];            // sumw, sumw2, sumwx, sumwx2 (see TH1::GetStats)
+  bool weighted;              // Some fill had a weight other than 1
+} HistFills;
+
+inline void initFills(HistFills* F, const TH1* h) {
+  F->nbins = h->GetNbinsX();
+  F->w.assign(F->nbins + 2, 0);
+  F->w2.assign(F->nbins + 2, 0);
+  F->entries = 0;
+  for (int i = 0; i < 4; i++) F->stats[i] = 0;
+  F->weighted = false;
+}
+
+/*******************************************************************************
+ * n fills of weight wt into bin, at positions x adding up to sumX (sumX2 for
+ * x*x). As TH1::Fill(), under/overflow don't count in the stats.
+*******************************************************************************/
+inline void addFills(HistFills* F, int bin, double n, double wt, double sumX,
+                     double sumX2) {
+  F->w[bin] += n * wt;
+  F->w2[bin] += n * wt * wt;
+  F->entries += n;
+  if (wt != 1) F->weighted = true;
+  if (bin < 1 || bin > F->nbins) return;
+  F->stats[0] += n * wt;
+  F->stats[1] += n * wt * wt;
+  F->stats[2] += wt * sumX;
+  F->stats[3] += wt * sumX2;
+}
+
+/*******************************************************************************
+ * Adds the fills to h. Errors are only set if a fill was weighted, same as
+ * TH1::Fill() turning on Sumw2. Not bit for bit the Fill() loop: the fills are
+ * summed in double and rounded to the bin type (float for a TH1F) once, where
+ * Fill() rounds after each one, and the stats are added in another order. A
+ * bin can differ once its content outgrows the float mantissa (2^24); the stats
+ * only in their last bits.
+*******************************************************************************/
+inline void writeFills(const HistFills* F, TH1* h) {
+  double stats[4];
+  double entries = h->GetEntries();
+
+  if (!F->entries) return;
+  h->GetStats(stats);  // Before SetBinContent(), which resets them
+  if (F->weighted && h->GetSumw2N() == 0) h->Sumw2();
+  for (int b = 0; b <= F->nbins + 1; b++) {
+    double err = h->GetBinError(b);
+    h->SetBinContent(b, h->GetBinContent(b) + F->w[b]);
+    if (F->weighted) h->SetBinError(b, sqrt(err * err + F->w2[b]));
+  }
+  for (int i = 0; i < 4; i++) stats[i] += F->stats[i];
+  h->PutStats(stats);
+  h->SetEntries(entries + F->entries);
+}
+
+/*******************************************************************************
+ * Running prefix sum of the drift times. cum[b] = Integral(0, b) of a
+ * histogram binned like dNdt and filled with the same drift times.
+*******************************************************************************/
+typedef struct RTBuilder {
+  const TH1* binning;       // Histogram giving the bins (not filled)
+  int nbins;                // Bins, without under/overflow
+  std::vector<double> cum;  // Prefix sum, bins 0 .. nbins + 1
+} RTBuilder;
+
+inline void initRT(RTBuilder* B, const TH1* dNdt) {
+  B->binning = dNdt;
+  B->nbins = dNdt->GetNbinsX();
+  B->cum.assign(B->nbins + 2, 0);
+}
+
+/*******************************************************************************
+ * Adds one drift time, O(bins)
+*******************************************************************************/
+inline void addDrift(RTBuilder* B, double t) {
+  for (int b = B->binning->FindFixBin(t); b <= B->nbins + 1; b++) B->cum[b]++;
+}
+
+/*******************************************************************************
+ * Adds all entries of a histogram binned like the builder's
+*******************************************************************************/
+inline void addDriftHist(RTBuilder* B, const TH1* dNdt) {
+  double sum = 0;
+  for (int b = 0; b <= B->nbins + 1; b++) {
+    sum += dNdt->GetBinContent(b);
+    B->cum[b] += sum;
+  }
+}
+
+/*******************************************************************************
+ * r at bin b of dN/dt, same as dNdt->Integral(0, b) for b >= 0
+*******************************************************************************/
+inline double rtAt(const RTBuilder* B, int b) {
+  return B->cum[b <= B->nbins + 1 ? b : B->nbins + 1];
+}
+
+/*******************************************************************************
+ * Sum of r-t curves over time steps 0 .. nSteps-1 filled into a histogram.
+ * Consecutive time steps with the same rt bin and dN/dt bin make one term.
+*******************************************************************************/
+typedef struct RTTerm {
+  int bin;       // Bin of the r-t histogram
+  int rBin;      // Bin of dN/dt r is read at
+  double n;      // Number of time steps
+  double sumT;   // Sum of the time steps
+  double sumT2;  // Sum of the squared time steps
+} RTTerm;
+
+typedef struct RTCurve {
+  std::vector<RTTerm> terms;
+  HistFills fills;
+} RTCurve;
+
+inline void initRTCurve(RTCurve* C, const TH1* rt, const RTBuilder* B,
+                        int nSteps) {
+  C->terms.clear();
+  initFills(&C->fills, rt);
+  for (int t = 0; t < nSteps; t++) {
+    int bin = rt->FindFixBin(t);
+    int rBin = t <= B->nbins + 1 ? t : B->nbins + 1;
+    if (C->terms.empty() || C->terms.back().bin != bin ||
+        C->terms.back().rBin != rBin) {
+      RTTerm term = {bin, rBin, 0, 0, 0};
+      C->terms.push_back(term);
+    }
+    RTTerm* term = &C->terms.back();
+    term->n++;
+    term->sumT += t;
+    term->sumT2 += (double)t * t;
+  }
+}
+
+/*******************************************************************************
+ * Adds the builder's current r-t curve, O(bins)
+*******************************************************************************/
+inline void addRT(RTCurve* C, const RTBuilder* B) {
+  for (size_t i = 0; i < C->terms.size(); i++) {
+    const RTTerm* term = &C->terms[i];
+    addFills(&C->fills, term->bin, term->n, B->cum[term->rBin], term->sumT,
+             term->sumT2);
+  }
+}
+
+#endif
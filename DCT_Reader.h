@@ -0,0 +1,209 @@
+/*
+ * DCT_READER.h
+ *
+ * Memory-mapped reader for the NI_PDCT text dumps. Each line of the file holds
+ * the NUMADCS comma-separated readings of one time step, and NUMTSTEPS lines
+ * make up one event. The file is mapped once and the integers are decoded in
+ * place, so there are no per-field stream calls or copies.
+ *
+ * Usage (from a macro):
+ *   DCTReader reader;
+ *   openReader(&reader, "NI_PDCT_17.txt");
+ *   while (readEvent(&reader, adc, adc_offsets)) { ... }
+ *   closeReader(&reader);
+ *
+ */
+
+#ifndef DCT_READER_H
+#define DCT_READER_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef NUMTSTEPS
+#define NUMTSTEPS 1000
+#endif
+#ifndef NUMADCS
+#define NUMADCS 32
+#endif
+
+/*******************************************************************************
+ * State of one mapped data file. 'cur' always sits at the start of a line.
+*******************************************************************************/
+typedef struct DCTReader {
+  int fd;             // File descriptor of the data file
+  size_t size;        // Size of the file in bytes
+  const char* data;   // Start of the mapping
+  const char* end;    // One past the last byte of the mapping
+  const char* cur;    // Current read position
+} DCTReader;
+
+/*******************************************************************************
+ * Maps a data file for reading. Returns false if it can't be opened.
+*******************************************************************************/
+inline bool openReader(DCTReader* r, const char* path) {
+  struct stat st;
+
+  r->fd = open(path, O_RDONLY);
+  r->size = 0;
+  r->data = r->end = r->cur = NULL;
+  if (r->fd < 0) return false;
+  if (fstat(r->fd, &st) < 0) {
+    close(r->fd);
+    r->fd = -1;
+    return false;
+  }
+  r->size = st.st_size;
+  if (r->size == 0) return true;  // Nothing to map, every read hits EOF
+
+  void* map = mmap(NULL, r->size, PROT_READ, MAP_PRIVATE, r->fd, 0);
+  if (map == MAP_FAILED) {
+    close(r->fd);
+    r->fd = -1;
+    return false;
+  }
+  madvise(map, r->size, MADV_SEQUENTIAL);  // Events are read front to back
+
+  r->data = (const char*)map;
+  r->end = r->data + r->size;
+  r->cur = r->data;
+  return true;
+}
+
+/*******************************************************************************
+ * Unmaps and closes the data file
+*******************************************************************************/
+inline void closeReader(DCTReader* r) {
+  if (r->data) munmap((void*)r->data, r->size);
+  if (r->fd >= 0) close(r->fd);
+  r->fd = -1;
+  r->data = r->end = r->cur = NULL;
+  r->size = 0;
+}
+
+/*******************************************************************************
+ * Tells the kernel the mapped bytes [from, to) won't be read again, so a long
+ * run doesn't keep the whole file resident. Only pages lying entirely inside
+ * the range are dropped; they would just be read back from the file.
+*******************************************************************************/
+inline void releaseRange(const char* from, const char* to) {
+  uintptr_t page = sysconf(_SC_PAGESIZE);
+  uintptr_t a = ((uintptr_t)from + page - 1) & ~(page - 1);
+  uintptr_t b = (uintptr_t)to & ~(page - 1);
+
+  if (b > a) madvise((void*)a, b - a, MADV_DONTNEED);
+}
+
+/*******************************************************************************
+ * Decodes one integer field starting at p and returns the position just past
+ * its delimiter (',' or '\n'). Anything between the digits and the delimiter
+ * (a '\r', a fractional part) is skipped, the same way atoi() ignores it.
+*******************************************************************************/
+inline const char* scanInt(const char* p, const char* end, int* val) {
+  int v = 0;
+  bool neg = false;
+
+  while (p < end && (*p == ' ' || *p == '\t')) p++;
+  if (p < end && (*p == '-' || *p == '+')) neg = (*p++ == '-');
+  while (p < end && (unsigned)(*p - '0') < 10) v = 10 * v + (*p++ - '0');
+  while (p < end && *p != ',' && *p != '\n') p++;
+
+  *val = neg ? -v : v;
+  return p < end ? p + 1 : end;
+}
+
+/*******************************************************************************
+ * True if the line starting at p ends with a line break before end. The last
+ * line of an event is checked with it, so a file cut off partway through that
+ * line isn't taken for a whole event.
+*******************************************************************************/
+inline bool lineComplete(const char* p, const char* end) {
+  return memchr(p, '\n', end - p) != NULL;
+}
+
+/*******************************************************************************
+ * Fills adc[iadc][t] with the next event, minus the per-ADC offset voltage.
+ * Returns false (leaving adc partially filled) if the file ends mid-event,
+ * including partway through the event's last line.
+*******************************************************************************/
+inline bool readEvent(DCTReader* r, int adc[NUMADCS][NUMTSTEPS],
+                      const int* offsets) {
+  const char* p = r->cur;
+  const char* end = r->end;
+
+  for (int t = 0; t < NUMTSTEPS; t++) {
+    if (p >= end || (t == NUMTSTEPS - 1 && !lineComplete(p, end)))
+      return false;
+    for (int iadc = 0; iadc < NUMADCS; iadc++) {
+      p = scanInt(p, end, &adc[iadc][t]);
+      adc[iadc][t] -= offsets[iadc];
+    }
+  }
+  r->cur = p;
+  return true;
+}
+
+/*******************************************************************************
+ * Same as readEvent, but keeps the file's time-major layout: tm[t][iadc].
+ * The kernels in DCT_SIMD.h take rows packed to the wire channels instead, see
+ * readEventChannels() in DCT_Channels.h.
+*******************************************************************************/
+inline bool readEventTM(DCTReader* r, int tm[NUMTSTEPS][NUMADCS],
+                        const int* offsets) {
+  const char* p = r->cur;
+  const char* end = r->end;
+
+  for (int t = 0; t < NUMTSTEPS; t++) {
+    if (p >= end || (t == NUMTSTEPS - 1 && !lineComplete(p, end)))
+      return false;
+    for (int iadc = 0; iadc < NUMADCS; iadc++) {
+      p = scanInt(p, end, &tm[t][iadc]);
+      tm[t][iadc] -= offsets[iadc];
+    }
+  }
+  r->cur = p;
+  return true;
+}
+
+/*******************************************************************************
+ * Skips n events without decoding them. Returns false (and leaves the reader at
+ * end of file) if the file runs out.
+*******************************************************************************/
+inline bool skipEvents(DCTReader* r, long n) {
+  const char* p = r->cur;
+
+  for (long i = 0; i < n * NUMTSTEPS; i++) {
+    if (p >= r->end) {
+      r->cur = r->end;
+      return false;
+    }
+    p = (const char*)memchr(p, '\n', r->end - p);
+    p = p ? p + 1 : r->end;
+  }
+  r->cur = p;
+  return true;
+}
+
+/*******************************************************************************
+ * Number of complete events between the read position and the end of file.
+ * Only looks for line breaks, nothing gets decoded. An unterminated last line
+ * doesn't count, as readEvent() doesn't take it.
+*******************************************************************************/
+inline long countEvents(const DCTReader* r) {
+  long lines = 0;
+  const char* p = r->cur;
+
+  while (p < r->end) {
+    p = (const char*)memchr(p, '\n', r->end - p);
+    if (!p) break;
+    lines++;
+    p++;
+  }
+  return lines / NUMTSTEPS;
+}
+
+#endif
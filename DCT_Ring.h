@@ -0,0 +1,122 @@
+/*
+ * DCT_RING.h
+ *
+ * Read-ahead queue between a reader thread and one analysis worker. The
+ * reader decodes events into a ring of nSlots preallocated event buffers and
+ * the worker takes them in order, so decoding the next events overlaps with
+ * finding the ROIs of this one. The queue is lock-free: 'head' is only
+ * written by the reader and 'tail' only by the worker. A full ring holds the
+ * reader back (memory stays at nSlots buffers however slow the worker is),
+ * an empty one holds the worker.
+ *
+ * Usage:
+ *   DCTRing Q;
+ *   initRing(&Q, 16, NUMTSTEPS * NUMCHANNELS);
+ *   reader thread:
+ *     while ((slot = ringReserve(&Q)) && decode(slot)) ringPush(&Q, bytes);
+ *     ringClose(&Q);
+ *   worker:
+ *     while ((slot = ringFront(&Q, &bytes))) { ...; ringPop(&Q); }
+ *
+ */
+
+#ifndef DCT_RING_H
+#define DCT_RING_H
+
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/*******************************************************************************
+ * The ring. Event n is in slot n % nSlots. head and tail sit on their own
+ * cache lines so the two threads don't write to the same one.
+*******************************************************************************/
+typedef struct DCTRing {
+  int nSlots;
+  size_t slotSize;                     // ints per slot
+  std::vector<int> data;               // nSlots * slotSize
+  std::vector<long> bytes;             // Input bytes of the event in a slot
+  alignas(64) std::atomic<long> head;  // Events pushed (reader only)
+  alignas(64) std::atomic<long> tail;  // Events popped (worker only)
+  std::atomic<bool> closed;            // The reader pushes no more events
+} DCTRing;
+
+inline void initRing(DCTRing* Q, int nSlots, size_t slotSize) {
+  Q->nSlots = nSlots < 1 ? 1 : nSlots;
+  Q->slotSize = slotSize;
+  Q->data.assign((size_t)Q->nSlots * slotSize, 0);
+  Q->bytes.assign(Q->nSlots, 0);
+  Q->head = 0;
+  Q->tail = 0;
+  Q->closed = false;
+}
+
+/*******************************************************************************
+ * Waits a little for the other side: yields first, then sleeps, so a side
+ * that waits long doesn't take a core from the one it waits for
+*******************************************************************************/
+inline void ringWait(int* spins) {
+  if (++*spins < 64)
+    std::this_thread::yield();
+  else
+    usleep(20);
+}
+
+/*******************************************************************************
+ * Reader: the slot of the next event, once the worker has freed it
+*******************************************************************************/
+inline int* ringReserve(DCTRing* Q) {
+  long head = Q->head.load(std::memory_order_relaxed);
+  int spins = 0;
+
+  while (head - Q->tail.load(std::memory_order_acquire) >= Q->nSlots)
+    ringWait(&spins);
+  return &Q->data[(size_t)(head % Q->nSlots) * Q->slotSize];
+}
+
+/*******************************************************************************
+ * Reader: hands the reserved slot, holding an event of 'bytes' input bytes,
+ * to the worker
+*******************************************************************************/
+inline void ringPush(DCTRing* Q, long bytes) {
+  long head = Q->head.load(std::memory_order_relaxed);
+  Q->bytes[head % Q->nSlots] = bytes;
+  Q->head.store(head + 1, std::memory_order_release);
+}
+
+/*******************************************************************************
+ * Reader: no more events
+*******************************************************************************/
+inline void ringClose(DCTRing* Q) {
+  Q->closed.store(true, std::memory_order_release);
+}
+
+/*******************************************************************************
+ * Worker: the slot of the next event, NULL once the reader closed the ring
+ * and every event was taken. The slot is the worker's until ringPop().
+*******************************************************************************/
+inline const int* ringFront(DCTRing* Q, long* bytes) {
+  long tail = Q->tail.load(std::memory_order_relaxed);
+  int spins = 0;
+
+  while (Q->head.load(std::memory_order_acquire) == tail) {
+    if (Q->closed.load(std::memory_order_acquire) &&
+        Q->head.load(std::memory_order_acquire) == tail)
+      return NULL;
+    ringWait(&spins);
+  }
+  if (bytes) *bytes = Q->bytes[tail % Q->nSlots];
+  return &Q->data[(size_t)(tail % Q->nSlots) * Q->slotSize];
+}
+
+/*******************************************************************************
+ * Worker: gives the slot of ringFront() back to the reader
+*******************************************************************************/
+inline void ringPop(DCTRing* Q) {
+  Q->tail.store(Q->tail.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+}
+
+#endif
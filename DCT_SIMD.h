@@ -0,0 +1,336 @@
+/*
+ * DCT_SIMD.h
+ *
+ * Channel-parallel ROI kernels on the time-major sample layout tm[t][c]
+ * (one file line per row, packed to the wire channels by readEventChannels(),
+ * see DCT_Channels.h). Each row is loaded once and all 16 ADCs / 8 wires
+ * are handled together: L+R sums, per-ADC min/argmin and max/argmax, wire-sum
+ * min/argmin, the safeMinimum/safeMaximum malfunction check and the ROI
+ * threshold crossings.
+ *
+ * Three versions with identical results: AVX-512, AVX2 and plain scalar. The
+ * best one the CPU supports is picked at run time, so nothing needs special
+ * compiler flags. The vector versions are x86 only (DCT_SIMD_X86);
+ * elsewhere the scalar one is all there is. A wire stops being updated at its
+ * first malfunctioning sample, exactly where findWireROI() gives up on it.
+ *
+ */
+
+#ifndef DCT_SIMD_H
+#define DCT_SIMD_H
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DCT_SIMD_X86 1  // The AVX2 and AVX-512 kernels are built
+#include <immintrin.h>
+#endif
+
+#include "DCT_ROI.h"
+
+#if NUMWIRES != 8
+#error "DCT_SIMD.h kernels handle exactly 8 wires (16 ADCs) per row"
+#endif
+
+/*******************************************************************************
+ * What the kernels find in one event. Times are bin numbers, -1 if never.
+*******************************************************************************/
+typedef struct EventStats {
+  int adcMin[2 * NUMWIRES];     // Per-ADC minimum and first bin it occurs
+  int adcMinloc[2 * NUMWIRES];
+  int adcMax[2 * NUMWIRES];     // Per-ADC maximum and first bin it occurs
+  int adcMaxloc[2 * NUMWIRES];
+  int sumMin[NUMWIRES];         // Wire-sum minimum and first bin it occurs
+  int sumMinloc[NUMWIRES];
+  int bad[NUMWIRES];            // First malfunctioning bin
+  int cross[NUMWIRES];          // First bin below threshold
+  int spike[NUMWIRES];          // First bin back above thresh/threshFrac
+  int wireSum[NUMTSTEPS][NUMWIRES];  // L + R, time-major
+} EventStats;
+
+typedef void (*EventKernel)(const int (*)[NUMCHANNELS], const ROIParams*,
+                            EventStats*);
+
+/*******************************************************************************
+ * Scalar reference version
+*******************************************************************************/
+inline void eventStatsScalar(const int (*tm)[NUMCHANNELS], const ROIParams* p,
+                             EventStats* s) {
+  for (int i = 0; i < 2 * NUMWIRES; i++) {
+    s->adcMin[i] = s->adcMax[i] = 10000;
+    s->adcMinloc[i] = s->adcMaxloc[i] = -1;
+  }
+  for (int w = 0; w < NUMWIRES; w++) {
+    s->sumMin[w] = 10000;
+    s->sumMinloc[w] = s->bad[w] = s->cross[w] = s->spike[w] = -1;
+  }
+
+  for (int t = 0; t < NUMTSTEPS; t++) {
+    const int* row = tm[t];
+    for (int w = 0; w < NUMWIRES; w++) {
+      int Ladc = 2 * w;
+      int Radc = 2 * w + 1;
+      int Lval = row[Ladc];
+      int Rval = row[Radc];
+      int val = Lval + Rval;
+      s->wireSum[t][w] = val;
+      if (s->bad[w] >= 0) continue;
+
+      /* Check for malfunction */
+      if (Lval < p->safeMinimum || Rval < p->safeMinimum ||
+          Lval > p->safeMaximum || Rval > p->safeMaximum) {
+        s->bad[w] = t;
+        continue;
+      }
+      if (Lval < s->adcMin[Ladc]) {
+        s->adcMin[Ladc] = Lval;
+        s->adcMinloc[Ladc] = t;
+      }
+      if (Lval > s->adcMax[Ladc]) {
+        s->adcMax[Ladc] = Lval;
+        s->adcMaxloc[Ladc] = t;
+      }
+      if (Rval < s->adcMin[Radc]) {
+        s->adcMin[Radc] = Rval;
+        s->adcMinloc[Radc] = t;
+      }
+      if (Rval > s->adcMax[Radc]) {
+        s->adcMax[Radc] = Rval;
+        s->adcMaxloc[Radc] = t;
+      }
+      if (val < s->sumMin[w]) {
+        s->sumMin[w] = val;
+        s->sumMinloc[w] = t;
+      }
+      /* Crossing first, then the end of the pulse on a later bin */
+      if (s->cross[w] < 0) {
+        if (val < p->thresh[w]) s->cross[w] = t;
+      } else if (s->cross[w] > p->min_eStart && s->spike[w] < 0 &&
+                 val > p->thresh[w] / p->threshFrac) {
+        s->spike[w] = t;
+      }
+    }
+  }
+}
+
+#ifdef DCT_SIMD_X86
+/*******************************************************************************
+ * AVX2: channels 0-7 and 8-15 in two registers, the 8 wires in one
+*******************************************************************************/
+__attribute__((target("avx2"))) inline void eventStatsAVX2(
+    const int (*tm)[NUMCHANNELS], const ROIParams* p, EventStats* s) {
+  const __m256i ones = _mm256_set1_epi32(-1);
+  const __m256i none = _mm256_set1_epi32(-1);
+  const __m256i safeMin = _mm256_set1_epi32(p->safeMinimum);
+  const __m256i safeMax = _mm256_set1_epi32(p->safeMaximum);
+  const __m256i minEStart = _mm256_set1_epi32(p->min_eStart);
+  const __m256i loPairs = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+  const __m256i hiPairs = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+  int over[NUMWIRES];
+  for (int w = 0; w < NUMWIRES; w++) over[w] = p->thresh[w] / p->threshFrac;
+  const __m256i thresh = _mm256_loadu_si256((const __m256i*)p->thresh);
+  const __m256i overThresh = _mm256_loadu_si256((const __m256i*)over);
+
+  __m256i min0 = _mm256_set1_epi32(10000), min1 = min0;
+  __m256i max0 = min0, max1 = min0, sumMin = min0;
+  __m256i minloc0 = none, minloc1 = none, maxloc0 = none, maxloc1 = none;
+  __m256i sumMinloc = none, bad = none, cross = none, spike = none;
+  __m256i live = ones;  // Wires that haven't malfunctioned yet
+
+  for (int t = 0; t < NUMTSTEPS; t++) {
+    const __m256i tv = _mm256_set1_epi32(t);
+    __m256i c0 = _mm256_loadu_si256((const __m256i*)tm[t]);
+    __m256i c1 = _mm256_loadu_si256((const __m256i*)(tm[t] + 8));
+
+    /* L + R: hadd pairs up neighbours, the permute undoes its lane order */
+    __m256i ws = _mm256_permute4x64_epi64(_mm256_hadd_epi32(c0, c1), 0xD8);
+    _mm256_storeu_si256((__m256i*)s->wireSum[t], ws);
+
+    /* Check for malfunction, a wire is bad if either of its ADCs is */
+    __m256i b0 = _mm256_or_si256(_mm256_cmpgt_epi32(safeMin, c0),
+                                 _mm256_cmpgt_epi32(c0, safeMax));
+    __m256i b1 = _mm256_or_si256(_mm256_cmpgt_epi32(safeMin, c1),
+                                 _mm256_cmpgt_epi32(c1, safeMax));
+    __m256i wb = _mm256_permute4x64_epi64(_mm256_hadd_epi32(b0, b1), 0xD8);
+    wb = _mm256_xor_si256(_mm256_cmpeq_epi32(wb, _mm256_setzero_si256()), ones);
+    bad = _mm256_blendv_epi8(bad, tv, _mm256_and_si256(wb, live));
+    live = _mm256_andnot_si256(wb, live);
+    __m256i live0 = _mm256_permutevar8x32_epi32(live, loPairs);
+    __m256i live1 = _mm256_permutevar8x32_epi32(live, hiPairs);
+
+    /* Per-ADC min + max */
+    __m256i m = _mm256_and_si256(_mm256_cmpgt_epi32(min0, c0), live0);
+    min0 = _mm256_blendv_epi8(min0, c0, m);
+    minloc0 = _mm256_blendv_epi8(minloc0, tv, m);
+    m = _mm256_and_si256(_mm256_cmpgt_epi32(min1, c1), live1);
+    min1 = _mm256_blendv_epi8(min1, c1, m);
+    minloc1 = _mm256_blendv_epi8(minloc1, tv, m);
+    m = _mm256_and_si256(_mm256_cmpgt_epi32(c0, max0), live0);
+    max0 = _mm256_blendv_epi8(max0, c0, m);
+    maxloc0 = _mm256_blendv_epi8(maxloc0, tv, m);
+    m = _mm256_and_si256(_mm256_cmpgt_epi32(c1, max1), live1);
+    max1 = _mm256_blendv_epi8(max1, c1, m);
+    maxloc1 = _mm256_blendv_epi8(maxloc1, tv, m);
+
+    /* Wire-sum min */
+    m = _mm256_and_si256(_mm256_cmpgt_epi32(sumMin, ws), live);
+    sumMin = _mm256_blendv_epi8(sumMin, ws, m);
+    sumMinloc = _mm256_blendv_epi8(sumMinloc, tv, m);
+
+    /* End of pulse (needs a crossing on an earlier bin), then the crossing */
+    m = _mm256_and_si256(_mm256_cmpgt_epi32(cross, minEStart),
+                         _mm256_cmpgt_epi32(cross, none));
+    m = _mm256_and_si256(m, _mm256_cmpeq_epi32(spike, none));
+    m = _mm256_and_si256(m, _mm256_cmpgt_epi32(ws, overThresh));
+    spike = _mm256_blendv_epi8(spike, tv, _mm256_and_si256(m, live));
+    m = _mm256_and_si256(_mm256_cmpeq_epi32(cross, none),
+                         _mm256_cmpgt_epi32(thresh, ws));
+    cross = _mm256_blendv_epi8(cross, tv, _mm256_and_si256(m, live));
+  }
+
+  _mm256_storeu_si256((__m256i*)s->adcMin, min0);
+  _mm256_storeu_si256((__m256i*)(s->adcMin + 8), min1);
+  _mm256_storeu_si256((__m256i*)s->adcMinloc, minloc0);
+  _mm256_storeu_si256((__m256i*)(s->adcMinloc + 8), minloc1);
+  _mm256_storeu_si256((__m256i*)s->adcMax, max0);
+  _mm256_storeu_si256((__m256i*)(s->adcMax + 8), max1);
+  _mm256_storeu_si256((__m256i*)s->adcMaxloc, maxloc0);
+  _mm256_storeu_si256((__m256i*)(s->adcMaxloc + 8), maxloc1);
+  _mm256_storeu_si256((__m256i*)s->sumMin, sumMin);
+  _mm256_storeu_si256((__m256i*)s->sumMinloc, sumMinloc);
+  _mm256_storeu_si256((__m256i*)s->bad, bad);
+  _mm256_storeu_si256((__m256i*)s->cross, cross);
+  _mm256_storeu_si256((__m256i*)s->spike, spike);
+}
+
+/*******************************************************************************
+ * AVX-512: all 16 channels in one register with mask compares, the 8 wires
+ * in a 256 bit register (AVX-512VL masks)
+*******************************************************************************/
+__attribute__((target("avx512f,avx512vl,avx2,bmi2"))) inline void
+eventStatsAVX512(const int (*tm)[NUMCHANNELS], const ROIParams* p,
+                 EventStats* s) {
+  const __m512i safeMin = _mm512_set1_epi32(p->safeMinimum);
+  const __m512i safeMax = _mm512_set1_epi32(p->safeMaximum);
+  const __m256i none = _mm256_set1_epi32(-1);
+  const __m256i minEStart = _mm256_set1_epi32(p->min_eStart);
+  int over[NUMWIRES];
+  for (int w = 0; w < NUMWIRES; w++) over[w] = p->thresh[w] / p->threshFrac;
+  const __m256i thresh = _mm256_loadu_si256((const __m256i*)p->thresh);
+  const __m256i overThresh = _mm256_loadu_si256((const __m256i*)over);
+
+  __m512i adcMin = _mm512_set1_epi32(10000), adcMax = adcMin;
+  __m512i adcMinloc = _mm512_set1_epi32(-1), adcMaxloc = adcMinloc;
+  __m256i sumMin = _mm256_set1_epi32(10000);
+  __m256i sumMinloc = none, bad = none, cross = none, spike = none;
+  __mmask8 live = 0xFF;  // Wires that haven't malfunctioned yet
+
+  for (int t = 0; t < NUMTSTEPS; t++) {
+    const __m512i tv = _mm512_set1_epi32(t);
+    const __m256i tv8 = _mm256_set1_epi32(t);
+    __m512i c = _mm512_loadu_si512((const void*)tm[t]);
+    __m256i c0 = _mm256_loadu_si256((const __m256i*)tm[t]);
+    __m256i c1 = _mm256_loadu_si256((const __m256i*)(tm[t] + 8));
+
+    /* L + R: hadd pairs up neighbours, the permute undoes its lane order */
+    __m256i ws = _mm256_permute4x64_epi64(_mm256_hadd_epi32(c0, c1), 0xD8);
+    _mm256_storeu_si256((__m256i*)s->wireSum[t], ws);
+
+    /* Check for malfunction, a wire is bad if either of its ADCs is */
+    unsigned cb = _mm512_cmplt_epi32_mask(c, safeMin) |
+                  _mm512_cmpgt_epi32_mask(c, safeMax);
+    __mmask8 wb = (__mmask8)_pext_u32(cb | (cb >> 1), 0x5555);
+    bad = _mm256_mask_blend_epi32(wb & live, bad, tv8);
+    live &= ~wb;
+    unsigned pairs = _pdep_u32(live, 0x5555);
+    __mmask16 clive = (__mmask16)(pairs | (pairs << 1));
+
+    /* Per-ADC min + max */
+    __mmask16 k = _mm512_mask_cmplt_epi32_mask(clive, c, adcMin);
+    adcMin = _mm512_mask_blend_epi32(k, adcMin, c);
+    adcMinloc = _mm512_mask_blend_epi32(k, adcMinloc, tv);
+    k = _mm512_mask_cmpgt_epi32_mask(clive, c, adcMax);
+    adcMax = _mm512_mask_blend_epi32(k, adcMax, c);
+    adcMaxloc = _mm512_mask_blend_epi32(k, adcMaxloc, tv);
+
+    /* Wire-sum min */
+    __mmask8 m = _mm256_mask_cmplt_epi32_mask(live, ws, sumMin);
+    sumMin = _mm256_mask_blend_epi32(m, sumMin, ws);
+    sumMinloc = _mm256_mask_blend_epi32(m, sumMinloc, tv8);
+
+    /* End of pulse (needs a crossing on an earlier bin), then the crossing */
+    m = _mm256_mask_cmpgt_epi32_mask(live, cross, minEStart);
+    m = _mm256_mask_cmpgt_epi32_mask(m, cross, none);
+    m = _mm256_mask_cmpeq_epi32_mask(m, spike, none);
+    m = _mm256_mask_cmpgt_epi32_mask(m, ws, overThresh);
+    spike = _mm256_mask_blend_epi32(m, spike, tv8);
+    m = _mm256_mask_cmpeq_epi32_mask(live, cross, none);
+    m = _mm256_mask_cmplt_epi32_mask(m, ws, thresh);
+    cross = _mm256_mask_blend_epi32(m, cross, tv8);
+  }
+
+  _mm512_storeu_si512((void*)s->adcMin, adcMin);
+  _mm512_storeu_si512((void*)s->adcMinloc, adcMinloc);
+  _mm512_storeu_si512((void*)s->adcMax, adcMax);
+  _mm512_storeu_si512((void*)s->adcMaxloc, adcMaxloc);
+  _mm256_storeu_si256((__m256i*)s->sumMin, sumMin);
+  _mm256_storeu_si256((__m256i*)s->sumMinloc, sumMinloc);
+  _mm256_storeu_si256((__m256i*)s->bad, bad);
+  _mm256_storeu_si256((__m256i*)s->cross, cross);
+  _mm256_storeu_si256((__m256i*)s->spike, spike);
+}
+#endif  // DCT_SIMD_X86
+
+/*******************************************************************************
+ * Best kernel for this CPU
+*******************************************************************************/
+inline EventKernel selectEventKernel() {
+#ifdef DCT_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+      __builtin_cpu_supports("bmi2"))
+    return eventStatsAVX512;
+  if (__builtin_cpu_supports("avx2")) return eventStatsAVX2;
+#endif
+  return eventStatsScalar;
+}
+
+/*******************************************************************************
+ * Runs a kernel over one time-major event and fills the same extrema, ROIs
+ * and waveGood flags findWireROI() gives for each wire. The wire sums stay in
+ * the kernel's scratch space s.
+*******************************************************************************/
+inline void findEventROIs(EventKernel kernel, const int (*tm)[NUMCHANNELS],
+                          const ROIParams* p, EventStats* s, Extrema* ROI_adc,
+                          ROI* ROI_sum, bool* waveGood) {
+  kernel(tm, p, s);
+
+  for (int i = 0; i < 2 * NUMWIRES; i++) {
+    ROI_adc[i].minval = s->adcMin[i];
+    ROI_adc[i].minloc = s->adcMinloc[i];
+    ROI_adc[i].maxval = s->adcMax[i];
+    ROI_adc[i].maxloc = s->adcMaxloc[i];
+  }
+
+  for (int w = 0; w < NUMWIRES; w++) {
+    ROI* sum = &ROI_sum[w];
+    INIT_ROI(ROI_sum[w]);
+    sum->minval = s->sumMin[w];
+    sum->minloc = s->sumMinloc[w];
+    sum->badloc = s->bad[w];
+
+    if (s->cross[w] >= 0) {
+      sum->t_eStart = s->cross[w] < p->min_eStart ? 0
+                                                  : s->cross[w] - p->min_eStart;
+      sum->t_eEnd = sum->t_eStart + ROISIZE;
+    }
+    if (s->spike[w] >= 0) {
+      sum->spikeOver = true;
+      sum->t_eEnd = s->spike[w];
+      for (int t = sum->t_eStart; t < sum->t_eEnd; t++)
+        sum->integral += s->wireSum[t][w];
+      sum->dn_dt = s->wireSum[sum->t_eStart][w] - s->wireSum[sum->t_eEnd][w];
+    }
+    waveGood[w] = s->bad[w] < 0 && sum->t_eStart >= 0;
+  }
+}
+
+#endif
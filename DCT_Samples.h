@@ -0,0 +1,226 @@
+/*
+ * DCT_SAMPLES.h
+ *
+ * In-memory sample store for scanning cuts. A run (text or .dctb) is decoded
+ * once into the wire sums (left + right ADC) of every event, as int16, and
+ * whether each wave malfunctioned. Only the thresholds, threshFrac,
+ * min_eStart and ROISIZE are left to vary; the ROI of a wave for any of them
+ * is then found by findSumROI() from the stored sum alone, without reading
+ * or decoding the file again.
+ *
+ * The malfunction check only looks at the safe min/max, so it is done once
+ * here with the cuts the store is loaded with. The samples of a wave that
+ * malfunctioned are not kept (left 0).
+ *
+ * 16 KB per event: a 100k event run takes 1.6 GB, use maxEvents to scan on
+ * part of it.
+ *
+ * Usage:
+ *   DCTSamples S;
+ *   loadSamples(&S, "NI_PDCT_17.txt", &cuts, -1, nThreads);
+ *   if (!sampleBad(&S, event, w))
+ *     good = findSumROI(sampleWave(&S, event, w), w, &cuts, ROISIZE, &sum);
+ *
+ */
+
+#ifndef DCT_SAMPLES_H
+#define DCT_SAMPLES_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "DCT_Binary.h"
+#include "DCT_Channels.h"
+#include "DCT_Cuts.h"
+#include "DCT_Parallel.h"
+#include "DCT_Reader.h"
+#include "DCT_ROI.h"
+#include "DCT_Stream.h"
+
+/*******************************************************************************
+ * The decoded run. Wave w of event i is sum[(i * NUMWIRES + w) * NUMTSTEPS].
+*******************************************************************************/
+typedef struct DCTSamples {
+  long nEvents;
+  int safeMinimum;            // Cuts the malfunction check was made with
+  int safeMaximum;
+  std::vector<int16_t> sum;   // Wire sums, NUMTSTEPS per wave
+  std::vector<uint8_t> bad;   // Wave malfunctioned, one per wave
+} DCTSamples;
+
+inline const int16_t* sampleWave(const DCTSamples* S, long event, int w) {
+  return &S->sum[((size_t)event * NUMWIRES + w) * NUMTSTEPS];
+}
+
+inline bool sampleBad(const DCTSamples* S, long event, int w) {
+  return S->bad[(size_t)event * NUMWIRES + w];
+}
+
+/*******************************************************************************
+ * Stores one event. Sample t of ADC iadc is samples[iadc * adcStride + t *
+ * tStride].
+*******************************************************************************/
+template <typename T>
+void storeSampleEvent(DCTSamples* S, long event, const T* samples,
+                      int adcStride, int tStride) {
+  for (int w = 0; w < NUMWIRES; w++) {
+    const T* L = samples + 2 * w * adcStride;
+    const T* R = samples + (2 * w + 1) * adcStride;
+    int16_t* wave = &S->sum[((size_t)event * NUMWIRES + w) * NUMTSTEPS];
+    bool bad = false;
+
+    for (int t = 0; t < NUMTSTEPS && !bad; t++) {
+      int Lval = L[t * tStride];
+      int Rval = R[t * tStride];
+      bad = Lval < S->safeMinimum || Rval < S->safeMinimum ||
+            Lval > S->safeMaximum || Rval > S->safeMaximum;
+      wave[t] = (int16_t)(Lval + Rval);
+    }
+    if (bad)
+      for (int t = 0; t < NUMTSTEPS; t++) wave[t] = 0;
+    S->bad[(size_t)event * NUMWIRES + w] = bad;
+  }
+}
+
+/*******************************************************************************
+ * Decodes infile (text, .dctb, or text compressed as .gz/.zst), up to
+ * maxEvents events (-1 for all), with nThreads workers. A compressed file is
+ * decompressed by the threads and decoded by one. Only
+ * cuts->safeMinimum/safeMaximum are used. The run ends at the first event
+ * that doesn't decode (cut off partway). Returns false if infile can't be
+ * opened or is corrupt, or if the sum of two samples in the safe range
+ * doesn't fit an int16.
+*******************************************************************************/
+inline bool loadSamples(DCTSamples* S, const char* infile,
+                        const ROIParams* cuts, long maxEvents, int nThreads) {
+  S->nEvents = 0;
+  S->safeMinimum = cuts->safeMinimum;
+  S->safeMaximum = cuts->safeMaximum;
+  S->sum.clear();
+  S->bad.clear();
+  if (2 * cuts->safeMinimum < INT16_MIN || 2 * cuts->safeMaximum > INT16_MAX)
+    return false;
+
+  DCTChannelMap map;
+  initChannelMap(&map);
+  if (isCompressed(infile)) {
+    DCTStream stream;
+    DCTReader view;
+    std::vector<int> tm(NUMTSTEPS * NUMCHANNELS);
+    bool ok = openStream(&stream, infile, nThreads);
+    while (ok && (maxEvents < 0 || S->nEvents < maxEvents) &&
+           nextStreamEvent(&stream, &view) &&
+           readEventChannels(&view, (int(*)[NUMCHANNELS]) & tm[0], &map,
+                             adc_offsets)) {
+      S->sum.resize((size_t)(S->nEvents + 1) * NUMWIRES * NUMTSTEPS);
+      S->bad.resize((size_t)(S->nEvents + 1) * NUMWIRES);
+      storeSampleEvent(S, S->nEvents++, &tm[0], 1, NUMCHANNELS);
+    }
+    ok = ok && !streamError(&stream);
+    closeStream(&stream);
+    return ok;
+  }
+
+  bool binary = isDCTB(infile);
+  DCTReader reader = {};
+  DCTBReader bReader = {};
+  if (binary ? !openDCTB(&bReader, infile) : !openReader(&reader, infile))
+    return false;
+
+  DCTIndex index;
+  if (!binary) openIndex(&index, &reader, infile);
+  long nEvents = binary ? bReader.header.numEvents : index.header.numEvents;
+  if (maxEvents >= 0 && nEvents > maxEvents) nEvents = maxEvents;
+  if (nThreads < 1) nThreads = 1;
+  S->nEvents = nEvents;
+  S->sum.resize((size_t)nEvents * NUMWIRES * NUMTSTEPS);
+  S->bad.resize((size_t)nEvents * NUMWIRES);
+
+  /* Every worker decodes its own chunk straight into the store. The run ends
+   * at the first event that doesn't decode */
+  std::vector<DCTReader> views(nThreads, reader);
+  std::vector<long> decoded(nThreads);
+  if (!binary) chunkReaders(&reader, &index, 0, nEvents, nThreads, &views[0]);
+  runWorkers(nThreads, [&](int k) {
+    std::vector<int> tm(binary ? 0 : NUMTSTEPS * NUMCHANNELS);
+    long first, last;
+    chunkRange(nEvents, nThreads, k, &first, &last);
+    long event;
+    for (event = first; event < last; event++) {
+      if (binary) {
+        storeSampleEvent(S, event, dctbEvent(&bReader, event), NUMTSTEPS, 1);
+      } else {
+        if (!readEventChannels(&views[k], (int(*)[NUMCHANNELS]) & tm[0], &map,
+                               adc_offsets))
+          break;
+        storeSampleEvent(S, event, &tm[0], 1, NUMCHANNELS);
+      }
+    }
+    decoded[k] = event;
+  });
+  for (int k = 0; k < nThreads; k++) {
+    long first, last;
+    chunkRange(nEvents, nThreads, k, &first, &last);
+    if (decoded[k] < last) {
+      S->nEvents = decoded[k];
+      S->sum.resize((size_t)S->nEvents * NUMWIRES * NUMTSTEPS);
+      S->bad.resize((size_t)S->nEvents * NUMWIRES);
+      break;
+    }
+  }
+
+  if (binary)
+    closeDCTB(&bReader);
+  else
+    closeReader(&reader);
+  return true;
+}
+
+/*******************************************************************************
+ * ROI of a wave that didn't malfunction, the same as findWireROI() finds with
+ * cuts p and ROISIZE roiSize, from a window of its wire sum: wave[i] is
+ * sample first + i, for n samples. The window must hold the wave from before
+ * its threshold crossing to where the ROI closes (or ends). Only t_eStart,
+ * t_eEnd, integral, dn_dt and spikeOver are set; sum must be INIT_ROI'd by
+ * the caller. Stops as soon as the ROI is known. Returns false if the window
+ * never crosses threshold.
+*******************************************************************************/
+inline bool findWindowROI(const int16_t* wave, int first, int n, int w,
+                          const ROIParams* p, int roiSize, ROI* sum) {
+  const int thresh = p->thresh[w];
+  const int overThresh = thresh / p->threshFrac;
+  int i = 0;
+
+  while (i < n && wave[i] >= thresh) i++;
+  if (i == n) return false;
+
+  int t = first + i;
+  sum->t_eStart = t < p->min_eStart ? 0 : t - p->min_eStart;
+  sum->t_eEnd = sum->t_eStart + roiSize;
+  if (sum->t_eStart == 0) return true;  // Never closed, as in findWireROI()
+
+  int integral = 0;
+  for (int j = sum->t_eStart - first; j <= i; j++) integral += wave[j];
+  for (i++; i < n; i++) {
+    if (wave[i] > overThresh) {
+      sum->spikeOver = true;
+      sum->t_eEnd = first + i;
+      sum->integral = integral;
+      sum->dn_dt = wave[sum->t_eStart - first] - wave[i];
+      return true;
+    }
+    integral += wave[i];
+  }
+  return true;
+}
+
+/*******************************************************************************
+ * Same for a whole stored wave
+*******************************************************************************/
+inline bool findSumROI(const int16_t* wave, int w, const ROIParams* p,
+                       int roiSize, ROI* sum) {
+  return findWindowROI(wave, 0, NUMTSTEPS, w, p, roiSize, sum);
+}
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ * DCT_SHARD.cxx
+ *
+ * Sharded runs and the merge of their partial results (see DCT_Shard.h).
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "TFile.h"
+#include "TParameter.h"
+
+#include "DCT_Parallel.h"
+#include "DCT_Shard.h"
+
+/*******************************************************************************
+ * Setup
+*******************************************************************************/
+bool parseShard(const char* s, int* shard, int* nShards) {
+  char* end;
+  long k = strtol(s, &end, 10);
+  if (end == s || *end != '/') return false;
+  const char* n = end + 1;
+  long N = strtol(n, &end, 10);
+  if (end == n || *end || N < 1 || N > 1000000 || k < 0 || k >= N)
+    return false;
+  *shard = k;
+  *nShards = N;
+  return true;
+}
+
+/*******************************************************************************
+ * Shard info, as TParameters
+*******************************************************************************/
+void writeShardInfo(TDirectory* dir, int shard, int nShards, long total,
+                    long first, long nEvents) {
+  TDirectory::TContext context;  // Puts gDirectory back afterwards
+
+  dir->cd();
+  TParameter<Long64_t>("shard", shard).Write();
+  TParameter<Long64_t>("nShards", nShards).Write();
+  TParameter<Long64_t>("total", total).Write();
+  TParameter<Long64_t>("first", first).Write();
+  TParameter<Long64_t>("nEvents", nEvents).Write();
+}
+
+static bool readShardParam(TFile* f, const char* name, long* val) {
+  TParameter<Long64_t>* par = NULL;
+  f->GetObject(name, par);
+  if (!par) return false;
+  *val = par->GetVal();
+  delete par;
+  return true;
+}
+
+/*******************************************************************************
+ * Shard: the pipeline saves to the partial file instead of ending the passes
+*******************************************************************************/
+long runShard(DCTPipeline* P, const char* infile, int nThreads, int shard,
+              int nShards, const char* partfile) {
+  char tmpfile[4096];
+  snprintf(tmpfile, sizeof tmpfile, "%s.tmp", partfile);
+
+  TFile out(tmpfile, "RECREATE");
+  if (out.IsZombie()) {
+    fprintf(stderr, "Can't write %s\n", tmpfile);
+    return -1;
+  }
+  P->shard = shard;
+  P->nShards = nShards;
+  P->partial = &out;
+  long nEvents = runPipeline(P, infile, nThreads);
+  P->partial = NULL;
+  out.Close();
+
+  if (nEvents < 0) {
+    remove(tmpfile);
+    return -1;
+  }
+  if (rename(tmpfile, partfile) != 0) {
+    fprintf(stderr, "Can't write %s\n", partfile);
+    return -1;
+  }
+  printf("Shard %d/%d of %s -> %s\n", shard, nShards, infile, partfile);
+  return nEvents;
+}
+
+/*******************************************************************************
+ * One partial result to merge
+*******************************************************************************/
+typedef struct ShardPart {
+  const char* file;
+  TFile* f;
+  long shard, nShards, total, first, nEvents;
+} ShardPart;
+
+static bool openPart(ShardPart* S, const char* file) {
+  S->file = file;
+  S->f = TFile::Open(file);
+  if (S->f && !S->f->IsZombie() &&
+      readShardParam(S->f, "shard", &S->shard) &&
+      readShardParam(S->f, "nShards", &S->nShards) &&
+      readShardParam(S->f, "total", &S->total) &&
+      readShardParam(S->f, "first", &S->first) &&
+      readShardParam(S->f, "nEvents", &S->nEvents))
+    return true;
+  printf("%s isn't a partial result\n", file);
+  return false;
+}
+
+static bool byShard(const ShardPart& a, const ShardPart& b) {
+  return a.shard < b.shard;
+}
+
+/*******************************************************************************
+ * The parts have to be every shard of one run once, and have the results of
+ * every pass
+*******************************************************************************/
+static bool checkParts(const DCTPipeline* P, std::vector<ShardPart>* parts) {
+  std::vector<ShardPart>& S = *parts;
+  int n = S.size();
+
+  std::sort(S.begin(), S.end(), byShard);
+  for (int i = 0; i < n; i++) {
+    long first, last;
+    if (S[i].nShards != n) {
+      printf("%s is one of %ld shards, %d given\n", S[i].file, S[i].nShards,
+             n);
+      return false;
+    }
+    if (i > 0 && S[i].shard == S[i - 1].shard) {
+      printf("%s and %s are both shard %ld\n", S[i - 1].file, S[i].file,
+             S[i].shard);
+      return false;
+    }
+    if (S[i].total != S[0].total) {
+      printf("%s and %s are shards of different runs (%ld and %ld events)\n",
+             S[0].file, S[i].file, S[0].total, S[i].total);
+      return false;
+    }
+    chunkRange(S[i].total, n, i, &first, &last);
+    if (S[i].first != first || S[i].nEvents > last - first) {
+      printf("%s doesn't have the events of shard %d/%d\n", S[i].file, i, n);
+      return false;
+    }
+  }
+
+  for (size_t p = 0; p < P->passes.size(); p++) {
+    const DCTPass* pass = &P->passes[p];
+    if (!pass->load) {
+      printf("%s can't be merged\n", pass->name);
+      return false;
+    }
+    for (int i = 0; i < n; i++) {
+      if (!S[i].f->GetDirectory(pass->name)) {
+        printf("No %s results in %s\n", pass->name, S[i].file);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/*******************************************************************************
+ * Merge: shard k is worker k of the passes
+*******************************************************************************/
+long mergeShards(DCTPipeline* P, const char* const* partfiles, int n) {
+  TDirectory::TContext context;
+  std::vector<ShardPart> S(n > 0 ? n : 0);
+  bool ok = n > 0;
+
+  if (!ok) printf("No partial results to merge\n");
+  for (int i = 0; i < n; i++) ok = openPart(&S[i], partfiles[i]) && ok;
+  if (ok) ok = checkParts(P, &S);
+  if (!ok) {
+    for (int i = 0; i < n; i++) delete S[i].f;
+    return -1;
+  }
+
+  /* A pass whose results can't be loaded still ends, to free it */
+  long nEvents = 0;
+  for (int i = 0; i < n; i++) nEvents += S[i].nEvents;
+  for (size_t p = 0; p < P->passes.size(); p++) {
+    DCTPass* pass = &P->passes[p];
+    pass->begin(pass->data, n, S[0].total);
+    for (int i = 0; i < n; i++)
+      ok = pass->load(pass->data, i, S[i].f->GetDirectory(pass->name)) && ok;
+    pass->end(pass->data, n, nEvents);
+  }
+  for (int i = 0; i < n; i++) delete S[i].f;
+
+  if (!ok) return -1;
+  printf("Merged %ld events of %d shards\n", nEvents, n);
+  return nEvents;
+}
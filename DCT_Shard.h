@@ -0,0 +1,67 @@
+/*
+ * DCT_SHARD.h
+ *
+ * Sharded runs: one run split by event number over several processes, on one
+ * machine or many. Shard k of N reads only events [k * n / N, (k + 1) * n / N)
+ * of the run's n (see chunkRange()) and saves the partial results of its
+ * passes to a file of its own instead of ending them: the merged histograms
+ * and whatever else 'end' finishes from (DataTest7's running stats,
+ * DataTest9's per-event rows). mergeShards() loads the partial results of all
+ * shards as the workers of one run and ends the passes, so the histograms come
+ * out exactly as a single process reading the whole run makes them.
+ *
+ * The shards don't talk to each other: each counts the run's events itself,
+ * so any machines that see the same file will do, and processes on one
+ * machine stand in for them. Compressed dumps can't be sharded (see
+ * DCT_Stream.h), nor can the hit records (see DCT_Hits.h).
+ *
+ * Usage:
+ *   DCTPipeline P;                                     // Shard k of 4
+ *   addDataTest7Pass(&P, &H7);
+ *   runShard(&P, "NI_PDCT_17.txt", 8, k, 4, "NI_PDCT_17_k.root");
+ *
+ *   DCTPipeline M;                                     // Once all are done
+ *   addDataTest7Pass(&M, &H7);
+ *   mergeShards(&M, partfiles, 4);
+ *
+ */
+
+#ifndef DCT_SHARD_H
+#define DCT_SHARD_H
+
+#include "TDirectory.h"
+
+#include "DCT_Pipeline.h"
+
+/*******************************************************************************
+ * Reads "k/N", shard k (0 to N - 1) of N. Returns false if s isn't one.
+*******************************************************************************/
+bool parseShard(const char* s, int* shard, int* nShards);
+
+/*******************************************************************************
+ * Runs shard 'shard' of nShards of infile through the passes of P, on
+ * nThreads threads, and saves their partial results to partfile. Written to
+ * a temporary file first and renamed, so partfile is always complete.
+ * Returns the number of events read, -1 (with a message) if infile can't be
+ * sharded or partfile can't be written.
+*******************************************************************************/
+long runShard(DCTPipeline* P, const char* infile, int nThreads, int shard,
+              int nShards, const char* partfile);
+
+/*******************************************************************************
+ * Ends the passes of P from the partial results of all shards of a run, in
+ * any order, and prints what was merged. Returns the number of events of the
+ * run, -1 (with a message) if the files aren't every shard of one run once,
+ * or miss the results of a pass.
+*******************************************************************************/
+long mergeShards(DCTPipeline* P, const char* const* partfiles, int n);
+
+/*******************************************************************************
+ * Which part of the run a partial result is: shard, of nShards, of a run of
+ * total events; nEvents read from event first on. Written by the pipeline,
+ * as TParameters in the top directory.
+*******************************************************************************/
+void writeShardInfo(TDirectory* dir, int shard, int nShards, long total,
+                    long first, long nEvents);
+
+#endif
@@ -0,0 +1,76 @@
+/*
+ * DCT_STATS.h
+ *
+ * Running statistics that are updated one value at a time, so a run of any
+ * length can be summarized without keeping its per-event results around.
+ * All sums are integer, so stats of separate chunks add up exactly and the
+ * summary doesn't depend on how the run was split across threads.
+ *
+ */
+
+#ifndef DCT_STATS_H
+#define DCT_STATS_H
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+
+#define INIT_STATS(X) \
+  X = {.n = 0, .sum = 0, .sum2 = 0, .min = INT_MAX, .max = INT_MIN}
+
+/*******************************************************************************
+ * Count, sum, sum of squares and range of the values seen so far
+*******************************************************************************/
+typedef struct RunningStats {
+  long n;          // Number of values
+  long long sum;   // Sum of values
+  long long sum2;  // Sum of squared values
+  int min;         // Smallest value
+  int max;         // Largest value
+} RunningStats;
+
+/*******************************************************************************
+ * Adds one value
+*******************************************************************************/
+inline void addStat(RunningStats* s, int x) {
+  s->n++;
+  s->sum += x;
+  s->sum2 += (long long)x * x;
+  if (x < s->min) s->min = x;
+  if (x > s->max) s->max = x;
+}
+
+/*******************************************************************************
+ * Adds all values of b to a
+*******************************************************************************/
+inline void mergeStats(RunningStats* a, const RunningStats* b) {
+  a->n += b->n;
+  a->sum += b->sum;
+  a->sum2 += b->sum2;
+  if (b->min < a->min) a->min = b->min;
+  if (b->max > a->max) a->max = b->max;
+}
+
+inline double statMean(const RunningStats* s) {
+  return s->n ? (double)s->sum / s->n : 0;
+}
+
+inline double statRMS(const RunningStats* s) {
+  if (!s->n) return 0;
+  double mean = statMean(s);
+  double var = (double)s->sum2 / s->n - mean * mean;
+  return var > 0 ? sqrt(var) : 0;
+}
+
+/*******************************************************************************
+ * Prints one line: label, count, mean, rms, min, max
+*******************************************************************************/
+inline void printStats(const char* label, const RunningStats* s) {
+  if (s->n)
+    printf("%-24s %10ld %10.2f %10.2f %8d %8d\n", label, s->n, statMean(s),
+           statRMS(s), s->min, s->max);
+  else
+    printf("%-24s %10ld %10s %10s %8s %8s\n", label, 0L, "-", "-", "-", "-");
+}
+
+#endif
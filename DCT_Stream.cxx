@@ -0,0 +1,357 @@
+/*
+ * DCT_STREAM.cxx
+ *
+ * Compressed text dumps (see DCT_Stream.h).
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <functional>
+#include <vector>
+
+#ifdef DCT_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef DCT_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define NUMTSTEPS 1000
+
+#include "DCT_Stream.h"
+
+/*******************************************************************************
+ * Takes decompressed text as it comes out. Returns false to stop.
+*******************************************************************************/
+typedef std::function<bool(const char*, size_t)> StreamSink;
+
+#ifdef DCT_HAVE_ZLIB
+/*******************************************************************************
+ * Inflates n bytes of one or more gzip members. Returns false if they are
+ * corrupt or cut short.
+*******************************************************************************/
+static bool inflateRange(const char* in, size_t n, const StreamSink& sink) {
+  z_stream z;
+  std::vector<char> out(1 << 18);
+  size_t left = n;
+  bool ok = true;
+
+  memset(&z, 0, sizeof z);
+  if (inflateInit2(&z, 15 + 32) != Z_OK) return false;  // gzip or zlib header
+  z.next_in = (Bytef*)in;
+  for (;;) {
+    if (z.avail_in == 0 && left) {  // avail_in is 32 bit
+      z.avail_in = left < (1u << 30) ? left : (1u << 30);
+      left -= z.avail_in;
+    }
+    z.next_out = (Bytef*)&out[0];
+    z.avail_out = out.size();
+    int ret = inflate(&z, Z_NO_FLUSH);
+    size_t got = out.size() - z.avail_out;
+    if (got && !sink(&out[0], got)) break;
+    if (ret == Z_STREAM_END) {
+      if (z.avail_in == 0 && left == 0) break;
+      inflateReset(&z);  // Next member
+    } else if ((ret != Z_OK && ret != Z_BUF_ERROR) ||
+               (got == 0 && z.avail_in == 0 && !left)) {
+      ok = false;  // Corrupt, or the input ended mid-member
+      break;
+    }
+  }
+  inflateEnd(&z);
+  return ok;
+}
+#endif
+
+#ifdef DCT_HAVE_ZSTD
+/*******************************************************************************
+ * Same for one or more zstd frames
+*******************************************************************************/
+static bool zstdRange(const char* in, size_t n, const StreamSink& sink) {
+  ZSTD_DStream* d = ZSTD_createDStream();
+  std::vector<char> out(ZSTD_DStreamOutSize());
+  ZSTD_inBuffer ib = {in, n, 0};
+  size_t ret = 0;
+
+  if (!d) return false;
+  ZSTD_initDStream(d);
+  for (;;) {
+    ZSTD_outBuffer ob = {&out[0], out.size(), 0};
+    ret = ZSTD_decompressStream(d, &ob, &ib);
+    if (ZSTD_isError(ret)) break;
+    if (ob.pos && !sink(&out[0], ob.pos)) {
+      ret = 0;
+      break;
+    }
+    if (ib.pos == ib.size && ob.pos < ob.size) break;  // All out
+  }
+  ZSTD_freeDStream(d);
+  return ret == 0;  // Not an error, and the last frame is complete
+}
+#endif
+
+/*******************************************************************************
+ * Decompresses bytes [from, to) of the file
+*******************************************************************************/
+static bool decompress(const DCTStream* S, size_t from, size_t to,
+                       const StreamSink& sink) {
+#ifdef DCT_HAVE_ZLIB
+  if (S->format == STREAM_GZIP)
+    return inflateRange(S->file.data + from, to - from, sink);
+#endif
+#ifdef DCT_HAVE_ZSTD
+  if (S->format == STREAM_ZSTD)
+    return zstdRange(S->file.data + from, to - from, sink);
+#endif
+  return false;
+}
+
+/*******************************************************************************
+ * Size of the BGZF block at p (the BC extra field of bgzip), 0 if p isn't
+ * one
+*******************************************************************************/
+static size_t bgzfBlockSize(const unsigned char* p, size_t n) {
+  if (n < 18 || p[0] != 0x1f || p[1] != 0x8b || p[2] != 8 || !(p[3] & 4))
+    return 0;
+  size_t xlen = p[10] | p[11] << 8;
+  for (size_t i = 12; i + 4 <= 12 + xlen && i + 4 <= n;
+       i += 4 + (p[i + 2] | p[i + 3] << 8)) {
+    if (p[i] == 'B' && p[i + 1] == 'C' && (p[i + 2] | p[i + 3] << 8) == 2 &&
+        i + 6 <= n)
+      return (p[i + 4] | p[i + 5] << 8) + 1;
+  }
+  return 0;
+}
+
+/*******************************************************************************
+ * Splits the file into tasks of whole frames/blocks, about STREAM_TASKSIZE
+ * bytes each. One task for the whole file if it has no independent parts.
+*******************************************************************************/
+static void findTasks(DCTStream* S) {
+  const char* data = S->file.data;
+  size_t size = S->file.size;
+  size_t pos = 0;
+
+  S->taskStart.assign(1, 0);
+  while (pos < size) {
+    size_t part = 0;
+    if (S->format == STREAM_GZIP)
+      part = bgzfBlockSize((const unsigned char*)data + pos, size - pos);
+#ifdef DCT_HAVE_ZSTD
+    if (S->format == STREAM_ZSTD) {
+      part = ZSTD_findFrameCompressedSize(data + pos, size - pos);
+      if (ZSTD_isError(part)) part = 0;
+    }
+#endif
+    if (part == 0 || part > size - pos) {  // Not splittable
+      S->taskStart.assign(1, 0);
+      break;
+    }
+    pos += part;
+    if (pos < size && pos - S->taskStart.back() >= STREAM_TASKSIZE)
+      S->taskStart.push_back(pos);
+  }
+  S->taskStart.push_back(size);
+}
+
+/*******************************************************************************
+ * Thread of a file with several tasks: takes the next task, as long as it's
+ * no more than 'window' ahead of the reader, and decompresses it into one
+ * piece
+*******************************************************************************/
+static void decompressTasks(DCTStream* S) {
+  long nTasks = S->taskStart.size() - 1;
+
+  for (;;) {
+    long t;
+    {
+      std::unique_lock<std::mutex> l(S->lock);
+      S->change.wait(l, [S, nTasks] {
+        return S->stop || S->error || S->nextTask >= nTasks ||
+               S->nextTask < S->nextPiece + S->window;
+      });
+      if (S->stop || S->error || S->nextTask >= nTasks) return;
+      t = S->nextTask++;
+    }
+
+    std::vector<char> text;
+    bool ok = decompress(S, S->taskStart[t], S->taskStart[t + 1],
+                         [&text](const char* p, size_t n) {
+                           text.insert(text.end(), p, p + n);
+                           return true;
+                         });
+
+    std::lock_guard<std::mutex> l(S->lock);
+    if (ok)
+      S->pieces[t].swap(text);
+    else
+      S->error = true;
+    S->change.notify_all();
+  }
+}
+
+/*******************************************************************************
+ * Thread of any other file: decompresses it front to back in pieces of
+ * STREAM_PIECESIZE, waiting while 'window' pieces haven't been taken
+*******************************************************************************/
+static void decompressAll(DCTStream* S) {
+  std::vector<char> piece;
+  long seq = 0;
+
+  auto put = [S, &piece, &seq]() {
+    std::unique_lock<std::mutex> l(S->lock);
+    S->change.wait(
+        l, [S] { return S->stop || (long)S->pieces.size() < S->window; });
+    if (S->stop) return false;
+    S->pieces[seq++].swap(piece);
+    S->change.notify_all();
+    return true;
+  };
+
+  bool ok = decompress(S, 0, S->file.size,
+                       [&piece, &put](const char* p, size_t n) {
+                         piece.insert(piece.end(), p, p + n);
+                         return piece.size() < STREAM_PIECESIZE || put();
+                       });
+  if (ok && !piece.empty()) put();
+
+  std::lock_guard<std::mutex> l(S->lock);
+  if (!ok) S->error = true;
+  S->nPieces = seq;
+  S->change.notify_all();
+}
+
+/*******************************************************************************
+ * Open/close
+*******************************************************************************/
+bool openStream(DCTStream* S, const char* path, int nThreads) {
+  size_t n = strlen(path);
+
+  S->format = n >= 3 && strcmp(path + n - 3, ".gz") == 0 ? STREAM_GZIP
+                                                          : STREAM_ZSTD;
+  S->pieces.clear();
+  S->nextTask = S->nextPiece = 0;
+  S->nPieces = -1;
+  S->stop = S->error = false;
+  S->buf.clear();
+  S->used = S->head = S->scan = 0;
+  S->lines = 0;
+  S->file.fd = -1;
+  S->file.data = NULL;
+
+#ifndef DCT_HAVE_ZLIB
+  if (S->format == STREAM_GZIP) {
+    printf("libdct was built without zlib, can't read %s\n", path);
+    return false;
+  }
+#endif
+#ifndef DCT_HAVE_ZSTD
+  if (S->format == STREAM_ZSTD) {
+    printf("libdct was built without zstd, can't read %s\n", path);
+    return false;
+  }
+#endif
+  if (!openReader(&S->file, path)) return false;
+
+  findTasks(S);
+  long nTasks = S->taskStart.size() - 1;
+  if (nThreads < 1) nThreads = 1;
+  if (nTasks > 1 && nThreads > 1) {
+    S->window = 2 * nThreads;
+    S->nPieces = nTasks;
+    for (int k = 0; k < nThreads && k < nTasks; k++)
+      S->threads.emplace_back(decompressTasks, S);
+  } else {
+    S->window = STREAM_PIECES;
+    S->threads.emplace_back(decompressAll, S);
+  }
+  return true;
+}
+
+void closeStream(DCTStream* S) {
+  {
+    std::lock_guard<std::mutex> l(S->lock);
+    S->stop = true;
+    S->change.notify_all();
+  }
+  for (size_t i = 0; i < S->threads.size(); i++) S->threads[i].join();
+  S->threads.clear();
+  S->pieces.clear();
+  std::vector<char>().swap(S->buf);
+  closeReader(&S->file);
+}
+
+bool streamError(DCTStream* S) {
+  std::lock_guard<std::mutex> l(S->lock);
+  return S->error;
+}
+
+/*******************************************************************************
+ * The reader's side: the next piece in file order. Returns false at the end
+ * of the text or on an error.
+*******************************************************************************/
+static bool takePiece(DCTStream* S, std::vector<char>* text) {
+  std::unique_lock<std::mutex> l(S->lock);
+  S->change.wait(l, [S] {
+    return S->error || S->pieces.count(S->nextPiece) ||
+           (S->nPieces >= 0 && S->nextPiece >= S->nPieces);
+  });
+  std::map<long, std::vector<char> >::iterator it =
+      S->pieces.find(S->nextPiece);
+  if (S->error || it == S->pieces.end()) return false;
+
+  text->swap(it->second);
+  S->pieces.erase(it);
+  S->nextPiece++;
+  S->change.notify_all();
+  return true;
+}
+
+/*******************************************************************************
+ * Events
+*******************************************************************************/
+bool nextStreamEvent(DCTStream* S, DCTReader* view) {
+  std::vector<char> text;
+
+  for (;;) {
+    const char* data = S->buf.empty() ? NULL : &S->buf[0];
+    while (S->lines < NUMTSTEPS && S->scan < S->used) {
+      const char* nl =
+          (const char*)memchr(data + S->scan, '\n', S->used - S->scan);
+      if (!nl) {
+        S->scan = S->used;
+        break;
+      }
+      S->scan = nl - data + 1;
+      S->lines++;
+    }
+    if (S->lines == NUMTSTEPS) break;
+
+    /* End of the text. A cut-off last event isn't handed out, not even one
+     * that only misses its last line break, as the text readers refuse it */
+    if (!takePiece(S, &text)) return false;
+
+    /* Drop the events already handed out, then append the piece */
+    if (S->head) {
+      memmove(&S->buf[0], &S->buf[S->head], S->used - S->head);
+      S->used -= S->head;
+      S->scan -= S->head;
+      S->head = 0;
+    }
+    if (S->buf.size() < S->used + text.size())
+      S->buf.resize(S->used + text.size());
+    if (!text.empty()) memcpy(&S->buf[S->used], &text[0], text.size());
+    S->used += text.size();
+  }
+
+  const char* data = &S->buf[0];
+  view->fd = -1;
+  view->size = S->scan - S->head;
+  view->data = view->cur = data + S->head;
+  view->end = data + S->scan;
+  S->head = S->scan;
+  S->lines = 0;
+  return true;
+}
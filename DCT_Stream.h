@@ -0,0 +1,107 @@
+/*
+ * DCT_STREAM.h
+ *
+ * Reader for compressed NI_PDCT text dumps (.gz and .zst), so archived runs
+ * can be analyzed without unpacking them to scratch disk first. The file is
+ * mapped and decompressed by threads of its own while the analysis goes on;
+ * complete events are handed out as DCTReader views over the decompressed
+ * text, so readEventChannels() and the rest of the text reader work on them
+ * unchanged.
+ *
+ * Decompression runs in parallel where the file is made of independent
+ * parts: the frames of a multi-frame .zst (pzstd, concatenated zstd output)
+ * and the blocks of a BGZF .gz (bgzip). Runs of parts of about STREAM_TASKSIZE
+ * compressed bytes are handed to up to nThreads threads and put back in file
+ * order; at most 2 * nThreads of them are decompressed ahead of the reader.
+ * Any other file (gzip, a single zstd frame, several gzip members) is
+ * decompressed by one thread in pieces of STREAM_PIECESIZE bytes, at most
+ * STREAM_PIECES ahead.
+ *
+ * gzip needs zlib (DCT_HAVE_ZLIB) and zstd libzstd (DCT_HAVE_ZSTD); a format
+ * libdct was built without fails to open.
+ *
+ * Usage:
+ *   DCTStream S;
+ *   if (isCompressed(infile) && openStream(&S, infile, nThreads))
+ *     while (nextStreamEvent(&S, &view)) readEventChannels(&view, ...);
+ *   closeStream(&S);
+ *
+ */
+
+#ifndef DCT_STREAM_H
+#define DCT_STREAM_H
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "DCT_Reader.h"
+
+#define STREAM_GZIP 1
+#define STREAM_ZSTD 2
+
+#define STREAM_TASKSIZE (1 << 20)   // Compressed bytes per parallel task
+#define STREAM_PIECESIZE (1 << 22)  // Text bytes per piece, one thread
+#define STREAM_PIECES 4             // Pieces ahead, one thread
+
+/*******************************************************************************
+ * State of one compressed file. The decompressing threads put their output
+ * in 'pieces' by sequence number; the reader takes them in order into 'buf'
+ * and cuts events out of it, as DCTTail does.
+*******************************************************************************/
+typedef struct DCTStream {
+  int format;                      // STREAM_GZIP or STREAM_ZSTD
+  DCTReader file;                  // The compressed file, mapped
+  std::vector<size_t> taskStart;   // Parallel tasks, and the end of the file;
+                                   // one task for a single-thread file
+  int window;                      // Pieces decompressed ahead at most
+
+  std::mutex lock;                 // Guards everything down to 'error'
+  std::condition_variable change;  // A piece was added or taken
+  std::map<long, std::vector<char> > pieces;  // Not taken yet
+  long nextTask;                   // Next task a thread takes
+  long nextPiece;                  // Next piece the reader takes
+  long nPieces;                    // Pieces in all, -1 until known
+  bool stop;                       // closeStream() called
+  bool error;                      // Corrupt data (or out of memory)
+  std::vector<std::thread> threads;
+
+  std::vector<char> buf;           // Text taken, from the next event on
+  size_t used;                     // Bytes of buf that hold text
+  size_t head;                     // Start of the next event in buf
+  size_t scan;                     // Where the search for line ends resumes
+  int lines;                       // Complete lines between head and scan
+} DCTStream;
+
+/*******************************************************************************
+ * Whether path is a compressed dump, by its extension
+*******************************************************************************/
+inline bool isCompressed(const char* path) {
+  size_t n = strlen(path);
+  return (n >= 3 && strcmp(path + n - 3, ".gz") == 0) ||
+         (n >= 4 && strcmp(path + n - 4, ".zst") == 0);
+}
+
+/*******************************************************************************
+ * Maps path and starts decompressing it with up to nThreads threads. Returns
+ * false, with a message, if it can't be opened or its format isn't supported.
+*******************************************************************************/
+bool openStream(DCTStream* S, const char* path, int nThreads);
+
+/*******************************************************************************
+ * Points 'view' at the next complete event, all of whose lines end in a
+ * line break. The view stays valid until the next call. Returns false at the end of the text, or if the data is corrupt
+ * (streamError()).
+*******************************************************************************/
+bool nextStreamEvent(DCTStream* S, DCTReader* view);
+
+bool streamError(DCTStream* S);
+
+/*******************************************************************************
+ * Stops the threads and unmaps the file
+*******************************************************************************/
+void closeStream(DCTStream* S);
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * DCT_SWEEP.cxx
+ *
+ * Scans of the ROI cuts (see DCT_Sweep.h).
+ *
+ */
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "TROOT.h"
+
+#define NUMWIRES 8
+#define NUMTSTEPS 1000
+#define NUMADCS 32
+
+#include "DCT_Analysis.h"
+#include "DCT_Parallel.h"
+#include "DCT_Pipeline.h"
+#include "DCT_Sweep.h"
+
+/*******************************************************************************
+ * Books the histograms of a point
+*******************************************************************************/
+void addSweepPoint(std::vector<SweepResult>* R, const SweepPoint* point) {
+  SweepResult r;
+  int s = R->size();
+
+  r.point = *point;
+  initCuts(&r.cuts, point->threshval);
+  r.cuts.threshFrac = point->threshFrac;
+  r.cuts.min_eStart = point->min_eStart;
+  r.nEvents = 0;
+  for (int w = 0; w < NUMWIRES; w++) {
+    r.good[w] = r.closed[w] = 0;
+    r.drift[w] = histEditor(w, "DriftTimes", "Wire", "Drift Time (t)", 30, 0,
+                            60);
+  }
+  r.eff = histEditor(s, "Efficiency", "Point", "Wire", NUMWIRES, 1,
+                     NUMWIRES + 1);
+  R->push_back(r);
+}
+
+/*******************************************************************************
+ * Main
+*******************************************************************************/
+void runSweep(const DCTSamples* S, std::vector<SweepResult>* R,
+              int nThreads) {
+  int nPoints = R->size();
+  int nHists = nPoints * NUMWIRES;  // Drift times of point s at s * NUMWIRES
+
+  if (nThreads < 1) nThreads = 1;
+  if (nThreads > 1) ROOT::EnableThreadSafety();
+
+  std::vector<TH1F*> drift(nHists);
+  for (int s = 0; s < nPoints; s++)
+    for (int w = 0; w < NUMWIRES; w++)
+      drift[s * NUMWIRES + w] = (*R)[s].drift[w];
+  std::vector<TH1F*> hists;
+  workerHists(&drift[0], nHists, nThreads, &hists);
+
+  /* Counts of worker k, point s, wire w at (k * nPoints + s) * NUMWIRES + w */
+  std::vector<long> good((size_t)nThreads * nHists, 0);
+  std::vector<long> closed((size_t)nThreads * nHists, 0);
+
+  /*****************************************************************************
+  * Every worker goes through its chunk of events once. All points are
+  * evaluated on a wave while it is in cache.
+  *****************************************************************************/
+  runWorkers(nThreads, [&](int k) {
+    TH1F** h = &hists[(size_t)k * nHists];
+    long* G = &good[(size_t)k * nHists];
+    long* C = &closed[(size_t)k * nHists];
+    long first, last;
+
+    chunkRange(S->nEvents, nThreads, k, &first, &last);
+    for (long event = first; event < last; event++) {
+      for (int w = 0; w < NUMWIRES; w++) {
+        if (sampleBad(S, event, w)) continue;
+        const int16_t* wave = sampleWave(S, event, w);
+        for (int s = 0; s < nPoints; s++) {
+          const SweepResult* r = &(*R)[s];
+          ROI sum;
+          INIT_ROI(sum);
+          if (!findSumROI(wave, w, &r->cuts, r->point.roiSize, &sum))
+            continue;
+          G[s * NUMWIRES + w]++;
+          if (sum.spikeOver) C[s * NUMWIRES + w]++;
+          h[s * NUMWIRES + w]->Fill(sum.t_eEnd - sum.t_eStart);
+        }
+      }
+    }
+  });
+
+  /*****************************************************************************
+  * Merges in worker order
+  *****************************************************************************/
+  mergeWorkerHists(&hists, nHists, nThreads);
+  for (int s = 0; s < nPoints; s++) {
+    SweepResult* r = &(*R)[s];
+    r->nEvents = S->nEvents;
+    for (int w = 0; w < NUMWIRES; w++) {
+      for (int k = 0; k < nThreads; k++) {
+        r->good[w] += good[((size_t)k * nPoints + s) * NUMWIRES + w];
+        r->closed[w] += closed[((size_t)k * nPoints + s) * NUMWIRES + w];
+      }
+      r->eff->SetBinContent(w + 1, S->nEvents ? (double)r->good[w] /
+                                                    S->nEvents
+                                              : 0.);
+    }
+    r->eff->SetEntries(S->nEvents);
+  }
+}
@@ -0,0 +1,71 @@
+/*
+ * DCT_SWEEP.h
+ *
+ * Scans of the ROI cuts. The run is decoded once into a sample store (see
+ * DCT_Samples.h) and every point of a grid of threshval, threshFrac,
+ * min_eStart and ROISIZE is evaluated on it, all points in the same pass over
+ * the store, so a 50 point threshold scan costs one read of the file plus 50
+ * ROI searches per wave. Each point gets the hit efficiency and drift time
+ * histograms of its cuts.
+ *
+ * Usage:
+ *   std::vector<SweepResult> R;
+ *   for (...) addSweepPoint(&R, &point);
+ *   DCTSamples S;
+ *   loadSamples(&S, "NI_PDCT_17.txt", &R[0].cuts, -1, nThreads);
+ *   runSweep(&S, &R, nThreads);
+ *
+ */
+
+#ifndef DCT_SWEEP_H
+#define DCT_SWEEP_H
+
+#include <vector>
+
+#include "TH1F.h"
+
+#include "DCT_Cuts.h"
+#include "DCT_ROI.h"
+#include "DCT_Samples.h"
+
+/*******************************************************************************
+ * One set of cuts of the scan. The rest of the cuts are initCuts()'s.
+*******************************************************************************/
+typedef struct SweepPoint {
+  int threshval;   // Threshold of every wire (before threshOffset)
+  int threshFrac;  // Inverse % of threshold for event to be over
+  int min_eStart;  // # ROI start time = minloc - min_eStart
+  int roiSize;     // ROISIZE: drift time of waves that never got back
+                   // above thresh/threshFrac
+} SweepPoint;
+
+/*******************************************************************************
+ * Results of one point. eff has one bin per wire (bin w + 1): the fraction of
+ * events in which the wire had a good wave. drift[] are booked like
+ * DataTest7's drift times, so the point with DataTest7's cuts gives its
+ * histograms bin for bin.
+*******************************************************************************/
+typedef struct SweepResult {
+  SweepPoint point;
+  ROIParams cuts;
+  long nEvents;            // Events evaluated
+  long good[NUMWIRES];     // Good waves (waveGood)
+  long closed[NUMWIRES];   // Good waves whose ROI closed (spikeOver)
+  TH1F* eff;               // Hit efficiency per wire
+  TH1F* drift[NUMWIRES];   // Drift time (t_eEnd - t_eStart) of good waves
+} SweepResult;
+
+/*******************************************************************************
+ * Books the histograms of a point (SetDirectory(0), owned by the caller) and
+ * adds it to R
+*******************************************************************************/
+void addSweepPoint(std::vector<SweepResult>* R, const SweepPoint* point);
+
+/*******************************************************************************
+ * Evaluates every point of R on the events of S, with nThreads workers. The
+ * histograms come out the same for any number of threads. S must have been
+ * loaded with the safe min/max of the points.
+*******************************************************************************/
+void runSweep(const DCTSamples* S, std::vector<SweepResult>* R, int nThreads);
+
+#endif
@@ -0,0 +1,127 @@
+/*
+ * DCT_TAIL.h
+ *
+ * Follows an NI_PDCT text dump while the DAQ is still writing it. New bytes
+ * are read as they are appended, and an event is only handed out once all of
+ * its NUMTSTEPS lines are complete (newline terminated), so a line the DAQ is
+ * halfway through writing is never decoded.
+ *
+ * Usage:
+ *   DCTTail tail;
+ *   openTail(&tail, "NI_PDCT_17.txt");
+ *   while (running) {
+ *     long got = pollTail(&tail);
+ *     while (nextTailEvent(&tail, &view)) readEventTM(&view, tm, adc_offsets);
+ *     if (!got) ... wait a bit ...
+ *   }
+ *   closeTail(&tail);
+ *
+ */
+
+#ifndef DCT_TAIL_H
+#define DCT_TAIL_H
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "DCT_Reader.h"
+
+#define TAIL_READSIZE (1 << 20)  // Bytes per read() call
+#define TAIL_READS 4             // read() calls per pollTail()
+
+/*******************************************************************************
+ * State of one followed file. buf holds the bytes read that aren't part of a
+ * handed out event yet.
+*******************************************************************************/
+typedef struct DCTTail {
+  int fd;                 // File descriptor of the data file
+  long long offset;       // Bytes of the file read so far
+  std::vector<char> buf;  // Bytes read, from the start of the next event on
+  size_t used;            // Bytes of buf that hold data
+  size_t head;            // Start of the next event in buf
+  size_t scan;            // Where the search for line ends resumes
+  int lines;              // Complete lines between head and scan
+} DCTTail;
+
+inline bool openTail(DCTTail* T, const char* path) {
+  T->fd = open(path, O_RDONLY);
+  T->offset = 0;
+  T->buf.clear();
+  T->used = T->head = T->scan = 0;
+  T->lines = 0;
+  return T->fd >= 0;
+}
+
+inline void closeTail(DCTTail* T) {
+  if (T->fd >= 0) close(T->fd);
+  T->fd = -1;
+  std::vector<char>().swap(T->buf);
+}
+
+/*******************************************************************************
+ * Reads what was appended since the last call, at most TAIL_READS *
+ * TAIL_READSIZE bytes, so a backlog is worked through a budget at a time and
+ * buf stays at about one budget plus one event. Returns the number of bytes
+ * read (call again right away if it's the whole budget), 0 if nothing is new,
+ * -1 if the file got shorter than what was already read (truncated or
+ * replaced).
+*******************************************************************************/
+inline long pollTail(DCTTail* T) {
+  struct stat st;
+  long total = 0;
+
+  if (fstat(T->fd, &st) < 0 || st.st_size < T->offset) return -1;
+
+  /* Drop the events already handed out */
+  if (T->head) {
+    memmove(&T->buf[0], &T->buf[T->head], T->used - T->head);
+    T->used -= T->head;
+    T->scan -= T->head;
+    T->head = 0;
+  }
+
+  for (int i = 0; i < TAIL_READS; i++) {
+    if (T->buf.size() < T->used + TAIL_READSIZE)
+      T->buf.resize(T->used + TAIL_READSIZE);
+    ssize_t n = read(T->fd, &T->buf[T->used], TAIL_READSIZE);
+    if (n <= 0) break;
+    T->used += n;
+    T->offset += n;
+    total += n;
+  }
+  return total;
+}
+
+/*******************************************************************************
+ * Points 'view' at the next complete event, if all of its lines are in.
+ * The view stays valid until the next pollTail().
+*******************************************************************************/
+inline bool nextTailEvent(DCTTail* T, DCTReader* view) {
+  const char* data = T->buf.empty() ? NULL : &T->buf[0];
+
+  while (T->lines < NUMTSTEPS && T->scan < T->used) {
+    const char* nl =
+        (const char*)memchr(data + T->scan, '\n', T->used - T->scan);
+    if (!nl) {
+      T->scan = T->used;
+      break;
+    }
+    T->scan = nl - data + 1;
+    T->lines++;
+  }
+  if (T->lines < NUMTSTEPS) return false;
+
+  view->fd = -1;
+  view->size = T->scan - T->head;
+  view->data = view->cur = data + T->head;
+  view->end = data + T->scan;
+  T->head = T->scan;
+  T->lines = 0;
+  return true;
+}
+
+#endif
@@ -0,0 +1,357 @@
+/*
+ * DCT_ZS.h
+ *
+ * Zero-suppressed container (.dctz) for archived NI_PDCT runs. The ROI finder
+ * is run once over the raw data with the cuts the analyses use, and only the
+ * ROI window of each wire with a hit is kept: the left and right samples
+ * from the earliest ROI start (min_eStart bins before the threshold crossing)
+ * to the latest ROI end over the cut sets. Everything else is dropped, so a
+ * run shrinks by well over an order of magnitude against .dctb.
+ *
+ * For any of the cut sets it was made with, the ROIs found from the windows
+ * (see dctzEventROIs()) are the ones findWireROI() finds in the raw data:
+ * each set's crossing and end lie inside the union of the windows, and
+ * nothing before the window crosses a threshold. The per-wire summary keeps
+ * what needs the whole wave: the wire minimum and where the wave
+ * malfunctioned. Other cuts can't be applied to a .dctz file.
+ *
+ * Layout:
+ *   [0, DCTZ_HEADERSIZE)   DCTZHeader, zero padded
+ *   event records          back to back, event i at offsets[i]:
+ *                            DCTZWire[NUMWIRES]  summary of every wire
+ *                            for each wire with a window (length > 0):
+ *                              int16 L[length], int16 R[length]
+ *   indexOffset            numEvents + 1 int64 offsets (the last one is the
+ *                          end of the last record)
+ *
+ * Samples are stored with the ADC offsets already subtracted, like .dctb.
+ *
+ * Usage:
+ *   convertToDCTZ("NI_PDCT_17.txt", "NI_PDCT_17.dctz", adc_offsets, cuts, n);
+ *   DCTZReader r;
+ *   openDCTZ(&r, "NI_PDCT_17.dctz");
+ *   dctzEventROIs(&r, event, &cuts, ROISIZE, sum, waveGood);
+ *
+ */
+
+#ifndef DCT_ZS_H
+#define DCT_ZS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "DCT_Binary.h"
+#include "DCT_Reader.h"
+#include "DCT_ROI.h"
+#include "DCT_Samples.h"
+
+#define DCTZ_MAGIC "DCTZ"
+#define DCTZ_VERSION 1
+#define DCTZ_HEADERSIZE 4096
+#define DCTZ_MAXCUTSETS 16
+
+/*******************************************************************************
+ * File header. Fixed size, written at the start of the file
+*******************************************************************************/
+typedef struct DCTZHeader {
+  char magic[4];                        // DCTZ_MAGIC, no terminator
+  int32_t version;                      // DCTZ_VERSION
+  int32_t numWires;                     // NUMWIRES at conversion time
+  int32_t numTsteps;                    // NUMTSTEPS at conversion time
+  int32_t roiSize;                      // ROISIZE at conversion time
+  int32_t nCutSets;                     // Cut sets the windows were made with
+  int64_t numEvents;                    // Number of events stored
+  int64_t indexOffset;                  // Byte offset of the event offsets
+  ROIParams cutSets[DCTZ_MAXCUTSETS];
+} DCTZHeader;
+
+/*******************************************************************************
+ * Summary of one wire in one event
+*******************************************************************************/
+#define ZW_BELOWSAFE 1  // Malfunction: a sample below safeMinimum at badloc
+#define ZW_ABOVESAFE 2  // Malfunction: a sample above safeMaximum at badloc
+
+typedef struct DCTZWire {
+  int16_t minval;   // Wire minimum (up to badloc if it malfunctioned)
+  int16_t minloc;   // Wire minimum bin number
+  int16_t badloc;   // First malfunctioning bin, -1 if none
+  int16_t start;    // First bin of the window
+  int16_t length;   // Bins in the window, 0 for none (no hit or malfunction)
+  uint8_t flags;    // ZW_*
+  uint8_t reserved;
+} DCTZWire;
+
+/*******************************************************************************
+ * State of one mapped .dctz file
+*******************************************************************************/
+typedef struct DCTZReader {
+  int fd;                  // File descriptor of the data file
+  size_t size;             // Size of the file in bytes
+  const char* data;        // Start of the mapping
+  DCTZHeader header;       // Copy of the file header
+  const int64_t* offsets;  // Event offsets, inside the mapping
+} DCTZReader;
+
+/*******************************************************************************
+ * True if path names a .dctz file
+*******************************************************************************/
+inline bool isDCTZ(const char* path) {
+  size_t n = strlen(path);
+  return n >= 5 && strcmp(path + n - 5, ".dctz") == 0;
+}
+
+/*******************************************************************************
+ * Zero-suppresses one event. Sample t of ADC iadc is samples[iadc *
+ * NUMTSTEPS + t]. Appends the record to out.
+*******************************************************************************/
+template <typename T>
+void suppressEvent(const T* samples, const ROIParams* cutSets, int nCutSets,
+                   std::vector<char>* out) {
+  DCTZWire wires[NUMWIRES];
+  size_t at = out->size();
+
+  out->resize(at + sizeof wires);
+  for (int w = 0; w < NUMWIRES; w++) {
+    const T* L = samples + 2 * w * NUMTSTEPS;
+    const T* R = samples + (2 * w + 1) * NUMTSTEPS;
+    DCTZWire* z = &wires[w];
+    int start = NUMTSTEPS, end = -1;
+
+    memset(z, 0, sizeof *z);
+    for (int s = 0; s < nCutSets; s++) {
+      Extrema Le, Re;
+      ROI sum;
+      INIT_EXTREMA(Le);
+      INIT_EXTREMA(Re);
+      INIT_ROI(sum);
+      bool good = findWireROI(L, R, w, &cutSets[s], &Le, &Re, &sum);
+      z->minval = sum.minval;  // Same for every set
+      z->minloc = sum.minloc;
+      z->badloc = sum.badloc;
+      if (sum.badloc >= 0) {
+        z->flags = L[sum.badloc] < cutSets[s].safeMinimum ||
+                           R[sum.badloc] < cutSets[s].safeMinimum
+                       ? ZW_BELOWSAFE
+                       : ZW_ABOVESAFE;
+        break;
+      }
+      if (!good) continue;
+
+      /* The window has to reach this set's crossing and the end of its ROI */
+      int last = sum.spikeOver ? sum.t_eEnd : sum.t_eStart + ROISIZE;
+      if (last < sum.t_eStart + cutSets[s].min_eStart)
+        last = sum.t_eStart + cutSets[s].min_eStart;
+      if (last > NUMTSTEPS - 1) last = NUMTSTEPS - 1;
+      if (sum.t_eStart < start) start = sum.t_eStart;
+      if (last > end) end = last;
+    }
+    if (z->badloc >= 0 || end < start) continue;
+
+    z->start = start;
+    z->length = end - start + 1;
+    size_t n = out->size();
+    out->resize(n + 2 * z->length * sizeof(int16_t));
+    int16_t* win = (int16_t*)&(*out)[n];
+    for (int t = start; t <= end; t++) {
+      win[t - start] = (int16_t)L[t];
+      win[z->length + t - start] = (int16_t)R[t];
+    }
+  }
+  memcpy(&(*out)[at], wires, sizeof wires);
+}
+
+/*******************************************************************************
+ * Converts a run (text or .dctb) to .dctz, with the windows of nCutSets cut
+ * sets. They must share the safe min/max. Returns the number of events
+ * written, or -1 on error (a write that failed, e.g. a full disk), in which
+ * case the partial outfile is removed.
+*******************************************************************************/
+inline long convertToDCTZ(const char* infile, const char* outfile,
+                          const int* offsets, const ROIParams* cutSets,
+                          int nCutSets) {
+  static int adc[NUMADCS][NUMTSTEPS];
+  DCTReader reader = {};
+  DCTBReader bReader = {};
+  bool binary = isDCTB(infile);
+  DCTZHeader header;
+  char pad[DCTZ_HEADERSIZE] = {0};
+  std::vector<int64_t> index;
+  std::vector<char> record;
+  bool ok = true;
+
+  if (nCutSets < 1 || nCutSets > DCTZ_MAXCUTSETS) return -1;
+  for (int s = 1; s < nCutSets; s++)
+    if (cutSets[s].safeMinimum != cutSets[0].safeMinimum ||
+        cutSets[s].safeMaximum != cutSets[0].safeMaximum)
+      return -1;
+  if (binary ? !openDCTB(&bReader, infile) : !openReader(&reader, infile))
+    return -1;
+  FILE* out = fopen(outfile, "wb");
+  if (!out) {
+    if (binary)
+      closeDCTB(&bReader);
+    else
+      closeReader(&reader);
+    return -1;
+  }
+
+  memset(&header, 0, sizeof header);
+  memcpy(header.magic, DCTZ_MAGIC, 4);
+  header.version = DCTZ_VERSION;
+  header.numWires = NUMWIRES;
+  header.numTsteps = NUMTSTEPS;
+  header.roiSize = ROISIZE;
+  header.nCutSets = nCutSets;
+  for (int s = 0; s < nCutSets; s++) header.cutSets[s] = cutSets[s];
+
+  /* Placeholder header, rewritten once the event count is known */
+  ok = fwrite(pad, 1, DCTZ_HEADERSIZE, out) == DCTZ_HEADERSIZE;
+
+  int64_t offset = DCTZ_HEADERSIZE;
+  for (long event = 0; ok; event++) {
+    record.clear();
+    if (binary) {
+      const int16_t* e = dctbEvent(&bReader, event);
+      if (!e) break;
+      suppressEvent(e, cutSets, nCutSets, &record);
+    } else {
+      if (!readEvent(&reader, adc, offsets)) break;
+      suppressEvent(&adc[0][0], cutSets, nCutSets, &record);
+    }
+    ok = fwrite(&record[0], 1, record.size(), out) == record.size();
+    index.push_back(offset);
+    offset += record.size();
+  }
+  if (binary)
+    closeDCTB(&bReader);
+  else
+    closeReader(&reader);
+
+  index.push_back(offset);
+  header.numEvents = index.size() - 1;
+  header.indexOffset = offset;
+  ok = ok && fwrite(&index[0], sizeof(int64_t), index.size(), out) ==
+                 index.size();
+  memcpy(pad, &header, sizeof header);
+  ok = ok && fseek(out, 0, SEEK_SET) == 0 &&
+       fwrite(pad, 1, DCTZ_HEADERSIZE, out) == DCTZ_HEADERSIZE;
+  if (fclose(out) != 0) ok = false;
+  if (!ok) {
+    remove(outfile);
+    return -1;
+  }
+
+  return header.numEvents;
+}
+
+/*******************************************************************************
+ * Maps a .dctz file and checks its header against this build's NUMWIRES and
+ * NUMTSTEPS. Returns false if it can't be used.
+*******************************************************************************/
+inline bool openDCTZ(DCTZReader* r, const char* path) {
+  struct stat st;
+
+  r->data = NULL;
+  r->offsets = NULL;
+  r->size = 0;
+  r->fd = open(path, O_RDONLY);
+  if (r->fd < 0) return false;
+  if (fstat(r->fd, &st) < 0 || st.st_size < DCTZ_HEADERSIZE) {
+    close(r->fd);
+    r->fd = -1;
+    return false;
+  }
+  r->size = st.st_size;
+
+  void* map = mmap(NULL, r->size, PROT_READ, MAP_SHARED, r->fd, 0);
+  if (map == MAP_FAILED) {
+    close(r->fd);
+    r->fd = -1;
+    return false;
+  }
+  madvise(map, r->size, MADV_SEQUENTIAL);
+  r->data = (const char*)map;
+  memcpy(&r->header, r->data, sizeof r->header);
+
+  const DCTZHeader* h = &r->header;
+  if (memcmp(h->magic, DCTZ_MAGIC, 4) != 0 || h->version != DCTZ_VERSION ||
+      h->numWires != NUMWIRES || h->numTsteps != NUMTSTEPS ||
+      h->nCutSets < 1 || h->nCutSets > DCTZ_MAXCUTSETS ||
+      h->numEvents < 0 || h->indexOffset < DCTZ_HEADERSIZE ||
+      h->indexOffset + (h->numEvents + 1) * (int64_t)sizeof(int64_t) >
+          (int64_t)r->size) {
+    munmap(map, r->size);
+    close(r->fd);
+    r->fd = -1;
+    r->data = NULL;
+    return false;
+  }
+  r->offsets = (const int64_t*)(r->data + h->indexOffset);
+  return true;
+}
+
+/*******************************************************************************
+ * Unmaps and closes a .dctz file
+*******************************************************************************/
+inline void closeDCTZ(DCTZReader* r) {
+  if (r->data) munmap((void*)r->data, r->size);
+  if (r->fd >= 0) close(r->fd);
+  r->fd = -1;
+  r->data = NULL;
+  r->offsets = NULL;
+  r->size = 0;
+}
+
+/*******************************************************************************
+ * Returns the summary of event i inside the mapping (its windows follow), or
+ * NULL past the last event
+*******************************************************************************/
+inline const DCTZWire* dctzEvent(const DCTZReader* r, long i) {
+  if (i < 0 || i >= r->header.numEvents) return NULL;
+  return (const DCTZWire*)(r->data + r->offsets[i]);
+}
+
+inline long dctzEventSize(const DCTZReader* r, long i) {
+  return r->offsets[i + 1] - r->offsets[i];
+}
+
+/*******************************************************************************
+ * Index of the cut set of the file that equals p, -1 if there's none
+*******************************************************************************/
+inline int dctzCutSet(const DCTZReader* r, const ROIParams* p) {
+  for (int s = 0; s < r->header.nCutSets; s++)
+    if (!memcmp(&r->header.cutSets[s], p, sizeof *p)) return s;
+  return -1;
+}
+
+/*******************************************************************************
+ * ROIs of event i for cut set p (one of the file's, see dctzCutSet()): the
+ * same sum[] and waveGood[] findWireROI() gives on the raw data. sum[] are
+ * INIT_ROI'd here.
+*******************************************************************************/
+inline void dctzEventROIs(const DCTZReader* r, long i, const ROIParams* p,
+                          int roiSize, ROI* sum, bool* waveGood) {
+  const DCTZWire* z = dctzEvent(r, i);
+  const int16_t* win = (const int16_t*)(z + NUMWIRES);
+  int16_t wave[NUMTSTEPS];
+
+  for (int w = 0; w < NUMWIRES; w++) {
+    INIT_ROI(sum[w]);
+    sum[w].minval = z[w].minval;
+    sum[w].minloc = z[w].minloc;
+    sum[w].badloc = z[w].badloc;
+    waveGood[w] = false;
+    if (z[w].length <= 0) continue;
+
+    int n = z[w].length;
+    for (int t = 0; t < n; t++) wave[t] = win[t] + win[n + t];
+    waveGood[w] =
+        findWindowROI(wave, z[w].start, n, w, p, roiSize, &sum[w]);
+    win += 2 * n;
+  }
+}
+
+#endif
@@ -0,0 +1,361 @@
+/*
+ * dct-analyze.cxx
+ *
+ * Runs the DataTest analyses of libdct headless and saves their histograms
+ * (with fits, for DataTest9) to a ROOT file, one directory per analysis. Any
+ * combination of analyses is done over a single read of the data.
+ *
+ * Usage:
+ *   dct-analyze [-j threads] [-o out.root] [-c|-C calib.rtc] [-m map.txt]
+ *               [-a events] [-s stats.json [-p secs]] [-w hits.root] TESTS
+ *               [infile]
+ *   dct-analyze -R hits.root [-j threads] [-o out.root] [-c|-C calib.rtc]
+ *               TESTS
+ *   dct-analyze -z out.dctz TESTS [infile]
+ *
+ * TESTS is a comma separated list of 5, 7 and 9 (e.g. 5,7,9). infile
+ * defaults to NI_PDCT_17.txt, out.root to DCT_DataTest<TESTS>.root.
+ * -c/-C also save the DataTest9 r-t fits as a calibration table with linear
+ * or cubic interpolation (see DCT_Calib.h).
+ *
+ * -m reads the wires' ADC columns from a channel map file (see
+ * DCT_Channels.h) instead of using the DAQ's; only those columns are decoded.
+ *
+ * -a sets how many text events each worker's reader thread decodes ahead of
+ * it (default 16, see DCTPipeline); -a 0 decodes them in the worker.
+ *
+ * -s writes the run's counters and timers (events, bytes, time per stage and
+ * pass, why each wire's waves were thrown out; see DCT_Instrument.h) as JSON
+ * at the end, and every -p seconds during the run if given.
+ *
+ * -w also saves the hit records of every event (see DCT_Hits.h), found with
+ * the cuts of the first of TESTS. -R makes the histograms from such a file
+ * instead of the raw data; TESTS must use the cuts it was made with.
+ *
+ * -z only writes infile zero-suppressed (see DCT_ZS.h), keeping the ROI
+ * windows of the cuts of TESTS. The output reads like any data file for
+ * those TESTS.
+ *
+ * Online mode:
+ *   dct-analyze -f [-r secs] [-t secs] [-o out.root] [-m map.txt] TESTS
+ *               [infile]
+ *
+ * -f follows infile while the DAQ writes it (see followPipeline()). Every
+ * -r seconds (default 2) out.root is rewritten with the histograms so far
+ * and a status line is printed. It stops on Ctrl-C, or after -t seconds
+ * without new data; the final histograms are saved either way.
+ *
+ * Sharded runs (see DCT_Shard.h):
+ *   dct-analyze --shard k/N [-j threads] [-o part.root] [-m map.txt]
+ *               [-a events] [-s stats.json [-p secs]] TESTS [infile]
+ *   dct-analyze --merge [-j threads] [-o out.root] [-c|-C calib.rtc] TESTS
+ *               part.root ...
+ *
+ * --shard (-S) analyzes only shard k (0 to N - 1) of N of infile's events and
+ * saves the partial results to part.root, by default
+ * DCT_DataTest<TESTS>_<k>of<N>.root. Run every shard, on any machines that
+ * see infile, then --merge (-M) all N partial files, in any order: out.root
+ * gets the histograms (and fits, and calibration table) a single run over
+ * the whole of infile makes.
+ *
+ */
+
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <vector>
+
+#include "TROOT.h"
+
+#include "DCT_Analysis.h"
+#include "DCT_Shard.h"
+#include "DCT_ZS.h"
+
+/*******************************************************************************
+ * Prints how to call the program
+*******************************************************************************/
+static void usage(const char* prog) {
+  fprintf(stderr,
+          "Usage: %s [-j threads] [-o out.root] [-c|-C calib.rtc]\n"
+          "       [-m map.txt] [-a events] [-s stats.json [-p secs]]\n"
+          "       [-w hits.root] 5,7,9 [infile]\n"
+          "       %s -R hits.root [-j threads] [-o out.root]\n"
+          "       [-c|-C calib.rtc] 5,7,9\n"
+          "       %s -z out.dctz 5,7,9 [infile]\n"
+          "       %s -f [-r secs] [-t secs] [-o out.root] [-m map.txt]\n"
+          "       [-s stats.json [-p secs]] [-w hits.root] 5,7,9 [infile]\n"
+          "       %s --shard k/N [-j threads] [-o part.root] [-m map.txt]\n"
+          "       [-a events] [-s stats.json [-p secs]] 5,7,9 [infile]\n"
+          "       %s --merge [-j threads] [-o out.root] [-c|-C calib.rtc]\n"
+          "       5,7,9 part.root ...\n",
+          prog, prog, prog, prog, prog, prog);
+}
+
+/*******************************************************************************
+ * Writes infile zero-suppressed with the cuts of the passes of P
+*******************************************************************************/
+static bool suppress(const DCTPipeline* P, const char* infile,
+                     const char* outfile) {
+  std::vector<ROIParams> cuts;
+  for (size_t i = 0; i < P->passes.size(); i++) {
+    size_t s = 0;
+    while (s < cuts.size() &&
+           memcmp(&cuts[s], &P->passes[i].cuts, sizeof(ROIParams)))
+      s++;
+    if (s == cuts.size()) cuts.push_back(P->passes[i].cuts);
+  }
+
+  long n = convertToDCTZ(infile, outfile, adc_offsets, &cuts[0], cuts.size());
+  if (n < 0) {
+    fprintf(stderr, "Can't convert %s to %s\n", infile, outfile);
+    return false;
+  }
+  struct stat in, out;
+  stat(infile, &in);
+  stat(outfile, &out);
+  printf("Wrote %ld events to %s, %.1f times smaller than %s\n", n, outfile,
+         out.st_size ? (double)in.st_size / out.st_size : 0., infile);
+  return true;
+}
+
+/*******************************************************************************
+ * Online mode: status line and snapshot of the histograms at every refresh
+*******************************************************************************/
+typedef struct Monitor {
+  DataTestResults* R;
+  const char* outfile;
+  std::chrono::steady_clock::time_point start;
+  long lastEvents;  // Events at the previous refresh
+  std::chrono::steady_clock::time_point last;
+} Monitor;
+
+static volatile bool stopRequested = false;
+
+static void onSignal(int) { stopRequested = true; }
+
+static void updateMonitor(void* data, long nEvents) {
+  Monitor* M = (Monitor*)data;
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  double dt = std::chrono::duration<double>(now - M->last).count();
+  double total = std::chrono::duration<double>(now - M->start).count();
+
+  saveResults(M->R, M->outfile);
+  printf("%8.1f s  %10ld events  %8.1f events/s\n", total, nEvents,
+         dt > 0 ? (nEvents - M->lastEvents) / dt : 0.);
+  fflush(stdout);
+  M->lastEvents = nEvents;
+  M->last = now;
+}
+
+/*******************************************************************************
+ * Main
+*******************************************************************************/
+int main(int argc, char** argv) {
+  int nThreads = 1;
+  const char* outfile = NULL;
+  const char* calibfile = NULL;
+  int interp = RTC_LINEAR;
+  bool follow = false;
+  double refresh = 2;       // Online mode: seconds between snapshots
+  double idleTimeout = -1;  // Online mode: stop after this long without data
+  const char* statsfile = NULL;
+  double statsInterval = 0;  // Seconds between snapshots of the counters
+  const char* hitsOut = NULL;
+  const char* hitsIn = NULL;
+  const char* zsOut = NULL;
+  const char* mapfile = NULL;
+  int readAhead = DCT_READAHEAD;
+  int shard = 0, nShards = 0;  // Shard mode if nShards > 0
+  bool merge = false;
+  int opt;
+  static const struct option longOpts[] = {
+      {"shard", required_argument, 0, 'S'},
+      {"merge", no_argument, 0, 'M'},
+      {0, 0, 0, 0}};
+
+  while ((opt = getopt_long(argc, argv, "j:o:c:C:m:a:fr:t:s:p:w:R:z:S:Mh",
+                            longOpts, NULL)) != -1) {
+    switch (opt) {
+      case 'j':
+        nThreads = atoi(optarg);
+        break;
+      case 'o':
+        outfile = optarg;
+        break;
+      case 'c':
+      case 'C':
+        calibfile = optarg;
+        interp = opt == 'C' ? RTC_CUBIC : RTC_LINEAR;
+        break;
+      case 'm':
+        mapfile = optarg;
+        break;
+      case 'a':
+        readAhead = atoi(optarg);
+        break;
+      case 'f':
+        follow = true;
+        break;
+      case 'r':
+        refresh = atof(optarg);
+        break;
+      case 't':
+        idleTimeout = atof(optarg);
+        break;
+      case 's':
+        statsfile = optarg;
+        break;
+      case 'p':
+        statsInterval = atof(optarg);
+        break;
+      case 'w':
+        hitsOut = optarg;
+        break;
+      case 'R':
+        hitsIn = optarg;
+        break;
+      case 'z':
+        zsOut = optarg;
+        break;
+      case 'S':
+        if (!parseShard(optarg, &shard, &nShards)) {
+          fprintf(stderr, "--shard takes k/N, 0 <= k < N\n");
+          return 1;
+        }
+        break;
+      case 'M':
+        merge = true;
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind >= argc) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  const char* tests = argv[optind];
+  const char* infile = optind + 1 < argc ? argv[optind + 1] : "NI_PDCT_17.txt";
+  DataTestResults R = {};
+  char defaultOut[64] = "DCT_DataTest";
+
+  for (const char* c = tests; *c; c++) {
+    if (*c == '5') R.run5 = true;
+    else if (*c == '7') R.run7 = true;
+    else if (*c == '9') R.run9 = true;
+    else if (*c != ',') {
+      usage(argv[0]);
+      return 1;
+    }
+    if (*c != ',') strncat(defaultOut, c, 1);
+  }
+  size_t len = strlen(defaultOut);
+  if (nShards)
+    snprintf(defaultOut + len, sizeof defaultOut - len - 5, "_%dof%d", shard,
+             nShards);
+  strcat(defaultOut, ".root");
+  if (!outfile) outfile = defaultOut;
+  if (calibfile && !R.run9) {
+    fprintf(stderr, "-c/-C need DataTest9\n");
+    return 1;
+  }
+  if (hitsIn && (follow || hitsOut || statsfile || zsOut || mapfile)) {
+    fprintf(stderr, "-R can't be used with -f, -w, -s, -z or -m\n");
+    return 1;
+  }
+  if (nShards && (merge || follow || hitsIn || hitsOut || zsOut || calibfile)) {
+    fprintf(stderr, "--shard can't be used with --merge, -f, -R, -w, -z or "
+                    "-c/-C\n");
+    return 1;
+  }
+  if (merge && (follow || hitsIn || hitsOut || zsOut || mapfile || statsfile)) {
+    fprintf(stderr, "--merge can't be used with -f, -R, -w, -z, -m or -s\n");
+    return 1;
+  }
+  if (merge && optind + 1 >= argc) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (zsOut && mapfile) {
+    fprintf(stderr, "-z writes the DAQ's channel map, -m can't be used\n");
+    return 1;
+  }
+  if (hitsIn) infile = hitsIn;
+
+  gROOT->SetBatch(kTRUE);
+
+  /*****************************************************************************
+  * Runs the analyses over one read of the data, or follows the file
+  *****************************************************************************/
+  DCTPipeline P;
+  DCTChannelMap channels;
+  if (mapfile) {
+    if (!readChannelMap(&channels, mapfile)) return 1;
+    P.channels = &channels;
+  }
+  P.readAhead = readAhead;
+  if (R.run5) addDataTest5Pass(&P, &R.H5);
+  if (R.run7) addDataTest7Pass(&P, &R.H7);
+  if (R.run9) addDataTest9Pass(&P, &R.H9);
+  if (zsOut) return suppress(&P, infile, zsOut) ? 0 : 1;
+  if (hitsOut) addHitsPass(&P, hitsOut, &P.passes[0].cuts);
+  DCTInstrument I;
+  if (statsfile) {
+    initInstrument(&I, statsfile, statsInterval);
+    P.instrument = &I;
+  }
+
+  long nEvents;
+  if (follow) {
+    Monitor M;
+    M.R = &R;
+    M.outfile = outfile;
+    M.start = M.last = std::chrono::steady_clock::now();
+    M.lastEvents = 0;
+
+    DCTFollow F;
+    F.refresh = refresh;
+    F.poll = 0.05;
+    F.idleTimeout = idleTimeout;
+    F.stop = &stopRequested;
+    F.data = &M;
+    F.update = updateMonitor;
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    nEvents = followPipeline(&P, infile, &F);
+  } else if (hitsIn) {
+    nEvents = replayHits(&P, hitsIn, nThreads, HIT_ALL);
+  } else if (nShards) {
+    return runShard(&P, infile, nThreads, shard, nShards, outfile) >= 0 ? 0
+                                                                         : 1;
+  } else if (merge) {
+    nEvents = mergeShards(&P, argv + optind + 1, argc - optind - 1);
+  } else {
+    nEvents = runPipeline(&P, infile, nThreads);
+  }
+  if (nEvents < 0) return 1;
+  if (R.run9) fitDataTest9(&R.H9, nThreads);
+  if (calibfile && !exportRTCalib(&R.H9, calibfile, interp)) return 1;
+
+  /*****************************************************************************
+  * Saves the histograms
+  *****************************************************************************/
+  if (!saveResults(&R, outfile)) return 1;
+
+  if (merge)
+    printf("DataTest %s: %ld events from %d shards -> %s\n", tests, nEvents,
+           argc - optind - 1, outfile);
+  else
+    printf("DataTest %s: %ld events from %s -> %s\n", tests, nEvents, infile,
+           outfile);
+  return 0;
+}
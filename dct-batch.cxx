@@ -0,0 +1,117 @@
+/*
+ * dct-batch.cxx
+ *
+ * Runs the DataTest analyses of libdct over a campaign of runs (see
+ * DCT_Batch.h): every run's histograms are saved to a file of its own, like
+ * dct-analyze does, and the start time, drift time and max voltage
+ * histograms of all runs are added up into a campaign file. The runs share
+ * one pool of threads, chunk by chunk.
+ *
+ * Usage:
+ *   dct-batch [-j threads] [-d outdir] [-c campaign.root] [-l runlist]
+ *             [-e events] [-m map.txt] [-a events] TESTS [run ...]
+ *
+ * TESTS is a comma separated list of 5, 7 and 9 (e.g. 5,7). Each run is a
+ * data file or a glob pattern (quoted, "data/NI_PDCT_*.txt"); -l adds the
+ * files or patterns of a run list, one per line, # for comments. Run
+ * NI_PDCT_17.txt is saved as outdir/NI_PDCT_17.root (outdir defaults to .),
+ * the campaign to outdir/campaign.root unless -c is given.
+ *
+ * -e sets how many events a chunk has, about (default 1000). -m and -a are
+ * dct-analyze's.
+ *
+ * Exits with 1 if any run failed; the others are saved and make up the
+ * campaign.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "TROOT.h"
+
+#include "DCT_Batch.h"
+
+/*******************************************************************************
+ * Prints how to call the program
+*******************************************************************************/
+static void usage(const char* prog) {
+  fprintf(stderr,
+          "Usage: %s [-j threads] [-d outdir] [-c campaign.root]\n"
+          "       [-l runlist] [-e events] [-m map.txt] [-a events]\n"
+          "       5,7,9 [run ...]\n",
+          prog);
+}
+
+/*******************************************************************************
+ * Main
+*******************************************************************************/
+int main(int argc, char** argv) {
+  int nThreads = 1;
+  const char* outdir = ".";
+  const char* campaignfile = NULL;
+  const char* listfile = NULL;
+  long chunkEvents = BATCH_CHUNKEVENTS;
+  const char* mapfile = NULL;
+  int readAhead = DCT_READAHEAD;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "j:d:c:l:e:m:a:h")) != -1) {
+    switch (opt) {
+      case 'j':
+        nThreads = atoi(optarg);
+        break;
+      case 'd':
+        outdir = optarg;
+        break;
+      case 'c':
+        campaignfile = optarg;
+        break;
+      case 'l':
+        listfile = optarg;
+        break;
+      case 'e':
+        chunkEvents = atol(optarg);
+        break;
+      case 'm':
+        mapfile = optarg;
+        break;
+      case 'a':
+        readAhead = atoi(optarg);
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind >= argc || chunkEvents < 1) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  DCTBatch B;
+  if (!initBatch(&B, argv[optind], nThreads)) {
+    usage(argv[0]);
+    return 1;
+  }
+  B.chunkEvents = chunkEvents;
+  B.readAhead = readAhead;
+  DCTChannelMap channels;
+  if (mapfile) {
+    if (!readChannelMap(&channels, mapfile)) return 1;
+    B.channels = &channels;
+  }
+  if (listfile && !readRunList(&B, listfile)) return 1;
+  for (int i = optind + 1; i < argc; i++)
+    if (!addBatchRuns(&B, argv[i])) return 1;
+
+  std::string campaign =
+      campaignfile ? campaignfile : std::string(outdir) + "/campaign.root";
+  gROOT->SetBatch(kTRUE);
+
+  int failed = runBatch(&B, outdir, campaign.c_str());
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,700 @@
+/*
+ * dct-bench.cxx
+ *
+ * Stage-level benchmark of the event loop. Events come from the synthetic
+ * generator (DCT_Generator.h) with a fixed seed and are formatted as text in
+ * memory, so every run times the same bytes and no disk is involved. For each
+ * data set size (the first n events) every stage runs 'repeats' times and the
+ * median is reported in ns/event and events/s.
+ *
+ * Stages:
+ *   parse_getline  istream getline()/atoi() per field, as the old macros read
+ *   parse          readEvent(): scanInt() into adc[iadc][t]
+ *   parse_tm       readEventTM(): scanInt() into tm[t][iadc]
+ *   parse_channels readEventChannels(): only the wires' 16 columns, scanInt()
+ *                  into packed rows tm[t][c], the other columns skipped
+ *   roi_wire       findWireROI() on all wires: extrema, ROI and integral of
+ *                  each wire in one pass (channel-major samples)
+ *   kernel_scalar  eventStatsScalar(): wire sums, extrema and threshold
+ *                  crossings of all wires at once (time-major samples)
+ *   kernel         same with the kernel selectEventKernel() picks
+ *   integral       findEventROIs() after the kernel: ROI start/end, integral
+ *                  and dN/dt from the wire sums
+ *   hist           DataTest7's TH1F fills (start, drift, dN/dt per wire)
+ *   rt             DataTest9's r-t building: addDrift() per good wire and
+ *                  addRT() for events on wires 3-5
+ *   event          parse_channels + kernel + integral (+ hist) one event at a
+ *                  time, as the pipeline runs
+ *
+ * The parse stages and 'event' each run over the whole data set. The others
+ * run back to back on blocks of BLOCK events decoded beforehand, so their
+ * inputs are as warm as right after parsing. hist and rt need ROOT and are
+ * only built in when it is (DCT_BENCH_ROOT).
+ *
+ * Every stage also adds up a checksum of what it found. Stages that compute
+ * the same thing (the parse stages, kernel/kernel_scalar, roi_wire/integral)
+ * must agree; a change that speeds a stage up but changes its results shows
+ * up there.
+ *
+ * Usage:
+ *   dct-bench [-n sizes] [-r repeats] [-s seed] [-f csv|json]
+ *             [-c baseline.csv] [-T percent]
+ *
+ *   -n 64,256,1024   data set sizes in events
+ *   -c file          compare with an earlier CSV output and exit with 1 if a
+ *                    stage got more than -T percent (default 10) slower
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <istream>
+#include <streambuf>
+#include <vector>
+
+#define NUMWIRES 8
+#define NUMTSTEPS 1000
+#define NUMADCS 32
+#define ROISIZE 25
+
+#include "DCT_Channels.h"
+#include "DCT_Cuts.h"
+#include "DCT_Generator.h"
+#include "DCT_Reader.h"
+#include "DCT_ROI.h"
+#include "DCT_SIMD.h"
+
+#ifdef DCT_BENCH_ROOT
+#include "TH1F.h"
+
+#include "DCT_RT.h"
+#endif
+
+#define BLOCK 8          // Events per block of the block-wise stages
+#define MAXREPEATS 100
+
+enum {
+  PARSE_GETLINE,
+  PARSE,
+  PARSE_TM,
+  PARSE_CHANNELS,
+  ROI_WIRE,
+  KERNEL_SCALAR,
+  KERNEL,
+  INTEGRAL,
+  HIST,
+  RT,
+  EVENT,
+  NSTAGES
+};
+
+static const char* stageNames[NSTAGES] = {
+    "parse_getline", "parse",  "parse_tm", "parse_channels", "roi_wire",
+    "kernel_scalar", "kernel", "integral", "hist",           "rt",
+    "event"};
+
+#ifdef DCT_BENCH_ROOT
+static bool haveStage(int) { return true; }
+#else
+static bool haveStage(int stage) { return stage != HIST && stage != RT; }
+#endif
+
+/*******************************************************************************
+ * Timings of one stage at one size
+*******************************************************************************/
+typedef struct BenchResult {
+  long size;                   // Events
+  int stage;
+  int repeats;
+  double seconds[MAXREPEATS];  // Time of each repeat
+  long long check;             // Checksum of the last repeat
+} BenchResult;
+
+static double median(const BenchResult* r) {
+  std::vector<double> s(r->seconds, r->seconds + r->repeats);
+  std::sort(s.begin(), s.end());
+  int n = r->repeats;
+  return n % 2 ? s[n / 2] : 0.5 * (s[n / 2 - 1] + s[n / 2]);
+}
+
+static double fastest(const BenchResult* r) {
+  return *std::min_element(r->seconds, r->seconds + r->repeats);
+}
+
+/*******************************************************************************
+ * Seconds since t0
+*******************************************************************************/
+typedef std::chrono::steady_clock::time_point TimePoint;
+
+static TimePoint now() { return std::chrono::steady_clock::now(); }
+
+static double secondsSince(TimePoint t0) {
+  return std::chrono::duration<double>(now() - t0).count();
+}
+
+/*******************************************************************************
+ * The data set: events formatted as text, one after the other
+*******************************************************************************/
+typedef struct BenchData {
+  std::vector<char> text;
+  std::vector<size_t> eventStart;  // Offset of each event, and the end
+} BenchData;
+
+static void makeData(BenchData* D, uint64_t seed, long nEvents) {
+  GenParams G;
+  static GenNoise N;
+  std::vector<int> tm(NUMTSTEPS * NUMADCS);
+  int(*adc)[NUMADCS] = (int(*)[NUMADCS]) & tm[0];
+
+  initGenParams(&G);
+  G.seed = seed;
+  initGenNoise(&N, G.noise);
+
+  D->text.resize(nEvents * GEN_EVENTSIZE);
+  D->eventStart.resize(nEvents + 1);
+  char* p = D->text.empty() ? NULL : &D->text[0];
+  for (long event = 0; event < nEvents; event++) {
+    GenTruth T;
+    D->eventStart[event] = p - &D->text[0];
+    generateEvent(&G, &N, event, &T, adc);
+    p = formatEvent(adc, p);
+  }
+  D->eventStart[nEvents] = p - (D->text.empty() ? p : &D->text[0]);
+  D->text.resize(D->eventStart[nEvents]);
+}
+
+/*******************************************************************************
+ * Reader over the first nEvents of the data set, without a file
+*******************************************************************************/
+static DCTReader dataReader(const BenchData* D, long nEvents) {
+  DCTReader r;
+  r.fd = -1;
+  r.size = D->eventStart[nEvents];
+  r.data = r.cur = &D->text[0];
+  r.end = r.data + r.size;
+  return r;
+}
+
+/*******************************************************************************
+ * istream over memory, for the getline() reader
+*******************************************************************************/
+struct MemBuf : std::streambuf {
+  MemBuf(const char* begin, const char* end) {
+    setg((char*)begin, (char*)begin, (char*)end);
+  }
+};
+
+/*******************************************************************************
+ * The old macros' reader: getline() up to each comma, then atoi()
+*******************************************************************************/
+static bool getlineEvent(std::istream& in, int adc[NUMADCS][NUMTSTEPS]) {
+  char cNum[10];
+
+  for (int t = 0; t < NUMTSTEPS; t++) {
+    for (int iadc = 0; iadc < NUMADCS - 1; iadc++) {
+      in.getline(cNum, 10, ',');
+      adc[iadc][t] = atoi(cNum) - adc_offsets[iadc];
+    }
+    in.getline(cNum, 10);
+    adc[NUMADCS - 1][t] = atoi(cNum) - adc_offsets[NUMADCS - 1];
+  }
+  return !in.fail();
+}
+
+/*******************************************************************************
+ * Checksums. The parsers' only add up the wires' ADCs, the columns every
+ * parser decodes.
+*******************************************************************************/
+static long long adcCheck(int adc[NUMADCS][NUMTSTEPS]) {
+  long long c = 0;
+  for (int iadc = 0; iadc < NUMCHANNELS; iadc++) c += adc[iadc][NUMTSTEPS - 1];
+  return c;
+}
+
+static long long tmCheck(int tm[NUMTSTEPS][NUMADCS]) {
+  long long c = 0;
+  for (int iadc = 0; iadc < NUMCHANNELS; iadc++) c += tm[NUMTSTEPS - 1][iadc];
+  return c;
+}
+
+static long long channelCheck(int tm[NUMTSTEPS][NUMCHANNELS]) {
+  long long c = 0;
+  for (int ch = 0; ch < NUMCHANNELS; ch++) c += tm[NUMTSTEPS - 1][ch];
+  return c;
+}
+
+static long long statsCheck(const EventStats* s) {
+  long long c = 0;
+  for (int w = 0; w < NUMWIRES; w++)
+    c += s->sumMin[w] + s->sumMinloc[w] + s->bad[w] + s->cross[w] +
+         s->spike[w];
+  for (int i = 0; i < 2 * NUMWIRES; i++)
+    c += s->adcMin[i] + s->adcMax[i] + s->adcMinloc[i] + s->adcMaxloc[i];
+  return c;
+}
+
+static long long roiCheck(const ROI* sum, bool good) {
+  if (!good) return 0;
+  return sum->t_eStart + sum->t_eEnd + sum->integral + sum->dn_dt +
+         sum->minval + sum->spikeOver;
+}
+
+/*******************************************************************************
+ * Kernel that leaves the stats as they are, so findEventROIs() only does the
+ * work after the kernel
+*******************************************************************************/
+static void keepStats(const int (*)[NUMCHANNELS], const ROIParams*,
+                      EventStats*) {}
+
+static const char* kernelName(EventKernel k) {
+#ifdef DCT_SIMD_X86
+  if (k == eventStatsAVX512) return "avx512";
+  if (k == eventStatsAVX2) return "avx2";
+#endif
+  return "scalar";
+}
+
+#ifdef DCT_BENCH_ROOT
+/*******************************************************************************
+ * Histograms of the hist and rt stages, binned as DataTest7 and DataTest9
+*******************************************************************************/
+typedef struct BenchHists {
+  TH1F* start[NUMWIRES];   // DataTest7 h1
+  TH1F* drift[NUMWIRES];   // DataTest7 h2
+  TH1F* dndt[NUMWIRES];    // DataTest7 h3
+  TH1F* dNdtBins;          // DataTest9 h1 binning
+  TH1F* rt;                // DataTest9 h3
+  TH1F* drift3;            // DataTest9 h4
+  RTBuilder dNdt[NUMWIRES];
+  RTCurve rt3;
+  HistFills fills3;
+} BenchHists;
+
+static void bookHists(BenchHists* H) {
+  char name[32];
+
+  TH1::AddDirectory(false);
+  for (int w = 0; w < NUMWIRES; w++) {
+    sprintf(name, "start%d", w);
+    H->start[w] = new TH1F(name, name, 50, 0, 600);
+    sprintf(name, "drift%d", w);
+    H->drift[w] = new TH1F(name, name, 30, 0, 60);
+    sprintf(name, "dndt%d", w);
+    H->dndt[w] = new TH1F(name, name, 50, -100, 50);
+  }
+  H->dNdtBins = new TH1F("dNdtBins", "dNdtBins", 25, 0, 50);
+  H->rt = new TH1F("rt", "rt", 30, 0, 60);
+  H->drift3 = new TH1F("drift3", "drift3", 25, 0, 50);
+}
+
+static void resetHists(BenchHists* H) {
+  for (int w = 0; w < NUMWIRES; w++) {
+    H->start[w]->Reset();
+    H->drift[w]->Reset();
+    H->dndt[w]->Reset();
+    initRT(&H->dNdt[w], H->dNdtBins);
+  }
+  initRTCurve(&H->rt3, H->rt, &H->dNdt[2], NUMTSTEPS);
+  initFills(&H->fills3, H->drift3);
+}
+
+static void fillHists(BenchHists* H, const ROI* sum, const bool* good) {
+  for (int w = 0; w < NUMWIRES; w++) {
+    if (!good[w]) continue;
+    H->start[w]->Fill(sum[w].t_eStart);
+    H->drift[w]->Fill(sum[w].t_eEnd - sum[w].t_eStart);
+    H->dndt[w]->Fill(sum[w].dn_dt);
+  }
+}
+
+static void fillRT(BenchHists* H, const ROI* sum, const bool* good) {
+  for (int w = 0; w < NUMWIRES; w++)
+    if (good[w]) addDrift(&H->dNdt[w], sum[w].t_eEnd - sum[w].t_eStart);
+
+  if (!good[2] || !good[3] || !good[4]) return;
+  for (int i = 2; i < 5; i++) {
+    double drift = sum[i].t_eEnd - sum[i].t_eStart;
+    addRT(&H->rt3, &H->dNdt[i]);
+    addFills(&H->fills3, H->drift3->FindFixBin(drift), NUMTSTEPS, 1,
+             NUMTSTEPS * drift, NUMTSTEPS * drift * drift);
+  }
+}
+
+static long long histCheck(const BenchHists* H) {
+  double c = 0;
+  for (int w = 0; w < NUMWIRES; w++)
+    c += H->start[w]->GetEntries() + H->drift[w]->GetEntries() +
+         H->dndt[w]->GetEntries();
+  return (long long)c;
+}
+
+static long long rtCheck(const BenchHists* H) {
+  double c = H->fills3.entries;
+  for (size_t i = 0; i < H->rt3.fills.w.size(); i++) c += H->rt3.fills.w[i];
+  return (long long)c;
+}
+#endif
+
+/*******************************************************************************
+ * Runs every stage once over the first nEvents events. Adds the time and
+ * checksum of each stage to res[stage].
+*******************************************************************************/
+typedef struct BenchState {
+  ROIParams cuts;
+  EventKernel kernel;
+  DCTChannelMap channels;     // The DAQ's
+  std::vector<int> tm;        // BLOCK events, time-major, whole rows
+  std::vector<int> chan;      // BLOCK events, time-major, wire channels
+  std::vector<int> adc;       // BLOCK events, channel-major
+  std::vector<EventStats> stats;
+  Extrema adcEx[BLOCK][2 * NUMWIRES];
+  ROI sum[BLOCK][NUMWIRES];
+  bool good[BLOCK][NUMWIRES];
+#ifdef DCT_BENCH_ROOT
+  BenchHists hists;
+#endif
+} BenchState;
+
+static void runOnce(BenchState* S, const BenchData* D, long nEvents,
+                    BenchResult* res) {
+  typedef int TMEvent[NUMTSTEPS][NUMADCS];
+  typedef int ChannelEvent[NUMTSTEPS][NUMCHANNELS];
+  typedef int ADCEvent[NUMADCS][NUMTSTEPS];
+  TMEvent* tm = (TMEvent*)&S->tm[0];
+  ChannelEvent* chan = (ChannelEvent*)&S->chan[0];
+  ADCEvent* adc = (ADCEvent*)&S->adc[0];
+  long long check[NSTAGES] = {0};
+  double seconds[NSTAGES] = {0};
+  TimePoint t0;
+
+  /* Parsers, each over the whole data set */
+  MemBuf buf(&D->text[0], &D->text[0] + D->eventStart[nEvents]);
+  std::istream in(&buf);
+  t0 = now();
+  for (long event = 0; event < nEvents; event++) {
+    getlineEvent(in, adc[0]);
+    check[PARSE_GETLINE] += adcCheck(adc[0]);
+  }
+  seconds[PARSE_GETLINE] = secondsSince(t0);
+
+  DCTReader r = dataReader(D, nEvents);
+  t0 = now();
+  for (long event = 0; event < nEvents; event++) {
+    readEvent(&r, adc[0], adc_offsets);
+    check[PARSE] += adcCheck(adc[0]);
+  }
+  seconds[PARSE] = secondsSince(t0);
+
+  r = dataReader(D, nEvents);
+  t0 = now();
+  for (long event = 0; event < nEvents; event++) {
+    readEventTM(&r, tm[0], adc_offsets);
+    check[PARSE_TM] += tmCheck(tm[0]);
+  }
+  seconds[PARSE_TM] = secondsSince(t0);
+
+  r = dataReader(D, nEvents);
+  t0 = now();
+  for (long event = 0; event < nEvents; event++) {
+    readEventChannels(&r, chan[0], &S->channels, adc_offsets);
+    check[PARSE_CHANNELS] += channelCheck(chan[0]);
+  }
+  seconds[PARSE_CHANNELS] = secondsSince(t0);
+
+  /* Per-wire and per-event stages, block by block */
+#ifdef DCT_BENCH_ROOT
+  resetHists(&S->hists);
+#endif
+  DCTReader rChan = dataReader(D, nEvents);
+  DCTReader rADC = dataReader(D, nEvents);
+  for (long first = 0; first < nEvents; first += BLOCK) {
+    int n = nEvents - first < BLOCK ? nEvents - first : BLOCK;
+    for (int i = 0; i < n; i++) {
+      readEventChannels(&rChan, chan[i], &S->channels, adc_offsets);
+      readEvent(&rADC, adc[i], adc_offsets);
+    }
+
+    t0 = now();
+    for (int i = 0; i < n; i++) {
+      for (int w = 0; w < NUMWIRES; w++) {
+        Extrema L, R;
+        ROI sum;
+        INIT_EXTREMA(L);
+        INIT_EXTREMA(R);
+        INIT_ROI(sum);
+        bool good =
+            findWireROI(adc[i][2 * w], adc[i][2 * w + 1], w, &S->cuts, &L, &R,
+                        &sum);
+        check[ROI_WIRE] += roiCheck(&sum, good);
+      }
+    }
+    seconds[ROI_WIRE] += secondsSince(t0);
+
+    t0 = now();
+    for (int i = 0; i < n; i++)
+      eventStatsScalar(chan[i], &S->cuts, &S->stats[i]);
+    seconds[KERNEL_SCALAR] += secondsSince(t0);
+    for (int i = 0; i < n; i++)
+      check[KERNEL_SCALAR] += statsCheck(&S->stats[i]);
+
+    t0 = now();
+    for (int i = 0; i < n; i++) S->kernel(chan[i], &S->cuts, &S->stats[i]);
+    seconds[KERNEL] += secondsSince(t0);
+    for (int i = 0; i < n; i++) check[KERNEL] += statsCheck(&S->stats[i]);
+
+    t0 = now();
+    for (int i = 0; i < n; i++)
+      findEventROIs(keepStats, chan[i], &S->cuts, &S->stats[i], S->adcEx[i],
+                    S->sum[i], S->good[i]);
+    seconds[INTEGRAL] += secondsSince(t0);
+    for (int i = 0; i < n; i++)
+      for (int w = 0; w < NUMWIRES; w++)
+        check[INTEGRAL] += roiCheck(&S->sum[i][w], S->good[i][w]);
+
+#ifdef DCT_BENCH_ROOT
+    t0 = now();
+    for (int i = 0; i < n; i++) fillHists(&S->hists, S->sum[i], S->good[i]);
+    seconds[HIST] += secondsSince(t0);
+
+    t0 = now();
+    for (int i = 0; i < n; i++) fillRT(&S->hists, S->sum[i], S->good[i]);
+    seconds[RT] += secondsSince(t0);
+#endif
+  }
+#ifdef DCT_BENCH_ROOT
+  check[HIST] = histCheck(&S->hists);
+  check[RT] = rtCheck(&S->hists);
+  resetHists(&S->hists);
+#endif
+
+  /* The whole event, as the pipeline does it */
+  r = dataReader(D, nEvents);
+  t0 = now();
+  for (long event = 0; event < nEvents; event++) {
+    readEventChannels(&r, chan[0], &S->channels, adc_offsets);
+    findEventROIs(S->kernel, chan[0], &S->cuts, &S->stats[0], S->adcEx[0],
+                  S->sum[0], S->good[0]);
+#ifdef DCT_BENCH_ROOT
+    fillHists(&S->hists, S->sum[0], S->good[0]);
+#endif
+    for (int w = 0; w < NUMWIRES; w++)
+      check[EVENT] += roiCheck(&S->sum[0][w], S->good[0][w]);
+  }
+  seconds[EVENT] = secondsSince(t0);
+
+  for (int s = 0; s < NSTAGES; s++) {
+    res[s].seconds[res[s].repeats++] = seconds[s];
+    res[s].check = check[s];
+  }
+}
+
+/*******************************************************************************
+ * Output
+*******************************************************************************/
+static void printCSV(const std::vector<BenchResult>& R, const char* kernel,
+                     uint64_t seed, int repeats) {
+  printf("# dct-bench kernel=%s seed=%llu repeats=%d block=%d\n", kernel,
+         (unsigned long long)seed, repeats, BLOCK);
+  printf("size,stage,ns_per_event,events_per_s,min_ns_per_event,check\n");
+  for (size_t i = 0; i < R.size(); i++) {
+    const BenchResult* r = &R[i];
+    double med = median(r);
+    printf("%ld,%s,%.1f,%.0f,%.1f,%lld\n", r->size, stageNames[r->stage],
+           1e9 * med / r->size, med > 0 ? r->size / med : 0.,
+           1e9 * fastest(r) / r->size, r->check);
+  }
+}
+
+static void printJSON(const std::vector<BenchResult>& R, const char* kernel,
+                      uint64_t seed, int repeats) {
+  printf("{\n  \"kernel\": \"%s\",\n  \"seed\": %llu,\n  \"repeats\": %d,\n"
+         "  \"block\": %d,\n  \"results\": [\n",
+         kernel, (unsigned long long)seed, repeats, BLOCK);
+  for (size_t i = 0; i < R.size(); i++) {
+    const BenchResult* r = &R[i];
+    double med = median(r);
+    printf("    {\"size\": %ld, \"stage\": \"%s\", \"ns_per_event\": %.1f, "
+           "\"events_per_s\": %.0f, \"min_ns_per_event\": %.1f, "
+           "\"check\": %lld}%s\n",
+           r->size, stageNames[r->stage], 1e9 * med / r->size,
+           med > 0 ? r->size / med : 0., 1e9 * fastest(r) / r->size, r->check,
+           i + 1 < R.size() ? "," : "");
+  }
+  printf("  ]\n}\n");
+}
+
+/*******************************************************************************
+ * Compares with an earlier CSV output. Returns the number of stages more
+ * than 'tolerance' percent slower, -1 if the file can't be read.
+*******************************************************************************/
+static int compareBaseline(const std::vector<BenchResult>& R,
+                           const char* path, double tolerance) {
+  FILE* f = fopen(path, "r");
+  char line[256], stage[64];
+  long size;
+  double ns;
+  int slower = 0;
+
+  if (!f) {
+    fprintf(stderr, "Can't open %s\n", path);
+    return -1;
+  }
+  fprintf(stderr, "%8s %-14s %12s %12s %8s\n", "size", "stage", "base ns/ev",
+          "ns/ev", "change");
+  while (fgets(line, sizeof line, f)) {
+    if (sscanf(line, "%ld,%63[^,],%lf", &size, stage, &ns) != 3) continue;
+    for (size_t i = 0; i < R.size(); i++) {
+      const BenchResult* r = &R[i];
+      if (r->size != size || strcmp(stageNames[r->stage], stage)) continue;
+      double cur = 1e9 * median(r) / r->size;
+      double change = ns > 0 ? 100 * (cur / ns - 1) : 0;
+      bool bad = change > tolerance;
+      fprintf(stderr, "%8ld %-14s %12.1f %12.1f %+7.1f%%%s\n", size, stage, ns,
+              cur, change, bad ? "  SLOWER" : "");
+      if (bad) slower++;
+    }
+  }
+  fclose(f);
+  return slower;
+}
+
+/*******************************************************************************
+ * Prints how to call the program
+*******************************************************************************/
+static void usage(const char* prog) {
+  fprintf(stderr,
+          "Usage: %s [-n sizes] [-r repeats] [-s seed] [-f csv|json]\n"
+          "       [-c baseline.csv] [-T percent]\n",
+          prog);
+}
+
+/*******************************************************************************
+ * Main
+*******************************************************************************/
+int main(int argc, char** argv) {
+  std::vector<long> sizes;
+  const char* sizeList = "64,256,1024";
+  int repeats = 5;
+  uint64_t seed = 1;
+  bool json = false;
+  const char* baseline = NULL;
+  double tolerance = 10;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:r:s:f:c:T:h")) != -1) {
+    bool ok = true;
+    switch (opt) {
+      case 'n':
+        sizeList = optarg;
+        break;
+      case 'r':
+        repeats = atoi(optarg);
+        ok = repeats >= 1 && repeats <= MAXREPEATS;
+        break;
+      case 's':
+        seed = strtoull(optarg, NULL, 0);
+        break;
+      case 'f':
+        json = !strcmp(optarg, "json");
+        ok = json || !strcmp(optarg, "csv");
+        break;
+      case 'c':
+        baseline = optarg;
+        break;
+      case 'T':
+        tolerance = atof(optarg);
+        break;
+      default:
+        ok = false;
+        break;
+    }
+    if (!ok) {
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  for (const char* p = sizeList; *p;) {
+    char* end;
+    long n = strtol(p, &end, 10);
+    if (end == p || n < 1) {
+      usage(argv[0]);
+      return 1;
+    }
+    sizes.push_back(n);
+    p = *end == ',' ? end + 1 : end;
+  }
+  if (optind < argc) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  /* Data set, as big as the biggest size; smaller sizes use its start */
+  BenchData D;
+  long maxSize = *std::max_element(sizes.begin(), sizes.end());
+  TimePoint t0 = now();
+  makeData(&D, seed, maxSize);
+  fprintf(stderr, "Generated %ld events (%.0f MB) in %.1f s\n", maxSize,
+          D.text.size() / 1e6, secondsSince(t0));
+
+  static BenchState S;
+  initCuts(&S.cuts, -50);  // DataTest7's threshold
+  S.kernel = selectEventKernel();
+  initChannelMap(&S.channels);
+  S.tm.resize(BLOCK * NUMTSTEPS * NUMADCS);
+  S.chan.resize(BLOCK * NUMTSTEPS * NUMCHANNELS);
+  S.adc.resize(BLOCK * NUMADCS * NUMTSTEPS);
+  S.stats.resize(BLOCK);
+#ifdef DCT_BENCH_ROOT
+  bookHists(&S.hists);
+#endif
+
+  std::vector<BenchResult> results;
+  for (size_t i = 0; i < sizes.size(); i++) {
+    std::vector<BenchResult> res(NSTAGES);
+    for (int s = 0; s < NSTAGES; s++) {
+      res[s].size = sizes[i];
+      res[s].stage = s;
+      res[s].repeats = 0;
+      res[s].check = 0;
+    }
+    fprintf(stderr, "%ld events:", sizes[i]);
+    for (int rep = 0; rep < repeats; rep++) {
+      runOnce(&S, &D, sizes[i], &res[0]);
+      fprintf(stderr, " %d", rep + 1);
+    }
+    fprintf(stderr, "\n");
+
+    /* Stages computing the same thing have to agree */
+    const int same[][2] = {{PARSE, PARSE_GETLINE}, {PARSE, PARSE_TM},
+                           {PARSE, PARSE_CHANNELS}, {KERNEL, KERNEL_SCALAR},
+                           {INTEGRAL, ROI_WIRE},    {INTEGRAL, EVENT}};
+    for (size_t k = 0; k < sizeof same / sizeof same[0]; k++)
+      if (res[same[k][0]].check != res[same[k][1]].check)
+        fprintf(stderr, "Warning: %s and %s disagree at %ld events\n",
+                stageNames[same[k][0]], stageNames[same[k][1]], sizes[i]);
+
+    for (int s = 0; s < NSTAGES; s++)
+      if (haveStage(s)) results.push_back(res[s]);
+  }
+
+  if (json)
+    printJSON(results, kernelName(S.kernel), seed, repeats);
+  else
+    printCSV(results, kernelName(S.kernel), seed, repeats);
+
+  if (baseline) {
+    int slower = compareBaseline(results, baseline, tolerance);
+    if (slower < 0) return 1;
+    if (slower) {
+      fprintf(stderr, "%d stage(s) more than %.0f%% slower than %s\n", slower,
+              tolerance, baseline);
+      return 1;
+    }
+  }
+  return 0;
+}
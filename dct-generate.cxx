@@ -0,0 +1,308 @@
+/*
+ * dct-generate.cxx
+ *
+ * Writes synthetic NI_PDCT events (see DCT_Generator.h) to a text dump the
+ * DataTest analyses read like real data, and the ground truth of every hit
+ * to <out>.truth. Needs no ROOT.
+ *
+ * Usage:
+ *   dct-generate [-n events] [-s seed] [-j threads] [options] out.txt
+ *
+ *   -S box|triangle|exp          pulse shape
+ *   -a min:max                   pulse heights (wire sum, ADC counts)
+ *   -N rms                       noise per sample
+ *   -d uniform:a:b|gauss:m:s     drift time (pulse length) distribution
+ *   -t min:max                   pulse start times
+ *   -p prob                      chance of a hit per wire
+ *   -k prob                      chance of an event being a 3 wire track
+ *   -x prob                      chance of a hit saturating
+ *   -g prob                      chance of a glitch sample per wire
+ *   -v                           read the file back through the ROI finder
+ *                                and compare with the truth
+ *   -T thresh                    threshold for -v (default -50, DataTest7)
+ *
+ * The output only depends on the options and the seed, not on -j.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <vector>
+
+#define NUMWIRES 8
+#define NUMTSTEPS 1000
+#define NUMADCS 32
+#define ROISIZE 25
+
+#include "DCT_Cuts.h"
+#include "DCT_Generator.h"
+#include "DCT_Parallel.h"
+#include "DCT_Reader.h"
+#include "DCT_ROI.h"
+#include "DCT_Stats.h"
+
+#define BATCH 16  // Events each worker makes between writes
+
+/*******************************************************************************
+ * Prints how to call the program
+*******************************************************************************/
+static void usage(const char* prog) {
+  fprintf(stderr,
+          "Usage: %s [-n events] [-s seed] [-j threads] [-S box|triangle|exp]\n"
+          "       [-a min:max] [-N rms] [-d uniform:a:b|gauss:mean:sigma]\n"
+          "       [-t min:max] [-p prob] [-k prob] [-x prob] [-g prob]\n"
+          "       [-v] [-T thresh] out.txt\n",
+          prog);
+}
+
+/*******************************************************************************
+ * Seconds since t0
+*******************************************************************************/
+static double secondsSince(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0)
+      .count();
+}
+
+/*******************************************************************************
+ * Writes nEvents events to outfile and their truth to truthfile. Returns
+ * false on a write error.
+*******************************************************************************/
+static bool generate(const GenParams* G, const GenNoise* N, long nEvents,
+                     int nThreads, const char* outfile,
+                     const char* truthfile) {
+  FILE* out = fopen(outfile, "wb");
+  FILE* truth = fopen(truthfile, "wb");
+  if (!out || !truth) {
+    fprintf(stderr, "Can't write %s\n", out ? truthfile : outfile);
+    if (out) fclose(out);
+    if (truth) fclose(truth);
+    return false;
+  }
+  fputs(GEN_TRUTHHEADER, truth);
+
+  /* Every worker formats its share of a batch into its own buffers, which
+   * are written in worker order */
+  std::vector<std::vector<char> > text(nThreads), truthText(nThreads);
+  std::vector<std::vector<int> > tm(nThreads);
+  std::vector<size_t> textSize(nThreads), truthSize(nThreads);
+  for (int k = 0; k < nThreads; k++) {
+    text[k].resize(BATCH * GEN_EVENTSIZE);
+    truthText[k].resize(BATCH * GEN_TRUTHSIZE);
+    tm[k].resize(NUMTSTEPS * NUMADCS);
+  }
+
+  bool ok = true;
+  long batch = (long)BATCH * nThreads;
+  for (long first = 0; ok && first < nEvents; first += batch) {
+    long n = nEvents - first < batch ? nEvents - first : batch;
+    runWorkers(nThreads, [&](int k) {
+      long a, b;
+      chunkRange(n, nThreads, k, &a, &b);
+      char* p = &text[k][0];
+      char* q = &truthText[k][0];
+      for (long event = first + a; event < first + b; event++) {
+        GenTruth T;
+        int(*adc)[NUMADCS] = (int(*)[NUMADCS]) & tm[k][0];
+        generateEvent(G, N, event, &T, adc);
+        p = formatEvent(adc, p);
+        q = formatTruth(&T, q);
+      }
+      textSize[k] = p - &text[k][0];
+      truthSize[k] = q - &truthText[k][0];
+    });
+    for (int k = 0; k < nThreads; k++) {
+      ok = ok && fwrite(&text[k][0], 1, textSize[k], out) == textSize[k];
+      ok = ok && fwrite(&truthText[k][0], 1, truthSize[k], truth) ==
+                     truthSize[k];
+    }
+  }
+
+  if (fclose(out) != 0) ok = false;
+  if (fclose(truth) != 0) ok = false;
+  if (!ok) fprintf(stderr, "Error writing %s\n", outfile);
+  return ok;
+}
+
+/*******************************************************************************
+ * Reads outfile back through the ROI finder and compares every wire with
+ * the truth (made again from the seed). Clean hits should be found, with
+ * t_eStart at min_eStart plus the time to cross threshold before the true
+ * start and t_eEnd near its end; saturated and glitched wires should be
+ * thrown away; wires without a hit shouldn't fire.
+*******************************************************************************/
+static bool verify(const GenParams* G, const GenNoise* N, const char* outfile,
+                   int threshval) {
+  static int adc[NUMADCS][NUMTSTEPS];
+  static int tm[NUMTSTEPS][NUMADCS];
+  ROIParams cuts;
+  DCTReader reader;
+  RunningStats dStart, dEnd, dDrift;
+  long clean = 0, found = 0, flagged = 0, rejected = 0, empty = 0, fakes = 0;
+  long event;
+
+  initCuts(&cuts, threshval);
+  INIT_STATS(dStart);
+  INIT_STATS(dEnd);
+  INIT_STATS(dDrift);
+  if (!openReader(&reader, outfile)) {
+    fprintf(stderr, "Can't open %s\n", outfile);
+    return false;
+  }
+
+  for (event = 0; readEvent(&reader, adc, adc_offsets); event++) {
+    GenTruth T;
+    generateEvent(G, N, event, &T, tm);
+    for (int w = 0; w < NUMWIRES; w++) {
+      const GenHit* h = &T.hit[w];
+      Extrema L, R;
+      ROI sum;
+      INIT_EXTREMA(L);
+      INIT_EXTREMA(R);
+      INIT_ROI(sum);
+      bool good = findWireROI(adc[2 * w], adc[2 * w + 1], w, &cuts, &L, &R,
+                              &sum);
+
+      if (h->flags) {
+        flagged++;
+        if (!good) rejected++;
+      } else if (h->start < 0) {
+        empty++;
+        if (good) fakes++;
+      } else {
+        clean++;
+        if (!good) continue;
+        found++;
+        addStat(&dStart, sum.t_eStart - h->start);
+        if (!sum.spikeOver) continue;
+        addStat(&dEnd, sum.t_eEnd - (h->start + h->drift));
+        addStat(&dDrift, (sum.t_eEnd - sum.t_eStart) - h->drift);
+      }
+    }
+  }
+  closeReader(&reader);
+
+  printf("Verified %ld events of %s (threshold %d)\n", event, outfile,
+         threshval);
+  printf("  clean hits found      %ld / %ld\n", found, clean);
+  printf("  bad wires thrown out  %ld / %ld\n", rejected, flagged);
+  printf("  fakes on empty wires  %ld / %ld\n", fakes, empty);
+  printf("%-24s %10s %10s %10s %8s %8s\n", "", "n", "mean", "rms", "min",
+         "max");
+  printStats("t_eStart - start", &dStart);
+  printStats("t_eEnd - end", &dEnd);
+  printStats("drift - true drift", &dDrift);
+  return true;
+}
+
+/*******************************************************************************
+ * Parses "a:b" into two numbers. Returns false if it isn't one.
+*******************************************************************************/
+static bool parseRange(const char* s, double* a, double* b) {
+  return sscanf(s, "%lf:%lf", a, b) == 2;
+}
+
+/*******************************************************************************
+ * Main
+*******************************************************************************/
+int main(int argc, char** argv) {
+  GenParams G;
+  long nEvents = 1000;
+  int nThreads = 1;
+  bool check = false;
+  int threshval = -50;
+  double a, b;
+  char name[16];
+  int opt;
+
+  initGenParams(&G);
+  while ((opt = getopt(argc, argv, "n:s:j:S:a:N:d:t:p:k:x:g:vT:h")) != -1) {
+    bool ok = true;
+    switch (opt) {
+      case 'n':
+        nEvents = atol(optarg);
+        break;
+      case 's':
+        G.seed = strtoull(optarg, NULL, 0);
+        break;
+      case 'j':
+        nThreads = atoi(optarg);
+        break;
+      case 'S':
+        if (!strcmp(optarg, "box")) G.shape = GEN_BOX;
+        else if (!strcmp(optarg, "triangle")) G.shape = GEN_TRIANGLE;
+        else if (!strcmp(optarg, "exp")) G.shape = GEN_EXP;
+        else ok = false;
+        break;
+      case 'a':
+        ok = parseRange(optarg, &a, &b);
+        G.ampMin = a;
+        G.ampMax = b;
+        break;
+      case 'N':
+        G.noise = atof(optarg);
+        break;
+      case 'd':
+        ok = sscanf(optarg, "%15[a-z]:%lf:%lf", name, &a, &b) == 3;
+        G.driftDist = !strcmp(name, "gauss") ? GEN_GAUSS : GEN_UNIFORM;
+        ok = ok && (G.driftDist == GEN_GAUSS || !strcmp(name, "uniform"));
+        G.driftA = a;
+        G.driftB = b;
+        break;
+      case 't':
+        ok = parseRange(optarg, &a, &b);
+        G.startMin = a;
+        G.startMax = b;
+        break;
+      case 'p':
+        G.pHit = atof(optarg);
+        break;
+      case 'k':
+        G.pTrack = atof(optarg);
+        break;
+      case 'x':
+        G.pSaturate = atof(optarg);
+        break;
+      case 'g':
+        G.pGlitch = atof(optarg);
+        break;
+      case 'v':
+        check = true;
+        break;
+      case 'T':
+        threshval = atoi(optarg);
+        break;
+      default:
+        ok = false;
+        break;
+    }
+    if (!ok) {
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind >= argc || nEvents < 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (nThreads < 1) nThreads = 1;
+
+  const char* outfile = argv[optind];
+  char truthfile[4096];
+  snprintf(truthfile, sizeof truthfile, "%s.truth", outfile);
+
+  static GenNoise N;
+  initGenNoise(&N, G.noise);
+
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  if (!generate(&G, &N, nEvents, nThreads, outfile, truthfile)) return 1;
+  double dt = secondsSince(t0);
+  printf("Wrote %ld events to %s (truth in %s), %.0f events/s\n", nEvents,
+         outfile, truthfile, dt > 0 ? nEvents / dt : 0.);
+
+  if (check && !verify(&G, &N, outfile, threshval)) return 1;
+  return 0;
+}
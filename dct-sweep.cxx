@@ -0,0 +1,213 @@
+/*
+ * dct-sweep.cxx
+ *
+ * Scans the ROI cuts over one read of the data (see DCT_Sweep.h): every
+ * combination of the values given for threshval, threshFrac, min_eStart and
+ * ROISIZE is evaluated, and its hit efficiency and drift time histograms are
+ * saved to a ROOT file, one directory per point. A table of the efficiencies
+ * is printed.
+ *
+ * Usage:
+ *   dct-sweep [-j threads] [-n events] [-o out.root] [-T list] [-F list]
+ *             [-E list] [-R list] [infile]
+ *
+ *   -T   threshval   (default -50)
+ *   -F   threshFrac  (default 8)
+ *   -E   min_eStart  (default 2)
+ *   -R   ROISIZE     (default 25)
+ *
+ * A list is either values separated by commas (-T -20,-50,-80) or a range
+ * first:last:step, last included (-T -100:-2:2 is a 50 point scan). infile
+ * defaults to NI_PDCT_17.txt, out.root to DCT_Sweep.root. -n only decodes
+ * the first events of the run.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <vector>
+
+#include "TFile.h"
+#include "TROOT.h"
+
+#include "DCT_Analysis.h"
+#include "DCT_Sweep.h"
+
+/*******************************************************************************
+ * Prints how to call the program
+*******************************************************************************/
+static void usage(const char* prog) {
+  fprintf(stderr,
+          "Usage: %s [-j threads] [-n events] [-o out.root] [-T list]\n"
+          "       [-F list] [-E list] [-R list] [infile]\n"
+          "A list is a,b,c or first:last:step\n",
+          prog);
+}
+
+/*******************************************************************************
+ * Seconds since t0
+*******************************************************************************/
+static double secondsSince(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0)
+      .count();
+}
+
+/*******************************************************************************
+ * Parses a list of values ("a,b,c" or "first:last:step"). Returns false if
+ * it isn't one.
+*******************************************************************************/
+static bool parseList(const char* s, std::vector<int>* v) {
+  int first, last, step;
+  char end;
+
+  v->clear();
+  if (sscanf(s, "%d:%d:%d%c", &first, &last, &step, &end) == 3) {
+    if (step == 0 || (last - first) / step < 0) return false;
+    for (int x = first; step > 0 ? x <= last : x >= last; x += step)
+      v->push_back(x);
+    return true;
+  }
+
+  while (*s) {
+    char* next;
+    v->push_back(strtol(s, &next, 10));
+    if (next == s || (*next && *next != ',')) return false;
+    s = *next ? next + 1 : next;
+  }
+  return !v->empty();
+}
+
+/*******************************************************************************
+ * Saves the histograms of every point, one directory per point. Written to a
+ * temporary file first and renamed, so outfile is always a complete file.
+*******************************************************************************/
+static bool saveSweep(const std::vector<SweepResult>& R, const char* outfile) {
+  char tmpfile[4096];
+  snprintf(tmpfile, sizeof tmpfile, "%s.tmp", outfile);
+
+  TFile out(tmpfile, "RECREATE");
+  if (out.IsZombie()) {
+    fprintf(stderr, "Can't write %s\n", tmpfile);
+    return false;
+  }
+  for (size_t s = 0; s < R.size(); s++) {
+    const SweepPoint* p = &R[s].point;
+    char dir[100];
+    snprintf(dir, sizeof dir, "T%d_F%d_E%d_R%d", p->threshval, p->threshFrac,
+             p->min_eStart, p->roiSize);
+    out.mkdir(dir)->cd();
+    R[s].eff->Write("Efficiency");
+    for (int w = 0; w < NUMWIRES; w++) {
+      char key[32];
+      snprintf(key, sizeof key, "DriftTimes_%d", w + 1);
+      R[s].drift[w]->Write(key);
+    }
+  }
+  out.Close();
+
+  if (rename(tmpfile, outfile) != 0) {
+    fprintf(stderr, "Can't write %s\n", outfile);
+    return false;
+  }
+  return true;
+}
+
+/*******************************************************************************
+ * Main
+*******************************************************************************/
+int main(int argc, char** argv) {
+  int nThreads = 1;
+  long maxEvents = -1;
+  const char* outfile = "DCT_Sweep.root";
+  std::vector<int> thresh(1, -50), frac(1, 8), start(1, 2), size(1, ROISIZE);
+  int opt;
+
+  while ((opt = getopt(argc, argv, "j:n:o:T:F:E:R:h")) != -1) {
+    bool ok = true;
+    switch (opt) {
+      case 'j':
+        nThreads = atoi(optarg);
+        break;
+      case 'n':
+        maxEvents = atol(optarg);
+        break;
+      case 'o':
+        outfile = optarg;
+        break;
+      case 'T':
+        ok = parseList(optarg, &thresh);
+        break;
+      case 'F':
+        ok = parseList(optarg, &frac);
+        for (size_t i = 0; ok && i < frac.size(); i++) ok = frac[i] != 0;
+        break;
+      case 'E':
+        ok = parseList(optarg, &start);
+        break;
+      case 'R':
+        ok = parseList(optarg, &size);
+        break;
+      default:
+        ok = false;
+        break;
+    }
+    if (!ok) {
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  const char* infile = optind < argc ? argv[optind] : "NI_PDCT_17.txt";
+  if (nThreads < 1) nThreads = 1;
+
+  gROOT->SetBatch(kTRUE);
+
+  /*****************************************************************************
+  * Books the grid, decodes the run once and evaluates the grid on it
+  *****************************************************************************/
+  std::vector<SweepResult> R;
+  for (size_t a = 0; a < thresh.size(); a++)
+    for (size_t b = 0; b < frac.size(); b++)
+      for (size_t c = 0; c < start.size(); c++)
+        for (size_t d = 0; d < size.size(); d++) {
+          SweepPoint p = {thresh[a], frac[b], start[c], size[d]};
+          addSweepPoint(&R, &p);
+        }
+
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  DCTSamples S;
+  if (!loadSamples(&S, infile, &R[0].cuts, maxEvents, nThreads)) {
+    fprintf(stderr, "Can't read %s\n", infile);
+    return 1;
+  }
+  double tLoad = secondsSince(t0);
+
+  t0 = std::chrono::steady_clock::now();
+  runSweep(&S, &R, nThreads);
+  double tSweep = secondsSince(t0);
+
+  printf("Decoded %ld events from %s in %.2f s, %zu points in %.2f s\n",
+         S.nEvents, infile, tLoad, R.size(), tSweep);
+
+  /*****************************************************************************
+  * Efficiency table and histograms
+  *****************************************************************************/
+  printf("%6s %5s %5s %5s ", "thresh", "frac", "start", "roi");
+  for (int w = 0; w < NUMWIRES; w++) printf(" wire%d", w + 1);
+  printf("\n");
+  for (size_t s = 0; s < R.size(); s++) {
+    const SweepPoint* p = &R[s].point;
+    printf("%6d %5d %5d %5d ", p->threshval, p->threshFrac, p->min_eStart,
+           p->roiSize);
+    for (int w = 0; w < NUMWIRES; w++)
+      printf(" %5.3f", R[s].eff->GetBinContent(w + 1));
+    printf("\n");
+  }
+
+  if (!saveSweep(R, outfile)) return 1;
+  printf("Histograms saved to %s\n", outfile);
+  return 0;
+}
@@ -0,0 +1,476 @@
+/*
+ * test-kernels.cxx
+ *
+ * Runs every event kernel of DCT_SIMD.h the CPU supports on randomized
+ * events and checks that they all give the scalar version's EventStats, and
+ * that findEventROIs() gives the extrema, ROIs and waveGood flags
+ * findWireROI() gives for each wire. The events are synthetic (see
+ * DCT_Generator.h) with many saturated and glitched wires, under random cuts,
+ * and each wire may be bent into a corner case: a crossing within min_eStart
+ * of the first bin, a pulse that never ends or starts on the last bins, a bad
+ * sample on the first or last bin, samples right at the safe min/max and
+ * wire sums right at the thresholds, flat waves. findWireROI() itself is
+ * checked on the same wires against the multi-pass ROI finder it replaced,
+ * and it is what the stored forms of an event have to give back: the ROIs
+ * dctzEventROIs() rebuilds from the windows suppressEvent() keeps (see
+ * DCT_ZS.h), for each of several cut sets at once, and the ones
+ * findSumROI() finds in a stored wire sum (see DCT_Samples.h). Needs no
+ * ROOT.
+ *
+ * Usage:
+ *   test-kernels [events] [seed]
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "DCT_Cuts.h"
+#include "DCT_Generator.h"
+#include "DCT_SIMD.h"
+#include "DCT_ZS.h"
+
+#define MAXFAILURES 10  // Stop reporting after this many
+#define MAXCUTSETS 4    // Cut sets a .dctz record is made with, at most
+
+static int failures = 0;
+
+/*******************************************************************************
+ * Reports a difference
+*******************************************************************************/
+static void fail(long event, const char* what, int w, int got, int want) {
+  if (++failures <= MAXFAILURES)
+    printf("FAIL: event %ld %s[%d] = %d, expected %d\n", event, what, w, got,
+           want);
+}
+
+/*******************************************************************************
+ * Random cuts around the NI_PDCT ones
+*******************************************************************************/
+static void randomCuts(GenRandom* r, ROIParams* p) {
+  initCuts(p, -genInt(r, 10, 200));
+  p->safeMinimum = -genInt(r, 1000, 2100);
+  p->safeMaximum = genInt(r, 5, 60);
+  p->min_eStart = genInt(r, 0, 5);
+  p->threshFrac = genInt(r, 1, 16);
+}
+
+/*******************************************************************************
+ * More random cuts with the safe min/max of p, as all the cut sets of a
+ * .dctz file have
+*******************************************************************************/
+static void randomCutSet(GenRandom* r, const ROIParams* p, ROIParams* q) {
+  randomCuts(r, q);
+  q->safeMinimum = p->safeMinimum;
+  q->safeMaximum = p->safeMaximum;
+}
+
+/*******************************************************************************
+ * Bends wire w of a packed event into one of the corner cases, or leaves it
+*******************************************************************************/
+static void cornerCase(GenRandom* r, int tm[NUMTSTEPS][NUMCHANNELS], int w,
+                       const ROIParams* p) {
+  int L = 2 * w, R = 2 * w + 1;
+  int low = p->thresh[w] - genInt(r, 1, 50);  // Wire sum below threshold
+  int t, u;
+
+  switch (genInt(r, 0, 9)) {
+    case 0:  // Crossing on one of the first bins, before min_eStart is up
+      t = genInt(r, 0, p->min_eStart + 1);
+      for (u = t; u < t + genInt(r, 1, 40) && u < NUMTSTEPS; u++)
+        tm[u][L] = low - tm[u][R];
+      break;
+    case 1:  // Pulse that runs to the end of the window
+      for (u = genInt(r, 500, NUMTSTEPS - 1); u < NUMTSTEPS; u++)
+        tm[u][L] = low - tm[u][R];
+      break;
+    case 2:  // Pulse on the last few bins, maybe ending on the last one
+      t = genInt(r, NUMTSTEPS - 4, NUMTSTEPS - 2);
+      for (u = t; u < NUMTSTEPS - genInt(r, 0, 1); u++)
+        tm[u][L] = low - tm[u][R];
+      break;
+    case 3:  // Bad sample on the first or last bin
+      t = genInt(r, 0, 1) ? NUMTSTEPS - 1 : 0;
+      tm[t][genInt(r, L, R)] =
+          genInt(r, 0, 1) ? p->safeMinimum - 1 : p->safeMaximum + 1;
+      break;
+    case 4:  // Samples right at the safe min/max, still good
+      for (int i = 0; i < 8; i++)
+        tm[genInt(r, 0, NUMTSTEPS - 1)][genInt(r, L, R)] =
+            genInt(r, 0, 1) ? p->safeMinimum : p->safeMaximum;
+      break;
+    case 5:  // Wire sum right at the threshold, then right at its end
+      t = genInt(r, 0, NUMTSTEPS - 20);
+      tm[t][L] = p->thresh[w] - tm[t][R];
+      tm[t + 1][L] = p->thresh[w] - 1 - tm[t + 1][R];
+      for (u = t + 2; u < t + 12; u++)
+        tm[u][L] = p->thresh[w] / p->threshFrac - tm[u][R];
+      tm[u][L] = p->thresh[w] / p->threshFrac + 1 - tm[u][R];
+      break;
+    case 6:  // Flat, every bin ties for the min and max
+      for (u = 0; u < NUMTSTEPS; u++) tm[u][L] = tm[u][R] = genInt(r, -3, 3);
+      break;
+    default:
+      break;
+  }
+}
+
+/*******************************************************************************
+ * The ROI finder as it was before findWireROI() was fused into one pass: the
+ * extrema and wire sum first, then the ROI from the stored sum, then (in the
+ * DataTest macros) the integral and dN/dt of a closed ROI of a good wave.
+ * The ROI of a malfunctioning wire is left as it is.
+*******************************************************************************/
+static bool findWireROIMultiPass(const int* Lwave, const int* Rwave, int w,
+                                 const ROIParams* p, Extrema* L, Extrema* R,
+                                 ROI* sum) {
+  static int wireSum[NUMTSTEPS];
+  bool good = true;  // innocent until proven guilty
+
+  /* Find the min + max voltage for each adc + each wire */
+  for (int t = 0; t < NUMTSTEPS; t++) {
+    int Lval = Lwave[t];
+    int Rval = Rwave[t];
+    wireSum[t] = Lval + Rval;
+
+    /* Check for malfunction */
+    if (Lval < p->safeMinimum || Rval < p->safeMinimum) {
+      good = false;
+      sum->badloc = t;
+      break;
+    } else if (Lval > p->safeMaximum || Rval > p->safeMaximum) {
+      good = false;
+      sum->badloc = t;
+      break;
+    }
+    /* Left ADC */
+    if (Lval < L->minval) {
+      L->minval = Lval;
+      L->minloc = t;
+    }
+    if (Lval > L->maxval) {
+      L->maxval = Lval;
+      L->maxloc = t;
+    }
+    /* Right ADC */
+    if (Rval < R->minval) {
+      R->minval = Rval;
+      R->minloc = t;
+    }
+    if (Rval > R->maxval) {
+      R->maxval = Rval;
+      R->maxloc = t;
+    }
+    /* Together now */
+    if (wireSum[t] < sum->minval) {
+      sum->minval = wireSum[t];
+      sum->minloc = t;
+    }
+  }
+  if (!good) return false;
+
+  /* Determines the ROI. If an event is <ROISIZE, sets new stopping point */
+  for (int t = 0; t < NUMTSTEPS; t++) {
+    if (wireSum[t] < p->thresh[w] && t <= sum->minloc && sum->t_eStart < 0) {
+      if (t < p->min_eStart)
+        sum->t_eStart = 0;
+      else
+        sum->t_eStart = t - p->min_eStart;
+
+      sum->t_eEnd = sum->t_eStart + ROISIZE;
+    }
+    /* Find the bin where the event is pretty much over */
+    if (sum->t_eStart > 0 && wireSum[t] > p->thresh[w] / p->threshFrac &&
+        !sum->spikeOver) {
+      sum->spikeOver = true;
+      sum->t_eEnd = t;
+    }
+  }
+
+  /* If no event is found, mark the wave bad */
+  if (sum->t_eStart < 0) return false;
+
+  /* If an event is found, add some data */
+  if (sum->spikeOver) {
+    for (int t = sum->t_eStart; t < sum->t_eEnd; t++) {
+      sum->integral += wireSum[t];
+      sum->dn_dt += wireSum[t] - wireSum[t + 1];
+    }
+  }
+  return true;
+}
+
+/*******************************************************************************
+ * Reports the fields of two extrema/ROIs that differ. The ROI itself is only
+ * compared for good waves.
+*******************************************************************************/
+static void compareExtrema(long event, const char* what, int i,
+                           const Extrema* a, const Extrema* b) {
+  char name[32];
+  snprintf(name, sizeof name, "%s.minval", what);
+  if (a->minval != b->minval) fail(event, name, i, a->minval, b->minval);
+  snprintf(name, sizeof name, "%s.minloc", what);
+  if (a->minloc != b->minloc) fail(event, name, i, a->minloc, b->minloc);
+  snprintf(name, sizeof name, "%s.maxval", what);
+  if (a->maxval != b->maxval) fail(event, name, i, a->maxval, b->maxval);
+  snprintf(name, sizeof name, "%s.maxloc", what);
+  if (a->maxloc != b->maxloc) fail(event, name, i, a->maxloc, b->maxloc);
+}
+
+static void compareROIs(long event, int w, const ROI* a, const ROI* b,
+                        bool good) {
+  if (a->minval != b->minval) fail(event, "sum.minval", w, a->minval, b->minval);
+  if (a->minloc != b->minloc) fail(event, "sum.minloc", w, a->minloc, b->minloc);
+  if (a->badloc != b->badloc) fail(event, "sum.badloc", w, a->badloc, b->badloc);
+  if (!good) return;
+  if (a->t_eStart != b->t_eStart)
+    fail(event, "sum.t_eStart", w, a->t_eStart, b->t_eStart);
+  if (a->spikeOver != b->spikeOver)
+    fail(event, "sum.spikeOver", w, a->spikeOver, b->spikeOver);
+  if (a->t_eEnd != b->t_eEnd) fail(event, "sum.t_eEnd", w, a->t_eEnd, b->t_eEnd);
+  if (a->integral != b->integral)
+    fail(event, "sum.integral", w, a->integral, b->integral);
+  if (a->dn_dt != b->dn_dt) fail(event, "sum.dn_dt", w, a->dn_dt, b->dn_dt);
+}
+
+/*******************************************************************************
+ * findWireROI() against the multi-pass finder on every wire of one event
+*******************************************************************************/
+static void checkMultiPass(long event, const int tm[NUMTSTEPS][NUMCHANNELS],
+                           const ROIParams* p) {
+  static int Lwave[NUMTSTEPS], Rwave[NUMTSTEPS];
+
+  for (int w = 0; w < NUMWIRES; w++) {
+    Extrema L, R, oldL, oldR;
+    ROI S, oldS;
+    INIT_EXTREMA(L);
+    INIT_EXTREMA(R);
+    INIT_ROI(S);
+    INIT_EXTREMA(oldL);
+    INIT_EXTREMA(oldR);
+    INIT_ROI(oldS);
+    for (int t = 0; t < NUMTSTEPS; t++) {
+      Lwave[t] = tm[t][2 * w];
+      Rwave[t] = tm[t][2 * w + 1];
+    }
+    bool good = findWireROI(Lwave, Rwave, w, p, &L, &R, &S);
+    bool oldGood = findWireROIMultiPass(Lwave, Rwave, w, p, &oldL, &oldR, &oldS);
+
+    if (good != oldGood) fail(event, "findWireROI", w, good, oldGood);
+    compareExtrema(event, "L", w, &L, &oldL);
+    compareExtrema(event, "R", w, &R, &oldR);
+    compareROIs(event, w, &S, &oldS, good && oldGood);
+  }
+}
+
+/*******************************************************************************
+ * findEventROIs() against findWireROI() on every wire of one event
+*******************************************************************************/
+static void checkWires(long event, const int tm[NUMTSTEPS][NUMCHANNELS],
+                       const ROIParams* p, const Extrema* adc, const ROI* sum,
+                       const bool* waveGood) {
+  static int Lwave[NUMTSTEPS], Rwave[NUMTSTEPS];
+
+  for (int w = 0; w < NUMWIRES; w++) {
+    Extrema L, R;
+    ROI S;
+    INIT_EXTREMA(L);
+    INIT_EXTREMA(R);
+    INIT_ROI(S);
+    for (int t = 0; t < NUMTSTEPS; t++) {
+      Lwave[t] = tm[t][2 * w];
+      Rwave[t] = tm[t][2 * w + 1];
+    }
+    bool good = findWireROI(Lwave, Rwave, w, p, &L, &R, &S);
+
+    compareExtrema(event, "adc", 2 * w, &adc[2 * w], &L);
+    compareExtrema(event, "adc", 2 * w + 1, &adc[2 * w + 1], &R);
+    const ROI* s = &sum[w];
+    if (s->minval != S.minval) fail(event, "sum.minval", w, s->minval, S.minval);
+    if (s->minloc != S.minloc) fail(event, "sum.minloc", w, s->minloc, S.minloc);
+    if (s->badloc != S.badloc) fail(event, "sum.badloc", w, s->badloc, S.badloc);
+    if (s->t_eStart != S.t_eStart)
+      fail(event, "sum.t_eStart", w, s->t_eStart, S.t_eStart);
+    if (s->spikeOver != S.spikeOver)
+      fail(event, "sum.spikeOver", w, s->spikeOver, S.spikeOver);
+    if (waveGood[w] != good) fail(event, "waveGood", w, waveGood[w], good);
+
+    /* The ROI end and integral only mean something for a good wave */
+    if (!good) continue;
+    if (s->t_eEnd != S.t_eEnd) fail(event, "sum.t_eEnd", w, s->t_eEnd, S.t_eEnd);
+    if (s->integral != S.integral)
+      fail(event, "sum.integral", w, s->integral, S.integral);
+    if (s->dn_dt != S.dn_dt) fail(event, "sum.dn_dt", w, s->dn_dt, S.dn_dt);
+  }
+}
+
+/*******************************************************************************
+ * The ROIs dctzEventROIs() rebuilds from the record suppressEvent() makes of
+ * one event with cut sets p[0..nCutSets), against findWireROI() on the raw
+ * waves with each set. Counts the good waves whose ROI starts on the first
+ * bin and the ones whose ROI never closes in nStart0 and nOpen.
+*******************************************************************************/
+static void checkSuppressed(long event, const int tm[NUMTSTEPS][NUMCHANNELS],
+                            const ROIParams* p, int nCutSets, long* nStart0,
+                            long* nOpen) {
+  static int samples[NUMCHANNELS][NUMTSTEPS];
+  std::vector<char> record;
+  int64_t offsets[2];
+  DCTZReader z;
+
+  for (int c = 0; c < NUMCHANNELS; c++)
+    for (int t = 0; t < NUMTSTEPS; t++) samples[c][t] = tm[t][c];
+  suppressEvent(&samples[0][0], p, nCutSets, &record);
+
+  /* A reader over the record alone, as if it were event 0 of a file */
+  memset(&z, 0, sizeof z);
+  z.fd = -1;
+  z.data = &record[0];
+  z.size = record.size();
+  z.header.numEvents = 1;
+  offsets[0] = 0;
+  offsets[1] = record.size();
+  z.offsets = offsets;
+
+  for (int s = 0; s < nCutSets; s++) {
+    ROI sum[NUMWIRES];
+    bool waveGood[NUMWIRES];
+    dctzEventROIs(&z, 0, &p[s], ROISIZE, sum, waveGood);
+    for (int w = 0; w < NUMWIRES; w++) {
+      Extrema L, R;
+      ROI S;
+      INIT_EXTREMA(L);
+      INIT_EXTREMA(R);
+      INIT_ROI(S);
+      bool good = findWireROI(samples[2 * w], samples[2 * w + 1], w, &p[s], &L,
+                              &R, &S);
+      if (waveGood[w] != good) fail(event, "dctz waveGood", w, waveGood[w], good);
+      compareROIs(event, w, &sum[w], &S, good && waveGood[w]);
+      if (good && S.t_eStart == 0) ++*nStart0;
+      if (good && !S.spikeOver) ++*nOpen;
+    }
+  }
+}
+
+/*******************************************************************************
+ * The ROIs findSumROI() finds in the stored wire sums of one event, against
+ * findWireROI() on the raw waves
+*******************************************************************************/
+static void checkStored(long event, const int tm[NUMTSTEPS][NUMCHANNELS],
+                        const ROIParams* p) {
+  static int Lwave[NUMTSTEPS], Rwave[NUMTSTEPS];
+  DCTSamples S;
+
+  S.nEvents = 1;
+  S.safeMinimum = p->safeMinimum;
+  S.safeMaximum = p->safeMaximum;
+  S.sum.resize(NUMWIRES * NUMTSTEPS);
+  S.bad.resize(NUMWIRES);
+  storeSampleEvent(&S, 0, &tm[0][0], 1, NUMCHANNELS);
+
+  for (int w = 0; w < NUMWIRES; w++) {
+    Extrema L, R;
+    ROI want, got;
+    INIT_EXTREMA(L);
+    INIT_EXTREMA(R);
+    INIT_ROI(want);
+    INIT_ROI(got);
+    for (int t = 0; t < NUMTSTEPS; t++) {
+      Lwave[t] = tm[t][2 * w];
+      Rwave[t] = tm[t][2 * w + 1];
+    }
+    bool good = findWireROI(Lwave, Rwave, w, p, &L, &R, &want);
+    bool bad = want.badloc >= 0;
+
+    if (sampleBad(&S, 0, w) != bad) fail(event, "sampleBad", w, !bad, bad);
+    if (bad) continue;
+    bool stored = findSumROI(sampleWave(&S, 0, w), w, p, ROISIZE, &got);
+    if (stored != good) fail(event, "findSumROI", w, stored, good);
+    if (!good || !stored) continue;
+
+    /* findSumROI() leaves the minimum to the caller */
+    got.minval = want.minval;
+    got.minloc = want.minloc;
+    compareROIs(event, w, &got, &want, true);
+  }
+}
+
+/*******************************************************************************
+ * Main
+*******************************************************************************/
+int main(int argc, char** argv) {
+  static int gen[NUMTSTEPS][NUMADCS], tm[NUMTSTEPS][NUMCHANNELS];
+  static EventStats want, got;
+  static GenNoise N;
+  long nEvents = argc > 1 ? atol(argv[1]) : 3000;
+  long nStart0 = 0, nOpen = 0;
+  GenParams G;
+  GenRandom r;
+
+  /* Every kernel this CPU can run, the scalar one is the reference */
+  const char* names[3] = {"scalar", "AVX2", "AVX-512"};
+  EventKernel kernels[3] = {eventStatsScalar, NULL, NULL};
+#ifdef DCT_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) kernels[1] = eventStatsAVX2;
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+      __builtin_cpu_supports("bmi2"))
+    kernels[2] = eventStatsAVX512;
+#endif
+
+  initGenParams(&G);
+  if (argc > 2) G.seed = strtoull(argv[2], NULL, 0);
+  G.pSaturate = 0.2;
+  G.pGlitch = 0.2;
+  G.glitchValue = 100;
+  G.startMin = 0;
+  G.startMax = NUMTSTEPS - 10;
+  initGenNoise(&N, G.noise);
+
+  for (long event = 0; event < nEvents; event++) {
+    ROIParams cuts, cutSets[MAXCUTSETS];
+    GenTruth T;
+    genSeed(&r, G.seed + 1, event);
+    randomCuts(&r, &cuts);
+    generateEvent(&G, &N, event, &T, gen);
+    for (int t = 0; t < NUMTSTEPS; t++)
+      for (int c = 0; c < NUMCHANNELS; c++)
+        tm[t][c] = gen[t][c] - adc_offsets[c];
+    for (int w = 0; w < NUMWIRES; w++) cornerCase(&r, tm, w, &cuts);
+    checkMultiPass(event, tm, &cuts);
+    checkStored(event, tm, &cuts);
+
+    int nCutSets = genInt(&r, 1, MAXCUTSETS);
+    cutSets[0] = cuts;
+    for (int s = 1; s < nCutSets; s++) randomCutSet(&r, &cuts, &cutSets[s]);
+    checkSuppressed(event, tm, cutSets, nCutSets, &nStart0, &nOpen);
+
+    eventStatsScalar(tm, &cuts, &want);
+    for (int k = 1; k < 3; k++) {
+      if (!kernels[k]) continue;
+      memset(&got, 0x55, sizeof got);
+      kernels[k](tm, &cuts, &got);
+      if (memcmp(&got, &want, sizeof got) && ++failures <= MAXFAILURES)
+        printf("FAIL: event %ld: %s EventStats differ from scalar\n", event,
+               names[k]);
+    }
+
+    for (int k = 0; k < 3; k++) {
+      Extrema adc[NUMCHANNELS];
+      ROI sum[NUMWIRES];
+      bool waveGood[NUMWIRES];
+      if (!kernels[k]) continue;
+      findEventROIs(kernels[k], tm, &cuts, &got, adc, sum, waveGood);
+      checkWires(event, tm, &cuts, adc, sum, waveGood);
+    }
+  }
+
+  printf("%ld events:", nEvents);
+  for (int k = 0; k < 3; k++)
+    if (kernels[k]) printf(" %s", names[k]);
+  printf(", .dctz ROIs starting on bin 0: %ld, never closed: %ld", nStart0,
+         nOpen);
+  printf(", %d differences\n", failures);
+  return failures ? 1 : 0;
+}
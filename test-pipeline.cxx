@@ -0,0 +1,259 @@
+/*
+ * test-pipeline.cxx
+ *
+ * Runs the DataTest 5, 7 and 9 passes of libdct over a generated run (see
+ * DCT_Generator.h) and checks that the histograms don't depend on how the
+ * work is split:
+ *   threads  1, 3 and 8 threads, on a run whose event count none of them
+ *            divides, give the same histograms bin for bin (contents, errors
+ *            and entries)
+ *   shards   3 and 8 shards of the run (see DCT_Shard.h), merged, give the
+ *            histograms of a single process reading the whole run, bin for
+ *            bin
+ *
+ * Usage:
+ *   test-pipeline threads|shards
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "DCT_Analysis.h"
+#include "DCT_Generator.h"
+#include "DCT_Shard.h"
+
+#define NEVENTS 211  // Events of the generated run, a prime
+
+/*******************************************************************************
+ * Writes nEvents synthetic events to path. Returns false on a write error.
+*******************************************************************************/
+static bool writeRun(const char* path, long nEvents) {
+  static int tm[NUMTSTEPS][NUMADCS];
+  static GenNoise N;
+  std::vector<char> text(GEN_EVENTSIZE);
+  GenParams G;
+
+  initGenParams(&G);
+  G.pSaturate = 0.05;
+  G.pGlitch = 0.05;
+  initGenNoise(&N, G.noise);
+
+  FILE* out = fopen(path, "wb");
+  if (!out) return false;
+  bool ok = true;
+  for (long event = 0; ok && event < nEvents; event++) {
+    GenTruth T;
+    generateEvent(&G, &N, event, &T, tm);
+    size_t size = formatEvent(tm, &text[0]) - &text[0];
+    ok = fwrite(&text[0], 1, size, out) == size;
+  }
+  return fclose(out) == 0 && ok;
+}
+
+/*******************************************************************************
+ * Every histogram of R, in a fixed order
+*******************************************************************************/
+static void listHists(const DataTestResults* R, std::vector<TH1F*>* h) {
+  h->clear();
+  for (int w = 0; w < NUMWIRES; w++) {
+    h->push_back(R->H5.h[w]);
+    h->push_back(R->H7.h1[w]);
+    h->push_back(R->H7.h2[w]);
+    h->push_back(R->H7.h3[w]);
+    h->push_back(R->H9.h1[w]);
+    h->push_back(R->H9.h2[w]);
+  }
+  h->push_back(R->H5.h1);
+  h->push_back(R->H9.h3);
+  h->push_back(R->H9.h4);
+}
+
+/*******************************************************************************
+ * Adds the three passes to P, with their histograms in R
+*******************************************************************************/
+static void addPasses(DCTPipeline* P, DataTestResults* R) {
+  *R = DataTestResults();
+  R->run5 = R->run7 = R->run9 = true;
+  addDataTest5Pass(P, &R->H5);
+  addDataTest7Pass(P, &R->H7);
+  addDataTest9Pass(P, &R->H9);
+}
+
+/*******************************************************************************
+ * Runs the three passes over infile on nThreads threads. Returns the number
+ * of events, -1 if infile can't be read.
+*******************************************************************************/
+static long analyze(const char* infile, int nThreads, DataTestResults* R) {
+  DCTPipeline P;
+
+  addPasses(&P, R);
+  return runPipeline(&P, infile, nThreads);
+}
+
+/*******************************************************************************
+ * Compares every histogram of R with the ones of ref, bin for bin, under and
+ * overflow included. Returns the number of histograms that differ.
+*******************************************************************************/
+static int compareResults(const char* what, const DataTestResults* R,
+                          const DataTestResults* ref) {
+  std::vector<TH1F*> h, want;
+  int differ = 0;
+
+  listHists(R, &h);
+  listHists(ref, &want);
+  for (size_t i = 0; i < h.size(); i++) {
+    const char* name = want[i]->GetName();
+    int n = want[i]->GetNbinsX();
+    if (h[i]->GetNbinsX() != n) {
+      printf("FAIL: %s: %s has %d bins, expected %d\n", what, name,
+             h[i]->GetNbinsX(), n);
+      differ++;
+      continue;
+    }
+    int bin = 0;
+    while (bin <= n + 1 &&
+           h[i]->GetBinContent(bin) == want[i]->GetBinContent(bin) &&
+           h[i]->GetBinError(bin) == want[i]->GetBinError(bin))
+      bin++;
+    if (bin <= n + 1) {
+      printf("FAIL: %s: %s bin %d = %g +- %g, expected %g +- %g\n", what, name,
+             bin, h[i]->GetBinContent(bin), h[i]->GetBinError(bin),
+             want[i]->GetBinContent(bin), want[i]->GetBinError(bin));
+      differ++;
+    } else if (h[i]->GetEntries() != want[i]->GetEntries()) {
+      printf("FAIL: %s: %s has %g entries, expected %g\n", what, name,
+             h[i]->GetEntries(), want[i]->GetEntries());
+      differ++;
+    }
+  }
+  return differ;
+}
+
+/*******************************************************************************
+ * 3 and 8 threads against 1
+*******************************************************************************/
+static int testThreads(const char* infile) {
+  static const int threads[] = {3, 8};
+  DataTestResults ref, R;
+  int failures = 0;
+
+  if (analyze(infile, 1, &ref) != NEVENTS) {
+    printf("FAIL: 1 thread didn't read %d events\n", NEVENTS);
+    deleteResults(&ref);
+    return 1;
+  }
+  for (size_t i = 0; i < sizeof threads / sizeof threads[0]; i++) {
+    char what[32];
+    snprintf(what, sizeof what, "%d threads", threads[i]);
+    long n = analyze(infile, threads[i], &R);
+    if (n != NEVENTS) {
+      printf("FAIL: %s read %ld events, expected %d\n", what, n, NEVENTS);
+      failures++;
+    } else {
+      failures += compareResults(what, &R, &ref);
+    }
+    deleteResults(&R);
+  }
+  deleteResults(&ref);
+  return failures;
+}
+
+/*******************************************************************************
+ * Runs every shard of nShards of infile on 2 threads, then merges the partial
+ * results, in reverse order. Returns the number of events merged, -1 if a
+ * shard or the merge failed.
+*******************************************************************************/
+static long shardAndMerge(const char* infile, int nShards,
+                          DataTestResults* R) {
+  std::vector<std::string> parts(nShards);
+  std::vector<const char*> partfiles(nShards);
+  bool ok = true;
+
+  for (int k = 0; ok && k < nShards; k++) {
+    char partfile[4096];
+    DataTestResults S;
+    DCTPipeline P;
+    snprintf(partfile, sizeof partfile, "%s_%dof%d.root", infile, k, nShards);
+    parts[k] = partfile;
+    partfiles[nShards - 1 - k] = parts[k].c_str();
+    addPasses(&P, &S);
+    ok = runShard(&P, infile, 2, k, nShards, partfile) >= 0;
+    deleteResults(&S);
+  }
+
+  long nEvents = -1;
+  if (ok) {
+    DCTPipeline M;
+    addPasses(&M, R);
+    nEvents = mergeShards(&M, &partfiles[0], nShards);
+  } else {
+    *R = DataTestResults();  // Nothing for deleteResults() to free
+  }
+  for (int k = 0; k < nShards; k++) remove(parts[k].c_str());
+  return nEvents;
+}
+
+/*******************************************************************************
+ * 3 and 8 shards, merged, against a single process
+*******************************************************************************/
+static int testShards(const char* infile) {
+  static const int shards[] = {3, 8};
+  DataTestResults ref, R;
+  int failures = 0;
+
+  if (analyze(infile, 1, &ref) != NEVENTS) {
+    printf("FAIL: 1 process didn't read %d events\n", NEVENTS);
+    deleteResults(&ref);
+    return 1;
+  }
+  for (size_t i = 0; i < sizeof shards / sizeof shards[0]; i++) {
+    char what[32];
+    snprintf(what, sizeof what, "%d shards", shards[i]);
+    long n = shardAndMerge(infile, shards[i], &R);
+    if (n != NEVENTS) {
+      printf("FAIL: %s merged %ld events, expected %d\n", what, n, NEVENTS);
+      failures++;
+    } else {
+      failures += compareResults(what, &R, &ref);
+    }
+    deleteResults(&R);
+  }
+  deleteResults(&ref);
+  return failures;
+}
+
+/*******************************************************************************
+ * Main
+*******************************************************************************/
+int main(int argc, char** argv) {
+  char infile[] = "test-pipeline-XXXXXX.txt";
+
+  if (argc != 2 || (strcmp(argv[1], "threads") && strcmp(argv[1], "shards"))) {
+    fprintf(stderr, "Usage: %s threads|shards\n", argv[0]);
+    return 1;
+  }
+  int fd = mkstemps(infile, 4);
+  if (fd < 0) {
+    fprintf(stderr, "Can't make a temporary file\n");
+    return 1;
+  }
+  close(fd);
+  if (!writeRun(infile, NEVENTS)) {
+    fprintf(stderr, "Can't write %s\n", infile);
+    remove(infile);
+    return 1;
+  }
+
+  int failures =
+      !strcmp(argv[1], "threads") ? testThreads(infile) : testShards(infile);
+  remove(infile);
+  remove((std::string(infile) + ".idx").c_str());  // See DCT_Index.h
+  printf("%s: %s\n", argv[1], failures ? "FAILED" : "passed");
+  return failures ? 1 : 0;
+}
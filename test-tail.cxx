@@ -0,0 +1,154 @@
+/*
+ * test-tail.cxx
+ *
+ * Follows a file that a synthetic DAQ (see DCT_Generator.h) is still
+ * writing: a backlog bigger than a pollTail() budget is there from the start,
+ * the rest is appended by another thread in pieces cut at random bytes,
+ * halfway through lines included. Every event has to come out of the tail
+ * once, in order and exactly as generated, no poll may read more than its
+ * budget, and the buffer may not grow past one budget plus one event.
+ * Needs no ROOT.
+ *
+ * Usage:
+ *   test-tail
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "DCT_Cuts.h"
+#include "DCT_Generator.h"
+#include "DCT_Tail.h"
+
+#define BACKLOG 64     // Events in the file before the tail starts
+#define NEVENTS 160    // Events in the file in the end
+#define MAXPIECE 200000  // Largest piece the writer appends at once
+#define TIMEOUT 60     // Seconds before giving up on the writer
+
+/*******************************************************************************
+ * Appends events [first, last) to fd, in pieces of random size with a short
+ * pause after each
+*******************************************************************************/
+static void writeEvents(int fd, const GenParams* G, const GenNoise* N,
+                        long first, long last, bool pieces) {
+  static int tm[NUMTSTEPS][NUMADCS];
+  std::vector<char> text(GEN_EVENTSIZE);
+  GenRandom r;
+
+  genSeed(&r, G->seed + 1, first);
+  for (long event = first; event < last; event++) {
+    GenTruth T;
+    generateEvent(G, N, event, &T, tm);
+    size_t size = formatEvent(tm, &text[0]) - &text[0];
+    for (size_t done = 0; done < size;) {
+      size_t n = pieces ? genInt(&r, 1, MAXPIECE) : size;
+      if (n > size - done) n = size - done;
+      ssize_t w = write(fd, &text[done], n);
+      if (w <= 0) return;
+      done += w;
+      if (pieces) usleep(200);
+    }
+  }
+}
+
+/*******************************************************************************
+ * Main
+*******************************************************************************/
+int main() {
+  static int tm[NUMTSTEPS][NUMADCS], want[NUMTSTEPS][NUMADCS];
+  static const int noOffsets[NUMADCS] = {0};
+  static GenNoise N;
+  GenParams G;
+  char path[] = "test-tail-XXXXXX";
+  long budget = (long)TAIL_READS * TAIL_READSIZE;
+  int failures = 0;
+
+  initGenParams(&G);
+  G.pSaturate = 0.05;
+  G.pGlitch = 0.05;
+  initGenNoise(&N, G.noise);
+
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    fprintf(stderr, "Can't make a temporary file\n");
+    return 1;
+  }
+  writeEvents(fd, &G, &N, 0, BACKLOG, false);
+
+  DCTTail tail;
+  if (!openTail(&tail, path)) {
+    fprintf(stderr, "Can't open %s\n", path);
+    close(fd);
+    remove(path);
+    return 1;
+  }
+  std::thread writer(writeEvents, fd, &G, &N, (long)BACKLOG, (long)NEVENTS,
+                     true);
+
+  /* Tail it like followPipeline() does: wait only once nothing is new */
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  long event = 0, fullPolls = 0;
+  size_t maxBuf = 0;
+  while (event < NEVENTS && failures == 0) {
+    long got = pollTail(&tail);
+    if (got < 0 || got > budget) {
+      printf("FAIL: pollTail() returned %ld (budget %ld)\n", got, budget);
+      failures++;
+      break;
+    }
+    if (got == budget) fullPolls++;
+    if (tail.buf.size() > maxBuf) maxBuf = tail.buf.size();
+
+    DCTReader view;
+    while (nextTailEvent(&tail, &view)) {
+      GenTruth T;
+      if (event >= NEVENTS || !readEventTM(&view, tm, noOffsets)) {
+        printf("FAIL: event %ld not decoded\n", event);
+        failures++;
+        break;
+      }
+      generateEvent(&G, &N, event, &T, want);
+      if (memcmp(tm, want, sizeof tm)) {
+        printf("FAIL: event %ld differs from what was written\n", event);
+        failures++;
+        break;
+      }
+      event++;
+    }
+
+    if (std::chrono::duration<double>(std::chrono::steady_clock::now() - t0)
+            .count() > TIMEOUT) {
+      printf("FAIL: %ld of %d events after %d s\n", event, NEVENTS, TIMEOUT);
+      failures++;
+      break;
+    }
+    if (!got) usleep(1000);
+  }
+  writer.join();
+  closeTail(&tail);
+  close(fd);
+  remove(path);
+
+  /* The backlog alone is more than a budget, so it can't have been read at
+   * once */
+  if (failures == 0 && fullPolls == 0) {
+    printf("FAIL: the %d event backlog was read in one poll\n", BACKLOG);
+    failures++;
+  }
+  if (maxBuf > (size_t)budget + GEN_EVENTSIZE) {
+    printf("FAIL: buffer grew to %zu bytes (budget %ld + one event)\n", maxBuf,
+           budget);
+    failures++;
+  }
+
+  printf("%ld of %d events followed, %ld full polls, buffer up to %zu bytes\n",
+         event, NEVENTS, fullPolls, maxBuf);
+  return failures ? 1 : 0;
+}